@@ -1,345 +1,1787 @@
-﻿// AIFunction.cpp
-#include "AIFunction.h"
-#include "HttpModule.h"
-#include "Json.h"
-#include "JsonUtilities.h"
-#include "Interfaces/IHttpResponse.h"
-
-UDeepSeekFunction* UDeepSeekFunction::SendRequest(const FDeepSeekRequestParams& Params)
-{
-    UDeepSeekFunction* Function = NewObject<UDeepSeekFunction>();
-    Function->bDebug = Params.bDebugMode;
-    Function->ExecuteRequest(Params);
-    return Function;
-}
-
-UDeepSeekFunction* UDeepSeekFunction::QuickSendRequest(const FString& APIKey, const FString& Prompt, bool UseStreaming, bool Debug)
-{
-    FDeepSeekRequestParams Params;
-    Params.APIKey = APIKey;
-    Params.bStream = UseStreaming;
-    Params.bDebugMode = Debug;
-    
-    // 预分配容量以提高性能
-    Params.Messages.Reserve(1);
-    Params.Messages.Add(FDeepSeekMessage(TEXT("user"), Prompt));
-    
-    return SendRequest(Params);
-}
-
-UDeepSeekFunction* UDeepSeekFunction::SendConversationMessage(
-    const TArray<FDeepSeekMessage>& Messages, 
-    const FString& NewUserMessage,
-    const FString& APIKey, 
-    const FString& Model,
-    bool UseStreaming, 
-    bool Debug)
-{
-    FDeepSeekRequestParams Params;
-    Params.APIKey = APIKey;
-    Params.Model = Model;
-    Params.bStream = UseStreaming;
-    Params.bDebugMode = Debug;
-    
-    // 预分配足够的容量以避免重新分配
-    Params.Messages.Reserve(Messages.Num() + 1);
-    Params.Messages.Append(Messages);
-    Params.Messages.Add(FDeepSeekMessage(TEXT("user"), NewUserMessage));
-    
-    return SendRequest(Params);
-}
-
-void UDeepSeekFunction::LogDebug(const FString& Message, bool bIsError)
-{
-    if (!bDebug) return;
-    
-    if (bIsError)
-    {
-        UE_LOG(LogTemp, Error, TEXT("[DeepSeek] %s"), *Message);
-    }
-    else
-    {
-        UE_LOG(LogTemp, Display, TEXT("[DeepSeek] %s"), *Message);
-    }
-    OnDebugMessage.Broadcast(Message);
-}
-
-void UDeepSeekFunction::BeginDestroy()
-{
-    bIsBeingDestroyed = true;
-    
-    // 确保没有被请求持有
-    if (HttpRequestRef.IsValid())
-    {
-        HttpRequestRef->CancelRequest();
-        HttpRequestRef.Reset();
-    }
-    
-    SafeRemoveFromRoot();
-    Super::BeginDestroy();
-}
-
-void UDeepSeekFunction::SafeRemoveFromRoot()
-{
-    // 安全地从根集中移除
-    if (IsRooted())
-    {
-        RemoveFromRoot();
-    }
-}
-
-void UDeepSeekFunction::ExecuteRequest(const FDeepSeekRequestParams& Params)
-{
-    // 重置状态
-    AccumulatedStreamText.Empty();
-    bIsRequestComplete = false;
-    bIsBeingDestroyed = false;
-    
-    // 加入根集，防止被垃圾回收
-    AddToRoot();
-
-    LogDebug(FString::Printf(TEXT("Starting request to: %s"), *Params.URL));
-
-    // 创建并保存HTTP请求引用
-    HttpRequestRef = FHttpModule::Get().CreateRequest();
-    TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = HttpRequestRef.ToSharedRef();
-    
-    // 设置URL和头部
-    HttpRequest->SetURL(Params.URL);
-    HttpRequest->SetVerb(TEXT("POST"));
-    HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
-    HttpRequest->SetHeader(TEXT("Authorization"), FString::Printf(TEXT("Bearer %s"), *Params.APIKey));
-
-    // 构建JSON请求体
-    TSharedPtr<FJsonObject> JsonObject = MakeShareable(new FJsonObject);
-    JsonObject->SetStringField(TEXT("model"), Params.Model);
-    
-    // 添加消息数组
-    TArray<TSharedPtr<FJsonValue>> MessagesArray;
-    MessagesArray.Reserve(Params.Messages.Num());
-    for (const FDeepSeekMessage& Message : Params.Messages)
-    {
-        TSharedPtr<FJsonObject> MessageObject = MakeShareable(new FJsonObject);
-        MessageObject->SetStringField(TEXT("role"), Message.Role);
-        MessageObject->SetStringField(TEXT("content"), Message.Content);
-        MessagesArray.Add(MakeShareable(new FJsonValueObject(MessageObject)));
-    }
-    
-    JsonObject->SetArrayField(TEXT("messages"), MessagesArray);
-    JsonObject->SetBoolField(TEXT("stream"), Params.bStream);
-    JsonObject->SetNumberField(TEXT("temperature"), FMath::Clamp(Params.Temperature, 0.0f, 1.0f));
-    JsonObject->SetNumberField(TEXT("max_tokens"), FMath::Max(1, Params.MaxTokens));
-    
-    // 序列化JSON
-    FString RequestBody;
-    TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&RequestBody);
-    FJsonSerializer::Serialize(JsonObject.ToSharedRef(), Writer);
-
-    HttpRequest->SetContentAsString(RequestBody);
-    
-    LogDebug(FString::Printf(TEXT("Request Body: %s"), *RequestBody));
-
-    // 处理流式响应
-    if (Params.bStream)
-    {
-        HttpRequest->SetResponseBodyReceiveStreamDelegate(
-            FHttpRequestStreamDelegate::CreateWeakLambda(this, [this](void* Data, int64 Length) -> bool {
-                if (bIsBeingDestroyed || Length <= 0) return false;
-                
-                FString DataString = FString(UTF8_TO_TCHAR(static_cast<const char*>(Data)));
-                return HandleStreamData(DataString);
-            })
-        );
-    }
-
-    // 绑定请求完成回调
-    HttpRequest->OnProcessRequestComplete().BindWeakLambda(this, 
-        [this](FHttpRequestPtr RequestPtr, FHttpResponsePtr Response, bool bWasSuccessful)
-    {
-        // 如果对象正在被销毁，不执行任何回调
-        if (bIsBeingDestroyed)
-        {
-            SafeRemoveFromRoot();
-            return;
-        }
-        
-        // 请求完成，处理失败情况
-        if (!bWasSuccessful || !Response.IsValid())
-        {
-            FString ErrorMessage = TEXT("Request failed");
-            if (Response.IsValid())
-            {
-                ErrorMessage = FString::Printf(TEXT("Request failed with code %d: %s"), 
-                                           Response->GetResponseCode(), 
-                                           *Response->GetContentAsString());
-            }
-            OnFailed.Broadcast(ErrorMessage);
-            LogDebug(ErrorMessage, true);
-            SafeRemoveFromRoot();
-            return;
-        }
-        
-        // 获取响应字符串
-        FString ResponseContent = Response->GetContentAsString();
-        LogDebug(FString::Printf(TEXT("Received response (length: %d bytes)"), ResponseContent.Len()));
-        
-        // 流式响应处理
-        if (!AccumulatedStreamText.IsEmpty())
-        {
-            // 流式响应已在HandleStreamData中处理过
-            if (!bIsRequestComplete)
-            {
-                bIsRequestComplete = true;
-                OnCompleted.Broadcast(AccumulatedStreamText);
-            }
-        }
-        else
-        {
-            // 非流式响应，解析JSON
-            TSharedPtr<FJsonObject> JsonResponse;
-            TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(ResponseContent);
-            
-            if (FJsonSerializer::Deserialize(Reader, JsonResponse) && JsonResponse.IsValid())
-            {
-                // 检查错误
-                if (JsonResponse->HasField(TEXT("error")))
-                {
-                    const TSharedPtr<FJsonObject>* ErrorObj;
-                    if (JsonResponse->TryGetObjectField(TEXT("error"), ErrorObj))
-                    {
-                        FString ErrorMessage;
-                        if ((*ErrorObj)->TryGetStringField(TEXT("message"), ErrorMessage))
-                        {
-                            OnFailed.Broadcast(ErrorMessage);
-                            LogDebug(FString::Printf(TEXT("Error: %s"), *ErrorMessage), true);
-                            SafeRemoveFromRoot();
-                            return;
-                        }
-                    }
-                    OnFailed.Broadcast(TEXT("Unknown API error"));
-                    SafeRemoveFromRoot();
-                    return;
-                }
-                
-                // 提取内容
-                FString Content = ExtractContentFromResponse(ResponseContent);
-                bIsRequestComplete = true;
-                OnCompleted.Broadcast(Content);
-            }
-            else
-            {
-                // 无法解析JSON
-                bIsRequestComplete = true;
-                OnCompleted.Broadcast(ResponseContent);
-            }
-        }
-        
-        // 清理请求引用并从根集移除
-        HttpRequestRef.Reset();
-        SafeRemoveFromRoot();
-    });
-
-    LogDebug(TEXT("Sending request..."));
-    HttpRequest->ProcessRequest();
-}
-
-bool UDeepSeekFunction::HandleStreamData(const FString& DataString)
-{
-    // 防止在对象销毁过程中处理数据
-    if (bIsBeingDestroyed)
-    {
-        return false;
-    }
-    
-    // 处理SSE格式数据 (data: {...})
-    TArray<FString> Lines;
-    DataString.ParseIntoArrayLines(Lines);
-    
-    for (const FString& Line : Lines)
-    {
-        if (Line.IsEmpty())
-            continue;
-            
-        FString TrimmedLine = Line.TrimStartAndEnd();
-        
-        // 检查是否是SSE数据行
-        if (TrimmedLine.StartsWith(TEXT("data:")))
-        {
-            FString JsonData = TrimmedLine.RightChop(5).TrimStartAndEnd();
-            
-            // 检查结束标记
-            if (JsonData == TEXT("[DONE]"))
-            {
-                // 流式响应结束
-                if (!bIsRequestComplete)
-                {
-                    bIsRequestComplete = true;
-                    OnCompleted.Broadcast(AccumulatedStreamText);
-                }
-                continue;
-            }
-            
-            // 解析JSON
-            TSharedPtr<FJsonObject> JsonObject;
-            TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonData);
-            
-            if (FJsonSerializer::Deserialize(Reader, JsonObject))
-            {
-                // 获取choices
-                const TArray<TSharedPtr<FJsonValue>>* Choices = nullptr;
-                if (JsonObject->TryGetArrayField(TEXT("choices"), Choices) && Choices->Num() > 0)
-                {
-                    // 获取delta
-                    TSharedPtr<FJsonObject> ChoiceObject = (*Choices)[0]->AsObject();
-                    const TSharedPtr<FJsonObject>* DeltaObject = nullptr;
-                    
-                    if (ChoiceObject->TryGetObjectField(TEXT("delta"), DeltaObject))
-                    {
-                        // 获取content
-                        FString Content;
-                        if ((*DeltaObject)->TryGetStringField(TEXT("content"), Content) && !Content.IsEmpty())
-                        {
-                            // 累积文本
-                            AccumulatedStreamText.Append(Content);
-                            
-                            // 触发事件
-                            OnStream.Broadcast(Content);
-                            LogDebug(FString::Printf(TEXT("Stream content length: %d"), Content.Len()));
-                        }
-                    }
-                }
-            }
-        }
-    }
-    return true;
-}
-
-FString UDeepSeekFunction::ExtractContentFromResponse(const FString& ResponseString)
-{
-    TSharedPtr<FJsonObject> JsonResponse;
-    TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(ResponseString);
-    
-    if (FJsonSerializer::Deserialize(Reader, JsonResponse))
-    {
-        // 获取choices
-        const TArray<TSharedPtr<FJsonValue>>* Choices = nullptr;
-        if (JsonResponse->TryGetArrayField(TEXT("choices"), Choices) && Choices->Num() > 0)
-        {
-            // 获取message
-            TSharedPtr<FJsonObject> ChoiceObject = (*Choices)[0]->AsObject();
-            const TSharedPtr<FJsonObject>* MessageObject = nullptr;
-            
-            if (ChoiceObject->TryGetObjectField(TEXT("message"), MessageObject))
-            {
-                FString Content;
-                if ((*MessageObject)->TryGetStringField(TEXT("content"), Content))
-                {
-                    return Content;
-                }
-            }
-        }
-    }
-    
-    // 无法解析
-    return ResponseString;
-}
+﻿// AIFunction.cpp
+#include "AIFunction.h"
+#include "DeepSeekRequestWriter.h"
+#include "PaasAIModule.h"
+#include "PaasAIStats.h"
+#include "PaasAILog.h"
+#include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+#include "HttpModule.h"
+#include "Json.h"
+#include "JsonUtilities.h"
+#include "Interfaces/IHttpResponse.h"
+
+static TAutoConsoleVariable<int32> CVarPaasAITokenLogInterval(
+    TEXT("PaasAI.TokenLogInterval"),
+    32,
+    TEXT("调试模式下每隔多少个token输出一次逐token日志，0表示不输出"));
+
+namespace DeepSeekInFlight
+{
+    // 按请求哈希登记正在执行、允许合并的请求
+    static FCriticalSection Lock;
+    static TMap<uint64, TWeakObjectPtr<UDeepSeekFunction>> Leaders;
+}
+
+namespace DeepSeekTools
+{
+    // 流式片段中的调用下标上限，防止异常数据导致数组过大
+    static constexpr int32 MaxToolCalls = 64;
+}
+
+namespace DeepSeekHedge
+{
+    // HedgeRace的取值：0表示还没有一方收到文本
+    static constexpr int32 PrimarySlot = 1;
+    static constexpr int32 BackupSlot = 2;
+}
+
+UDeepSeekFunction* UDeepSeekFunction::SendRequest(const FDeepSeekRequestParams& Params)
+{
+    return SendRequestInternal(Params, false);
+}
+
+UDeepSeekFunction* UDeepSeekFunction::SendPooledRequest(const FDeepSeekRequestParams& Params)
+{
+    return SendRequestInternal(Params, true);
+}
+
+UDeepSeekFunction* UDeepSeekFunction::SendRequestInternal(const FDeepSeekRequestParams& Params, bool bInRecyclable)
+{
+    // 优先从对象池中复用
+    FPaasAIModuleModule* Module = FPaasAIModuleModule::Get();
+    UDeepSeekFunction* Function = Module ? Module->GetRequestPool().Acquire() : NewObject<UDeepSeekFunction>();
+    Function->bRecyclable = bInRecyclable;
+    Function->bDebug = Params.bDebugMode;
+    Function->ExecuteRequest(Params);
+    return Function;
+}
+
+UDeepSeekFunction* UDeepSeekFunction::QuickSendRequest(const FString& APIKey, const FString& Prompt, bool UseStreaming, bool Debug)
+{
+    FDeepSeekRequestParams Params;
+    Params.APIKey = APIKey;
+    Params.bStream = UseStreaming;
+    Params.bDebugMode = Debug;
+    
+    // 预分配容量以提高性能
+    Params.Messages.Reserve(1);
+    Params.Messages.Add(FDeepSeekMessage(TEXT("user"), Prompt));
+    
+    return SendRequest(Params);
+}
+
+UDeepSeekFunction* UDeepSeekFunction::SendConversationMessage(
+    const TArray<FDeepSeekMessage>& Messages, 
+    const FString& NewUserMessage,
+    const FString& APIKey, 
+    const FString& Model,
+    bool UseStreaming, 
+    bool Debug)
+{
+    FDeepSeekRequestParams Params;
+    Params.APIKey = APIKey;
+    Params.Model = Model;
+    Params.bStream = UseStreaming;
+    Params.bDebugMode = Debug;
+    
+    // 预分配足够的容量以避免重新分配
+    Params.Messages.Reserve(Messages.Num() + 1);
+    Params.Messages.Append(Messages);
+    Params.Messages.Add(FDeepSeekMessage(TEXT("user"), NewUserMessage));
+    
+    return SendRequest(Params);
+}
+
+void UDeepSeekFunction::LogDebug(const FString& Message, bool bIsError)
+{
+    if (!bDebug) return;
+    
+    if (bIsError)
+    {
+        UE_LOG(LogPaasAI, Error, TEXT("[DeepSeek] %s"), *Message);
+    }
+    else
+    {
+        UE_LOG(LogPaasAI, Display, TEXT("[DeepSeek] %s"), *Message);
+    }
+    OnDebugMessage.Broadcast(Message);
+}
+
+bool UDeepSeekFunction::ShouldLogToken()
+{
+    // 流式回调在HTTP线程上调用，句子切分在游戏线程上调用，计数器用原子量；只用于采样，不需要顺序
+    const int32 Interval = CVarPaasAITokenLogInterval.GetValueOnAnyThread();
+    return Interval > 0 && (TokenLogCounter.fetch_add(1, std::memory_order_relaxed) % Interval) == 0;
+}
+
+void UDeepSeekFunction::BeginDestroy()
+{
+    bIsBeingDestroyed = true;
+    
+    // 确保没有被请求持有
+    if (HttpRequestRef.IsValid())
+    {
+        HttpRequestRef->CancelRequest();
+    }
+    
+    // 合并到本请求的其他请求也随之失败
+    ForwardResultToFollowers(false, TEXT("Request cancelled"));
+    
+    ReleaseRequest();
+    Super::BeginDestroy();
+}
+
+void UDeepSeekFunction::SafeRemoveFromRoot()
+{
+    // 安全地从根集中移除
+    if (IsRooted())
+    {
+        RemoveFromRoot();
+    }
+}
+
+void UDeepSeekFunction::ReleaseAttempt()
+{
+    HttpRequestRef.Reset();
+    bHttpStarted = false;
+    
+    // 还在排队或被本地中止的尝试不影响端点的健康状况，中止的传输也不会把连接留给后续请求
+    ReleaseEndpoint(FDeepSeekEndpointPool::EOutcome::Abandoned);
+    EndConnection(false);
+    
+    // 释放调度名额，让排队中的请求继续；还在排队时直接移出队列
+    if (SchedulerHandle != FDeepSeekRequestScheduler::InvalidHandle)
+    {
+        if (FPaasAIModuleModule* Module = FPaasAIModuleModule::Get())
+        {
+            Module->GetScheduler().Finish(SchedulerHandle);
+        }
+        SchedulerHandle = FDeepSeekRequestScheduler::InvalidHandle;
+    }
+}
+
+void UDeepSeekFunction::ReleaseEndpoint(FDeepSeekEndpointPool::EOutcome Outcome)
+{
+    if (EndpointLeaseId == INDEX_NONE)
+    {
+        return;
+    }
+
+    if (Outcome == FDeepSeekEndpointPool::EOutcome::Failed)
+    {
+        ExcludedEndpointId = EndpointLeaseId;
+    }
+    if (FPaasAIModuleModule* Module = FPaasAIModuleModule::Get())
+    {
+        Module->GetEndpointPool().Release(EndpointLeaseId, Outcome, Metrics.GetTimeToFirstByte());
+    }
+    EndpointLeaseId = INDEX_NONE;
+}
+
+void UDeepSeekFunction::BeginConnection()
+{
+    if (FPaasAIModuleModule* Module = FPaasAIModuleModule::Get())
+    {
+        Metrics.SetConnectionReused(Module->GetConnectionManager().NoteRequestStarted(ConnectionURL));
+        bConnectionOpen = true;
+    }
+}
+
+void UDeepSeekFunction::EndConnection(bool bConnectionKept)
+{
+    if (!bConnectionOpen)
+    {
+        return;
+    }
+
+    bConnectionOpen = false;
+    if (FPaasAIModuleModule* Module = FPaasAIModuleModule::Get())
+    {
+        Module->GetConnectionManager().NoteRequestFinished(ConnectionURL, bConnectionKept);
+    }
+}
+
+FDeepSeekEndpointPool::EOutcome UDeepSeekFunction::ClassifyAttempt(const FHttpResponsePtr& Response, bool bWasSuccessful) const
+{
+    using EOutcome = FDeepSeekEndpointPool::EOutcome;
+
+    if (bWasSuccessful && Response.IsValid() && EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+    {
+        return EOutcome::Succeeded;
+    }
+
+    // 取消、超时、停止条件或对冲的另一方胜出时由本地中止，与端点无关
+    const int32 HedgeWinner = HedgeRace.IsValid() ? HedgeRace->load() : 0;
+    if (bIsRequestComplete || bStreamFinished || (HedgeWinner != 0 && HedgeWinner != HedgeSlot))
+    {
+        return EOutcome::Abandoned;
+    }
+
+    if (!bWasSuccessful || !Response.IsValid())
+    {
+        return EOutcome::Failed;
+    }
+
+    // 鉴权失败说明端点配置有误，也要熔断；其他4xx是请求本身的问题
+    const int32 ResponseCode = Response->GetResponseCode();
+    return (ResponseCode == 401 || ResponseCode == 403 || ResponseCode == 408 || ResponseCode == 429 || ResponseCode >= 500)
+        ? EOutcome::Failed
+        : EOutcome::Abandoned;
+}
+
+void UDeepSeekFunction::AbandonAttempt()
+{
+    if (bHttpStarted && HttpRequestRef.IsValid())
+    {
+        HttpRequestRef->CancelRequest();
+    }
+    else
+    {
+        ReleaseAttempt();
+    }
+}
+
+void UDeepSeekFunction::ReleaseRequest()
+{
+    ReleaseAttempt();
+    UnregisterInFlight();
+    CancelHedge();
+    
+    Metrics.ReleaseStreamBuffer();
+    
+    if (StreamDeliveryTicker.IsValid())
+    {
+        FTSTicker::GetCoreTicker().RemoveTicker(StreamDeliveryTicker);
+        StreamDeliveryTicker.Reset();
+    }
+    if (DeadlineTicker.IsValid())
+    {
+        FTSTicker::GetCoreTicker().RemoveTicker(DeadlineTicker);
+        DeadlineTicker.Reset();
+    }
+    if (DeferredTicker.IsValid())
+    {
+        FTSTicker::GetCoreTicker().RemoveTicker(DeferredTicker);
+        DeferredTicker.Reset();
+    }
+    
+    // 交还给对象池，没有模块时退回到根集
+    FPaasAIModuleModule* Module = FPaasAIModuleModule::Get();
+    if (Module != nullptr && !bIsBeingDestroyed)
+    {
+        Module->GetRequestPool().Release(this);
+    }
+    SafeRemoveFromRoot();
+}
+
+void UDeepSeekFunction::UpdateStreamBufferStats()
+{
+    Metrics.SetStreamBufferBytes(AccumulatedStreamText.GetAllocatedSize());
+}
+
+void UDeepSeekFunction::ResetForReuse()
+{
+    OnCompleted.Clear();
+    OnFailed.Clear();
+    OnStream.Clear();
+    OnDebugMessage.Clear();
+    OnCancelled.Clear();
+    OnToolCalls.Clear();
+    OnStructuredField.Clear();
+    OnSegment.Clear();
+    OnFinishedNative.Unbind();
+    
+    // 只清空内容，保留已分配的容量供下一个请求使用
+    AccumulatedStreamText.Reset();
+    PendingBatch.Reset();
+    StreamDelta.Reset();
+    StreamParser.Reset();
+    
+    {
+        FScopeLock ScopeLock(&FollowersLock);
+        Followers.Reset();
+        InFlightLeader.Reset();
+        LeaderResult.Reset();
+    }
+    
+    RetryBody.Reset();
+    ExcludedEndpointId = INDEX_NONE;
+    HedgeParams.Reset();
+    HedgeRequest.Reset();
+    HedgeRace.Reset();
+    HedgeSlot = 0;
+    
+    bDebug = false;
+}
+
+void UDeepSeekFunction::ExecuteRequest(const FDeepSeekRequestParams& Params)
+{
+    // 重置状态，保留文本缓冲区的容量
+    AccumulatedStreamText.Reset();
+    bIsRequestComplete = false;
+    bIsBeingDestroyed = false;
+    StreamParser.Reset();
+    ReportedTotalTokens = 0;
+    PendingDeltas.Empty();
+    PendingBatch.Reset();
+    bStreamEndSignalled = false;
+    StreamEndError.Reset();
+    bBatchStreamDelivery = false;
+    bStreamResponse = Params.bStream;
+    bStreamFinished = false;
+    TokenLogCounter = 0;
+    bHttpStarted = false;
+    LastResponseCode = 0;
+    ++RequestSerial;
+
+    // 停止条件，空字符串没有意义
+    StopStrings.Reset();
+    MaxStopStringLen = 0;
+    for (const FString& StopString : Params.StopStrings)
+    {
+        if (!StopString.IsEmpty())
+        {
+            StopStrings.Add(StopString);
+            MaxStopStringLen = FMath::Max(MaxStopStringLen, StopString.Len());
+        }
+    }
+    StopScanTail.Reset();
+    MaxResponseChars = FMath::Max(0, Params.MaxResponseChars);
+    StreamCharsReceived = 0;
+    StopPredicate = Params.StopPredicate;
+    ToolCalls.Reset();
+    bStructuredOutput = Params.ResponseFormat == EDeepSeekResponseFormat::JsonObject;
+    StructuredParser.Reset();
+    StructuredOutputStruct = bStructuredOutput ? Params.StructuredOutputStruct : nullptr;
+    StructuredOutputTarget = StructuredOutputStruct ? Params.StructuredOutputTarget : nullptr;
+    bSegmentStream = Params.bSegmentStream;
+    Segmenter.Reset();
+    Segmenter.Configure(Params.SegmentMinChars, Params.bSegmentOnClauses, Params.SegmentFlushTimeout);
+
+    // 超时由游戏线程定期检查，覆盖排队、等待合并的原请求和传输的全过程
+    RequestStartTime = FPlatformTime::Seconds();
+    TimeoutSeconds = FMath::Max(0.0f, Params.TimeoutSeconds);
+    FirstTokenTimeoutSeconds = FMath::Max(0.0f, Params.FirstTokenTimeoutSeconds);
+    HedgeAfterSeconds = FMath::Max(0.0f, Params.HedgeAfterSeconds);
+    bHedgeLaunched = false;
+    bHedgeWon = false;
+    if (TimeoutSeconds > 0.0f || FirstTokenTimeoutSeconds > 0.0f || HedgeAfterSeconds > 0.0f)
+    {
+        DeadlineTicker = FTSTicker::GetCoreTicker().AddTicker(
+            FTickerDelegate::CreateUObject(this, &UDeepSeekFunction::TickDeadline), 0.05f);
+    }
+
+    // 按max_tokens预留文本缓冲区，流式追加时不再反复扩容；对象复用时保留容量
+    if (Params.bStream && Params.MaxTokens > 0)
+    {
+        // 经验值：一个token平均约2个字符（中文接近1个），上限防止异常参数占用过多内存
+        const int32 ExpectedChars = FMath::Min(Params.MaxTokens * 2, 256 * 1024);
+        AccumulatedStreamText.Reserve(ExpectedChars);
+    }
+
+    // 由对象池持有引用直到请求结束，防止被垃圾回收；没有模块时退回到根集
+    if (FPaasAIModuleModule* PoolModule = FPaasAIModuleModule::Get())
+    {
+        PoolModule->GetRequestPool().MarkActive(this);
+    }
+    else
+    {
+        AddToRoot();
+    }
+
+    DEEPSEEK_LOG_DEBUG(TEXT("Starting request to: %s"), *Params.URL);
+
+    // 直接写出UTF-8请求体，不经过FJsonObject和TCHAR字符串
+    TArray<uint8> RequestBody;
+    const int32 CanonicalLength = FDeepSeekRequestWriter::WriteRequestBody(Params, RequestBody);
+    Metrics.Begin(RequestBody.Num());
+
+#if PAASAI_WITH_DEBUG_LOG
+    if (UNLIKELY(bDebug))
+    {
+        FUTF8ToTCHAR BodyText(reinterpret_cast<const ANSICHAR*>(RequestBody.GetData()), RequestBody.Num());
+        LogDebug(FString::Printf(TEXT("Request Body: %s"), *FString(BodyText.Length(), BodyText.Get())));
+    }
+#endif
+
+    // 缓存和请求合并都以规范化请求体的哈希为键
+    RequestHash = 0;
+    bStoreInCache = Params.bUseCache;
+    if (Params.bUseCache || Params.bCoalesceInFlight)
+    {
+        RequestHash = FDeepSeekResponseCache::MakeKey(Params.URL, TConstArrayView<uint8>(RequestBody.GetData(), CanonicalLength));
+    }
+
+    // 查询响应缓存
+    FPaasAIModuleModule* Module = FPaasAIModuleModule::Get();
+    if (Params.bUseCache && Module != nullptr)
+    {
+        FString CachedResponse;
+        if (Module->GetResponseCache().Find(RequestHash, CachedResponse))
+        {
+            DEEPSEEK_LOG_DEBUG(TEXT("Response cache hit"));
+            Metrics.SetFromCache();
+            ReplayCachedResponse(MoveTemp(CachedResponse), Params.bStream);
+            return;
+        }
+
+        FString DiskPath = Module->GetResponseCache().FindOnDisk(RequestHash);
+        if (!DiskPath.IsEmpty())
+        {
+            LoadCachedResponse(MoveTemp(DiskPath), Params, MoveTemp(RequestBody));
+            return;
+        }
+    }
+
+    DispatchRequest(Params, MoveTemp(RequestBody));
+}
+
+void UDeepSeekFunction::LoadCachedResponse(FString&& DiskPath, const FDeepSeekRequestParams& Params, TArray<uint8>&& RequestBody)
+{
+    // 磁盘层在后台线程读取，回到游戏线程后回放；文件已被淘汰时照常发出请求
+    Async(EAsyncExecution::ThreadPool,
+        [this, WeakThis = TWeakObjectPtr<UDeepSeekFunction>(this), Serial = RequestSerial, Path = MoveTemp(DiskPath), Params, Body = MoveTemp(RequestBody)]() mutable
+        {
+            FString Response;
+            const bool bLoaded = FDeepSeekResponseCache::LoadFromDisk(Path, Response);
+            AsyncTask(ENamedThreads::GameThread,
+                [this, WeakThis, Serial, bLoaded, Response = MoveTemp(Response), Params = MoveTemp(Params), Body = MoveTemp(Body)]() mutable
+                {
+                    // 等待期间请求被取消、超时或对象已被复用时丢弃结果
+                    if (!WeakThis.IsValid() || RequestSerial != Serial || bIsBeingDestroyed || bIsRequestComplete)
+                    {
+                        return;
+                    }
+
+                    FPaasAIModuleModule* Module = FPaasAIModuleModule::Get();
+                    if (bLoaded && Module != nullptr)
+                    {
+                        DEEPSEEK_LOG_DEBUG(TEXT("Response cache hit on disk"));
+                        Module->GetResponseCache().Promote(RequestHash, Response);
+                        Metrics.SetFromCache();
+                        ReplayCachedResponse(MoveTemp(Response), Params.bStream);
+                        return;
+                    }
+                    DispatchRequest(Params, MoveTemp(Body));
+                });
+        });
+}
+
+void UDeepSeekFunction::DispatchRequest(const FDeepSeekRequestParams& Params, TArray<uint8>&& RequestBody)
+{
+    // 相同的请求正在执行时直接共享它的结果
+    if (Params.bCoalesceInFlight)
+    {
+        FScopeLock InFlightLock(&DeepSeekInFlight::Lock);
+
+        TWeakObjectPtr<UDeepSeekFunction>* Existing = DeepSeekInFlight::Leaders.Find(RequestHash);
+        if (Existing != nullptr && Existing->IsValid() && (*Existing)->AttachFollower(this, Params.bStream))
+        {
+            DEEPSEEK_LOG_DEBUG(TEXT("Attached to identical in-flight request"));
+            return;
+        }
+
+        DeepSeekInFlight::Leaders.Add(RequestHash, this);
+        bIsInFlightLeader = true;
+    }
+
+    RequestURL = Params.URL;
+    RequestAPIKey = Params.APIKey;
+    RequestPriority = Params.Priority;
+    bUseEndpointPool = Params.bUseEndpointPool;
+    EstimatedTokens = FDeepSeekRateLimiter::EstimateRequestTokens(RequestBody.Num(), Params.MaxTokens);
+
+    // 合并投递时由游戏线程每帧把HTTP线程收到的token一次性发出
+    if (Params.bStream && Params.StreamDelivery == EDeepSeekStreamDelivery::GameThreadBatched)
+    {
+        bBatchStreamDelivery = true;
+        StreamBatchMinChars = FMath::Max(0, Params.StreamBatchMinChars);
+        StreamBatchMaxLatency = FMath::Max(0.0f, Params.StreamBatchMaxLatency);
+        StreamDeliveryTicker = FTSTicker::GetCoreTicker().AddTicker(
+            FTickerDelegate::CreateUObject(this, &UDeepSeekFunction::TickStreamDelivery));
+    }
+
+    // 只有允许重试时才保留一份请求体
+    MaxRetries = FMath::Max(0, Params.MaxRetries);
+    RetryCount = 0;
+    RetryBaseDelay = FMath::Max(0.0f, Params.RetryBaseDelay);
+    RetryMaxDelay = FMath::Max(RetryBaseDelay, Params.RetryMaxDelay);
+    if (MaxRetries > 0)
+    {
+        RetryBody = RequestBody;
+    }
+
+    // 对冲请求在超时检查中发出，需要完整的参数；缓存命中和合并的请求不会走到这里
+    if (HedgeAfterSeconds > 0.0f)
+    {
+        HedgeParams = Params;
+
+        // 预编码的消息由上下文窗口持有并会在原地追加，对冲请求发出时需要的是现在的内容
+        if (Params.EncodedMessages.IsValid())
+        {
+            HedgeParams->EncodedMessages = MakeShared<const TArray<uint8>>(*Params.EncodedMessages);
+        }
+        HedgeRace = MakeShared<std::atomic<int32>, ESPMode::ThreadSafe>(0);
+        HedgeSlot = DeepSeekHedge::PrimarySlot;
+    }
+
+    StartAttempt(MoveTemp(RequestBody));
+}
+
+void UDeepSeekFunction::StartAttempt(TArray<uint8>&& RequestBody)
+{
+    // 每次尝试重新选择端点，池为空时使用参数中的URL和APIKey
+    FString AttemptURL = RequestURL;
+    FString AttemptAPIKey = RequestAPIKey;
+    FPaasAIModuleModule* Module = FPaasAIModuleModule::Get();
+    if (bUseEndpointPool && Module != nullptr)
+    {
+        FDeepSeekEndpointPool::FLease Lease;
+        double WaitSeconds = 0.0;
+        const FDeepSeekEndpointPool::EAcquireResult Result = Module->GetEndpointPool().Acquire(Lease, ExcludedEndpointId, WaitSeconds);
+        if (Result == FDeepSeekEndpointPool::EAcquireResult::Unavailable)
+        {
+            // 所有端点都在冷却或探测中，等待后重新选择；超时由截止时间检查处理
+            DeferredTicker = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateWeakLambda(this,
+                [this, Body = MoveTemp(RequestBody)](float DeltaTime) mutable
+                {
+                    DeferredTicker.Reset();
+                    if (!bIsBeingDestroyed && !bIsRequestComplete)
+                    {
+                        StartAttempt(MoveTemp(Body));
+                    }
+                    return false;
+                }), static_cast<float>(WaitSeconds));
+            return;
+        }
+        if (Result == FDeepSeekEndpointPool::EAcquireResult::Acquired)
+        {
+            EndpointLeaseId = Lease.EndpointId;
+            AttemptURL = MoveTemp(Lease.URL);
+            AttemptAPIKey = MoveTemp(Lease.APIKey);
+        }
+    }
+    EndpointKey = FDeepSeekRequestScheduler::MakeEndpointKey(AttemptURL, AttemptAPIKey);
+    ConnectionURL = AttemptURL;
+    
+    // 创建并保存HTTP请求引用
+    HttpRequestRef = FHttpModule::Get().CreateRequest();
+    TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = HttpRequestRef.ToSharedRef();
+    
+    // 设置URL和头部
+    HttpRequest->SetURL(AttemptURL);
+    HttpRequest->SetVerb(TEXT("POST"));
+    HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+    HttpRequest->SetHeader(TEXT("Authorization"), FString::Printf(TEXT("Bearer %s"), *AttemptAPIKey));
+    HttpRequest->SetContent(MoveTemp(RequestBody));
+
+    // 收到第一个响应头时记录首字节时间
+    HttpRequest->OnHeaderReceived().BindWeakLambda(this,
+        [this](FHttpRequestPtr RequestPtr, const FString& HeaderName, const FString& HeaderValue)
+        {
+            Metrics.MarkFirstByte();
+        });
+
+    // 处理流式响应
+    if (bStreamResponse)
+    {
+        HttpRequest->SetResponseBodyReceiveStreamDelegate(
+            FHttpRequestStreamDelegate::CreateWeakLambda(this, [this](void* Data, int64 Length) -> bool {
+                if (bIsBeingDestroyed || Length <= 0) return false;
+
+                // 设置了流委托后响应体不再整体缓存，数据块处理完即释放
+                Metrics.MarkFirstByte();
+                Metrics.AddResponseBytes(Length);
+
+                // 数据块不以'\0'结尾，且可能在行或UTF-8字符中间截断，交给增量解析器按字节处理
+                return StreamParser.Feed(static_cast<const uint8*>(Data), Length,
+                    [this](FUtf8StringView EventData) { return HandleStreamData(EventData); });
+            })
+        );
+    }
+
+    // 绑定请求完成回调
+    HttpRequest->OnProcessRequestComplete().BindWeakLambda(this, 
+        [this](FHttpRequestPtr RequestPtr, FHttpResponsePtr Response, bool bWasSuccessful)
+    {
+        // 如果对象正在被销毁，不执行任何回调
+        if (bIsBeingDestroyed)
+        {
+            ReleaseRequest();
+            return;
+        }
+        
+        FDeepSeekScopedGameThreadTime GameThreadTime(Metrics);
+        LastResponseCode = (bWasSuccessful && Response.IsValid()) ? Response->GetResponseCode() : 0;
+        ReleaseEndpoint(ClassifyAttempt(Response, bWasSuccessful));
+        EndConnection(bWasSuccessful && Response.IsValid());
+        
+        // 处理服务器未以空行结尾的最后一个事件
+        if (bStreamResponse && !bIsRequestComplete && !bStreamEndSignalled)
+        {
+            StreamParser.Finish([this](FUtf8StringView EventData) { return HandleStreamData(EventData); });
+        }
+        
+        // 先发出合并投递中尚未发出的token，保证OnStream在OnCompleted之前
+        FlushStreamDeltas(true);
+        
+        // 用响应头更新端点的限流预算，429时推迟后续排队的请求
+        if (Response.IsValid())
+        {
+            if (FPaasAIModuleModule* Module = FPaasAIModuleModule::Get())
+            {
+                FDeepSeekRateLimiter& RateLimiter = Module->GetScheduler().GetRateLimiter();
+                RateLimiter.UpdateFromResponse(EndpointKey, *Response, FPlatformTime::Seconds());
+                RateLimiter.ReportTokenUsage(EndpointKey, EstimatedTokens, ReportedTotalTokens);
+            }
+        }
+
+        // 对冲的另一方已经先收到文本，本次传输作废
+        if (!bIsRequestComplete && HedgeRace.IsValid())
+        {
+            if (!bStreamResponse && bWasSuccessful && Response.IsValid() && EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+            {
+                ClaimHedgeRace();
+            }
+
+            const int32 Winner = HedgeRace->load();
+            if (Winner != 0 && Winner != HedgeSlot)
+            {
+                if (HedgeSlot == DeepSeekHedge::PrimarySlot)
+                {
+                    // 原请求等待对冲请求的结果
+                    ReleaseAttempt();
+                }
+                else
+                {
+                    FailRequest(TEXT("Hedged request lost the race"));
+                    ReleaseRequest();
+                }
+                return;
+            }
+        }
+
+        // 还没有收到任何文本就失败时，改为等待对冲请求，或者退避后重试
+        const bool bAttemptFailed = !bWasSuccessful || !Response.IsValid()
+            || !EHttpResponseCodes::IsOk(Response->GetResponseCode())
+            || (bStreamResponse && !bStreamFinished);
+        if (bAttemptFailed && !bIsRequestComplete && !bStreamFinished && StreamCharsReceived == 0)
+        {
+            if (YieldToHedge() || TryScheduleRetry(Response, bWasSuccessful))
+            {
+                return;
+            }
+        }
+
+        // 流中已经报告过错误并中止了请求
+        if (bIsRequestComplete && !bWasSuccessful)
+        {
+            ReleaseRequest();
+            return;
+        }
+
+        // 流式请求由流状态决定结果，响应体没有被缓存，不能再读取
+        if (bStreamResponse)
+        {
+            FinishStreamResponse(Response, bWasSuccessful);
+            ReleaseRequest();
+            return;
+        }
+        
+        // 请求完成，处理失败情况
+        if (!bWasSuccessful || !Response.IsValid())
+        {
+            FString ErrorMessage = TEXT("Request failed");
+            if (Response.IsValid())
+            {
+                ErrorMessage = FString::Printf(TEXT("Request failed with code %d: %s"), 
+                                           Response->GetResponseCode(), 
+                                           *Response->GetContentAsString());
+            }
+            FailRequest(ErrorMessage);
+            ReleaseRequest();
+            return;
+        }
+        
+        // 获取响应字符串
+        FString ResponseContent = Response->GetContentAsString();
+        DEEPSEEK_LOG_DEBUG(TEXT("Received response (length: %d bytes)"), ResponseContent.Len());
+        
+        // 非流式响应的全部内容同时到达
+        Metrics.MarkFirstByte();
+        Metrics.AddResponseBytes(Response->GetContent().Num());
+        Metrics.MarkToken();
+
+        // 非流式响应，解析JSON
+        TSharedPtr<FJsonObject> JsonResponse;
+        TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(ResponseContent);
+        
+        const uint64 ParseStartCycles = FPlatformTime::Cycles64();
+        const bool bParsed = FJsonSerializer::Deserialize(Reader, JsonResponse) && JsonResponse.IsValid();
+        Metrics.AddParseCycles(FPlatformTime::Cycles64() - ParseStartCycles);
+        
+        if (bParsed)
+        {
+            // 检查错误
+            if (JsonResponse->HasField(TEXT("error")))
+            {
+                const TSharedPtr<FJsonObject>* ErrorObj;
+                if (JsonResponse->TryGetObjectField(TEXT("error"), ErrorObj))
+                {
+                    FString ErrorMessage;
+                    if ((*ErrorObj)->TryGetStringField(TEXT("message"), ErrorMessage))
+                    {
+                        FailRequest(ErrorMessage);
+                        ReleaseRequest();
+                        return;
+                    }
+                }
+                FailRequest(TEXT("Unknown API error"));
+                ReleaseRequest();
+                return;
+            }
+            
+            // 记录usage中的token数和前缀缓存命中情况
+            const TSharedPtr<FJsonObject>* UsageObj;
+            if (JsonResponse->TryGetObjectField(TEXT("usage"), UsageObj))
+            {
+                int32 PromptTokens = 0, CompletionTokens = 0, CacheHitTokens = 0, CacheMissTokens = 0;
+                (*UsageObj)->TryGetNumberField(TEXT("prompt_tokens"), PromptTokens);
+                (*UsageObj)->TryGetNumberField(TEXT("completion_tokens"), CompletionTokens);
+                (*UsageObj)->TryGetNumberField(TEXT("prompt_cache_hit_tokens"), CacheHitTokens);
+                (*UsageObj)->TryGetNumberField(TEXT("prompt_cache_miss_tokens"), CacheMissTokens);
+                Metrics.SetReportedTokens(CompletionTokens);
+                Metrics.SetPromptUsage(PromptTokens, CacheHitTokens, CacheMissTokens);
+            }
+            
+            // 提取内容
+            const uint64 ExtractStartCycles = FPlatformTime::Cycles64();
+            FString Content = ExtractContentFromResponse(ResponseContent);
+            Metrics.AddParseCycles(FPlatformTime::Cycles64() - ExtractStartCycles);
+            CompleteRequest(Content);
+            StoreInCache(Response, Content);
+        }
+        else
+        {
+            // 无法解析JSON
+            CompleteRequest(ResponseContent);
+        }
+        
+        // 清理请求引用、释放调度名额并从根集移除
+        ReleaseRequest();
+    });
+
+    // 通过模块调度器发出，端点并发已满时按优先级排队
+    if (Module == nullptr)
+    {
+        DEEPSEEK_LOG_DEBUG(TEXT("Sending request..."));
+        Metrics.MarkSent(0.0);
+        bHttpStarted = true;
+        BeginConnection();
+        HttpRequest->ProcessRequest();
+        return;
+    }
+
+    DEEPSEEK_LOG_DEBUG(TEXT("Queueing request..."));
+    // 有空闲名额时回调会同步发出请求，句柄必须在此之前写入，同步结束时ReleaseAttempt才能释放名额
+    Module->GetScheduler().Submit(
+        SchedulerHandle,
+        EndpointKey,
+        RequestPriority,
+        EstimatedTokens,
+        [WeakThis = TWeakObjectPtr<UDeepSeekFunction>(this), HttpRequest](double QueueWaitSeconds)
+        {
+            if (WeakThis.IsValid())
+            {
+                WeakThis->Metrics.MarkSent(QueueWaitSeconds);
+                WeakThis->bHttpStarted = true;
+                WeakThis->BeginConnection();
+#if PAASAI_WITH_DEBUG_LOG
+                if (UNLIKELY(WeakThis->bDebug))
+                {
+                    WeakThis->LogDebug(FString::Printf(TEXT("Sending request after %.3fs in queue..."), QueueWaitSeconds));
+                }
+#endif
+            }
+            HttpRequest->ProcessRequest();
+        });
+}
+
+bool UDeepSeekFunction::TickStreamDelivery(float DeltaTime)
+{
+    FDeepSeekScopedGameThreadTime GameThreadTime(Metrics);
+    FlushStreamDeltas(false);
+    
+    // 模型长时间不输出标点时，按超时切出已收到的文本
+    if (bSegmentStream && !bIsRequestComplete && !bIsBeingDestroyed)
+    {
+        Segmenter.FlushIfExpired(FPlatformTime::Seconds(), [this](int32 Index, const FString& Segment) { BroadcastSegment(Index, Segment); });
+    }
+    return !bIsRequestComplete;
+}
+
+void UDeepSeekFunction::FlushStreamDeltas(bool bForce)
+{
+    // 已经完成或取消的请求不再发出剩余的文本
+    if (!IsStreamBatched() || bIsBeingDestroyed || bIsRequestComplete)
+    {
+        return;
+    }
+
+    // HTTP线程先入队最后的文本再设置结束标记，所以要先读取标记再取出队列，
+    // 看到结束标记时队列中一定已经包含全部文本
+    const bool bStreamEnded = bStreamEndSignalled.load(std::memory_order_acquire);
+
+    const double Now = FPlatformTime::Seconds();
+    FString Delta;
+    while (PendingDeltas.Dequeue(Delta))
+    {
+        if (PendingBatch.IsEmpty())
+        {
+            PendingBatchStartTime = Now;
+        }
+        PendingBatch.Append(Delta);
+    }
+
+    const bool bShouldFlush = bForce || bStreamEnded
+        || PendingBatch.Len() >= StreamBatchMinChars
+        || Now - PendingBatchStartTime >= StreamBatchMaxLatency;
+
+    if (bShouldFlush && !PendingBatch.IsEmpty())
+    {
+        // 上一帧以来的所有token只触发一次委托
+        AccumulatedStreamText.Append(PendingBatch);
+        UpdateStreamBufferStats();
+        OnStream.Broadcast(PendingBatch);
+        FeedStructuredOutput(PendingBatch);
+        FeedSegmenter(PendingBatch);
+        ForwardStreamToFollowers(PendingBatch);
+        PendingBatch.Reset();
+
+        // 自定义停止条件在游戏线程上检查
+        if (!bStreamEnded && StopPredicate && StopPredicate(AccumulatedStreamText))
+        {
+            bStreamFinished = true;
+            CompleteRequest(AccumulatedStreamText);
+            if (HttpRequestRef.IsValid())
+            {
+                HttpRequestRef->CancelRequest();
+            }
+            return;
+        }
+    }
+
+    if (bStreamEnded)
+    {
+        if (StreamEndError.IsEmpty())
+        {
+            CompleteRequest(AccumulatedStreamText);
+        }
+        else
+        {
+            FailRequest(StreamEndError);
+        }
+    }
+}
+
+void UDeepSeekFunction::FinishStreamResponse(const FHttpResponsePtr& Response, bool bWasSuccessful)
+{
+    DEEPSEEK_LOG_DEBUG(TEXT("Stream closed (received %lld bytes)"), Metrics.GetResponseBytes());
+
+    // 已经在流中收到[DONE]并完成
+    if (bIsRequestComplete)
+    {
+        if (bStreamFinished)
+        {
+            StoreInCache(Response, AccumulatedStreamText);
+        }
+        return;
+    }
+
+    const int32 ResponseCode = Response.IsValid() ? Response->GetResponseCode() : 0;
+    if (!bWasSuccessful || !EHttpResponseCodes::IsOk(ResponseCode) || !StreamParser.HasDispatchedEvent())
+    {
+        // 不是事件流，通常是错误JSON，只保留了开头一段
+        const FUtf8StringView RawBody = StreamParser.GetRawPrefix();
+        if (!RawBody.IsEmpty() && StreamDelta.Parse(RawBody) && !StreamDelta.ErrorMessage.IsEmpty())
+        {
+            FailRequest(StreamDelta.ErrorMessage);
+            return;
+        }
+
+        FUTF8ToTCHAR RawText(reinterpret_cast<const ANSICHAR*>(RawBody.GetData()), RawBody.Len());
+        FailRequest(FString::Printf(TEXT("Request failed with code %d: %s"),
+            ResponseCode, *FString(RawText.Length(), RawText.Get())));
+        return;
+    }
+
+    // 服务器返回了事件流，但在[DONE]或finish_reason之前断开
+    if (!bStreamFinished)
+    {
+        FailRequest(TEXT("Stream ended before completion"));
+        return;
+    }
+
+    CompleteRequest(AccumulatedStreamText);
+    StoreInCache(Response, AccumulatedStreamText);
+}
+
+void UDeepSeekFunction::StoreInCache(const FHttpResponsePtr& Response, const FString& Content) const
+{
+    // 缓存只保存文本，带函数调用的回答不缓存
+    if (!bStoreInCache || Content.IsEmpty() || ToolCalls.Num() > 0 || !Response.IsValid() || !EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+    {
+        return;
+    }
+
+    if (FPaasAIModuleModule* Module = FPaasAIModuleModule::Get())
+    {
+        Module->GetResponseCache().Add(RequestHash, Content);
+    }
+}
+
+void UDeepSeekFunction::ReplayCachedResponse(FString&& CachedResponse, bool bStream)
+{
+    // 延迟到下一帧，保证蓝图异步节点已经绑定好输出委托
+    DeferredTicker = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateWeakLambda(this,
+        [this, Response = MoveTemp(CachedResponse), bStream](float DeltaTime) mutable
+        {
+            DeferredTicker.Reset();
+            if (!bIsBeingDestroyed && !bIsRequestComplete)
+            {
+                AccumulatedStreamText = MoveTemp(Response);
+                if (bStream)
+                {
+                    OnStream.Broadcast(AccumulatedStreamText);
+                }
+                CompleteRequest(AccumulatedStreamText);
+            }
+            ReleaseRequest();
+            return false;
+        }));
+}
+
+void UDeepSeekFunction::CompleteRequest(const FString& Result)
+{
+    if (bIsRequestComplete)
+    {
+        return;
+    }
+
+    // 非流式、缓存回放和合并的请求没有逐段输入，在这里一次性解析
+    if (bStructuredOutput && !StructuredParser.HasInput())
+    {
+        FeedStructuredOutput(Result);
+    }
+    
+    // 最后一句没有结尾标点，在OnCompleted之前发出
+    if (bSegmentStream)
+    {
+        if (!Segmenter.HasInput())
+        {
+            FeedSegmenter(Result);
+        }
+        Segmenter.Finish([this](int32 Index, const FString& Segment) { BroadcastSegment(Index, Segment); });
+    }
+    
+    bIsRequestComplete = true;
+    UnregisterInFlight();
+    Metrics.Finish(true);
+    if (ToolCalls.Num() > 0)
+    {
+        OnToolCalls.Broadcast(ToolCalls);
+    }
+    OnCompleted.Broadcast(Result);
+    ForwardResultToFollowers(true, Result);
+    OnFinishedNative.ExecuteIfBound(true, Result, LastResponseCode);
+}
+
+void UDeepSeekFunction::FailRequest(const FString& ErrorMessage)
+{
+    if (bIsRequestComplete)
+    {
+        return;
+    }
+
+    bIsRequestComplete = true;
+    UnregisterInFlight();
+    Metrics.Finish(false);
+    OnFailed.Broadcast(ErrorMessage);
+    DEEPSEEK_LOG_DEBUG_ERROR(TEXT("Error: %s"), *ErrorMessage);
+    ForwardResultToFollowers(false, ErrorMessage);
+    OnFinishedNative.ExecuteIfBound(false, ErrorMessage, LastResponseCode);
+}
+
+void UDeepSeekFunction::Cancel()
+{
+    CancelRequest(TEXT("Request cancelled"));
+}
+
+void UDeepSeekFunction::CancelRequest(const FString& Reason)
+{
+    if (bIsRequestComplete || bIsBeingDestroyed)
+    {
+        return;
+    }
+
+    bIsRequestComplete = true;
+    UnregisterInFlight();
+
+    // 作为跟随者时不再接收原请求转发的文本
+    if (UDeepSeekFunction* Leader = InFlightLeader.Get())
+    {
+        FScopeLock LeaderLock(&Leader->FollowersLock);
+        Leader->Followers.RemoveSingleSwap(this);
+    }
+    InFlightLeader.Reset();
+    CancelHedge();
+
+    Metrics.Finish(false);
+    OnCancelled.Broadcast(Reason);
+    DEEPSEEK_LOG_DEBUG(TEXT("Cancelled: %s"), *Reason);
+    ForwardResultToFollowers(false, Reason);
+    OnFinishedNative.ExecuteIfBound(false, Reason, 0);
+
+    // 已经发出的请求在HTTP完成回调中释放，否则(排队中、缓存回放、跟随者)立即释放
+    if (bHttpStarted && HttpRequestRef.IsValid())
+    {
+        HttpRequestRef->CancelRequest();
+    }
+    else
+    {
+        ReleaseRequest();
+    }
+}
+
+bool UDeepSeekFunction::TickDeadline(float DeltaTime)
+{
+    if (bIsRequestComplete)
+    {
+        DeadlineTicker.Reset();
+        return false;
+    }
+
+    const double Elapsed = FPlatformTime::Seconds() - RequestStartTime;
+    const TCHAR* Reason = nullptr;
+    if (TimeoutSeconds > 0.0f && Elapsed >= TimeoutSeconds)
+    {
+        Reason = TEXT("Request timed out");
+    }
+    else if (FirstTokenTimeoutSeconds > 0.0f && Elapsed >= FirstTokenTimeoutSeconds && !Metrics.HasFirstToken())
+    {
+        Reason = TEXT("Timed out waiting for the first token");
+    }
+
+    if (Reason != nullptr)
+    {
+        DeadlineTicker.Reset();
+        CancelRequest(Reason);
+        return false;
+    }
+
+    // 原请求先收到文本时取消对冲请求，超过阈值仍没有文本时发出对冲请求
+    if (HedgeRace.IsValid() && HedgeSlot == DeepSeekHedge::PrimarySlot)
+    {
+        const int32 Winner = HedgeRace->load();
+        if (Winner == DeepSeekHedge::PrimarySlot)
+        {
+            CancelHedge();
+        }
+        else if (Winner == 0 && !bHedgeLaunched && Elapsed >= HedgeAfterSeconds && !Metrics.HasFirstToken())
+        {
+            LaunchHedge();
+        }
+    }
+    return true;
+}
+
+bool UDeepSeekFunction::IsRetryableResponseCode(int32 ResponseCode)
+{
+    return ResponseCode == 0 || ResponseCode == 408 || ResponseCode == 429 || ResponseCode >= 500;
+}
+
+bool UDeepSeekFunction::TryScheduleRetry(const FHttpResponsePtr& Response, bool bWasSuccessful)
+{
+    if (RetryCount >= MaxRetries)
+    {
+        return false;
+    }
+
+    // 只重试超时、限流和服务器错误；流式请求可能以200结束但没有收到结束标记，同样重试
+    const int32 ResponseCode = (bWasSuccessful && Response.IsValid()) ? Response->GetResponseCode() : 0;
+    if (!EHttpResponseCodes::IsOk(ResponseCode) && !IsRetryableResponseCode(ResponseCode))
+    {
+        return false;
+    }
+
+    // 指数退避，在一半到全部之间随机取值，避免多个客户端同时重试
+    const float Backoff = FMath::Min(RetryMaxDelay, RetryBaseDelay * static_cast<float>(1 << FMath::Min(RetryCount, 16)));
+    const float Delay = Backoff * FMath::FRandRange(0.5f, 1.0f);
+
+    // 等待后已经超过总超时，不再重试
+    if (TimeoutSeconds > 0.0f && FPlatformTime::Seconds() + Delay - RequestStartTime >= TimeoutSeconds)
+    {
+        return false;
+    }
+
+    ++RetryCount;
+    Metrics.AddRetry();
+    INC_DWORD_STAT(STAT_PaasAI_Retries);
+    DEEPSEEK_LOG_DEBUG(TEXT("Attempt failed with code %d, retry %d/%d in %.2fs"), ResponseCode, RetryCount, MaxRetries, Delay);
+
+    // 没有收到过文本，只需要重置解析状态
+    ReleaseAttempt();
+    StreamParser.Reset();
+    StreamDelta.Reset();
+    bStreamFinished = false;
+    bStreamEndSignalled = false;
+    StreamEndError.Reset();
+    StopScanTail.Reset();
+    ToolCalls.Reset();
+    ReportedTotalTokens = 0;
+
+    DeferredTicker = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateWeakLambda(this,
+        [this](float DeltaTime)
+        {
+            DeferredTicker.Reset();
+            if (!bIsBeingDestroyed && !bIsRequestComplete)
+            {
+                StartAttempt(TArray<uint8>(RetryBody));
+            }
+            return false;
+        }), Delay);
+    return true;
+}
+
+bool UDeepSeekFunction::ClaimHedgeRace()
+{
+    if (!HedgeRace.IsValid())
+    {
+        return true;
+    }
+
+    int32 Winner = 0;
+    return HedgeRace->compare_exchange_strong(Winner, HedgeSlot) || Winner == HedgeSlot;
+}
+
+void UDeepSeekFunction::LaunchHedge()
+{
+    bHedgeLaunched = true;
+    if (!HedgeParams.IsSet())
+    {
+        return;
+    }
+
+    FDeepSeekRequestParams Params = MoveTemp(HedgeParams.GetValue());
+    HedgeParams.Reset();
+    // 指定了备用URL时不经过端点池，否则从池中选择原请求以外的端点
+    if (!Params.HedgeURL.IsEmpty())
+    {
+        Params.URL = Params.HedgeURL;
+        Params.bUseEndpointPool = false;
+    }
+    if (!Params.HedgeAPIKey.IsEmpty())
+    {
+        Params.APIKey = Params.HedgeAPIKey;
+    }
+
+    // 对冲请求本身不再重试、对冲或合并，超时由原请求负责
+    Params.MaxRetries = 0;
+    Params.HedgeAfterSeconds = 0.0f;
+    Params.TimeoutSeconds = 0.0f;
+    Params.FirstTokenTimeoutSeconds = 0.0f;
+    Params.bUseCache = false;
+    Params.bCoalesceInFlight = false;
+    
+    // 结构化字段和句子由原请求在转交文本时解析
+    Params.StructuredOutputStruct = nullptr;
+    Params.StructuredOutputTarget = nullptr;
+    Params.bSegmentStream = false;
+
+    // 输出和结果在游戏线程上转交给原请求
+    Params.StreamDelivery = EDeepSeekStreamDelivery::GameThreadBatched;
+    Params.StreamBatchMinChars = 0;
+    Params.StreamBatchMaxLatency = 0.0f;
+
+    FPaasAIModuleModule* Module = FPaasAIModuleModule::Get();
+    UDeepSeekFunction* Hedge = Module ? Module->GetRequestPool().Acquire() : NewObject<UDeepSeekFunction>();
+    Hedge->bRecyclable = true;
+    Hedge->bDebug = bDebug;
+    Hedge->HedgeRace = HedgeRace;
+    Hedge->HedgeSlot = DeepSeekHedge::BackupSlot;
+    Hedge->ExcludedEndpointId = EndpointLeaseId;
+    Hedge->OnStream.AddDynamic(this, &UDeepSeekFunction::HandleHedgeStream);
+    Hedge->OnFinishedNative.BindUObject(this, &UDeepSeekFunction::HandleHedgeFinished);
+    HedgeRequest = Hedge;
+
+    Metrics.SetHedged();
+    INC_DWORD_STAT(STAT_PaasAI_HedgesSent);
+    DEEPSEEK_LOG_DEBUG(TEXT("No first token after %.2fs, sending hedged request to %s"), HedgeAfterSeconds, *Params.URL);
+
+    Hedge->ExecuteRequest(Params);
+}
+
+void UDeepSeekFunction::CancelHedge()
+{
+    UDeepSeekFunction* Hedge = HedgeRequest.Get();
+    HedgeRequest.Reset();
+    if (Hedge != nullptr)
+    {
+        Hedge->OnStream.RemoveAll(this);
+        Hedge->OnFinishedNative.Unbind();
+        Hedge->Cancel();
+    }
+}
+
+bool UDeepSeekFunction::YieldToHedge()
+{
+    if (!HedgeRace.IsValid() || !HedgeRequest.IsValid())
+    {
+        return false;
+    }
+
+    int32 Winner = 0;
+    if (!HedgeRace->compare_exchange_strong(Winner, DeepSeekHedge::BackupSlot) && Winner != DeepSeekHedge::BackupSlot)
+    {
+        return false;
+    }
+
+    DEEPSEEK_LOG_DEBUG(TEXT("Attempt failed, waiting for the hedged request"));
+    ReleaseAttempt();
+    return true;
+}
+
+void UDeepSeekFunction::HandleHedgeStream(FString Delta)
+{
+    if (bIsRequestComplete || bIsBeingDestroyed || !HedgeRace.IsValid() || HedgeRace->load() != DeepSeekHedge::BackupSlot)
+    {
+        return;
+    }
+
+    // 对冲请求胜出，立即中止原请求的传输
+    if (!bHedgeWon)
+    {
+        bHedgeWon = true;
+        Metrics.SetHedgeWon();
+        INC_DWORD_STAT(STAT_PaasAI_HedgesWon);
+        DEEPSEEK_LOG_DEBUG(TEXT("Hedged request won"));
+        AbandonAttempt();
+    }
+
+    Metrics.MarkFirstByte();
+    Metrics.MarkToken();
+    AccumulatedStreamText.Append(Delta);
+    UpdateStreamBufferStats();
+    OnStream.Broadcast(Delta);
+    FeedStructuredOutput(Delta);
+    FeedSegmenter(Delta);
+    ForwardStreamToFollowers(Delta);
+}
+
+void UDeepSeekFunction::HandleHedgeFinished(bool bSuccess, const FString& Result, int32 ResponseCode)
+{
+    const UDeepSeekFunction* Hedge = HedgeRequest.Get();
+    HedgeRequest.Reset();
+
+    // 对冲请求失败或落后时原请求继续
+    if (bIsRequestComplete || bIsBeingDestroyed || !HedgeRace.IsValid() || HedgeRace->load() != DeepSeekHedge::BackupSlot)
+    {
+        return;
+    }
+
+    LastResponseCode = ResponseCode;
+
+    if (bSuccess)
+    {
+        // 流式文本已经逐段转交，函数调用在结束时一次性转交
+        if (!bStreamResponse)
+        {
+            AccumulatedStreamText = Result;
+        }
+        if (Hedge != nullptr)
+        {
+            ToolCalls = Hedge->ToolCalls;
+        }
+        CompleteRequest(Result);
+    }
+    else
+    {
+        FailRequest(Result);
+    }
+
+    // 原请求的传输还没结束时由HTTP完成回调释放
+    if (bHttpStarted && HttpRequestRef.IsValid())
+    {
+        HttpRequestRef->CancelRequest();
+    }
+    else
+    {
+        ReleaseRequest();
+    }
+}
+
+bool UDeepSeekFunction::ApplyStopConditions(FString& Delta)
+{
+    bool bStop = false;
+
+    // 停止字符串可能跨越多个数据块，带上一块末尾的几个字符一起查找
+    if (StopStrings.Num() > 0)
+    {
+        const FString Window = StopScanTail + Delta;
+        int32 StopIndex = INDEX_NONE;
+        for (const FString& StopString : StopStrings)
+        {
+            const int32 Found = Window.Find(StopString, ESearchCase::CaseSensitive);
+            if (Found != INDEX_NONE && (StopIndex == INDEX_NONE || Found < StopIndex))
+            {
+                StopIndex = Found;
+            }
+        }
+
+        if (StopIndex != INDEX_NONE)
+        {
+            // 停止字符串开头已经在上一块中发出的部分无法撤回
+            Delta.LeftInline(FMath::Max(0, StopIndex - StopScanTail.Len()));
+            bStop = true;
+        }
+        else
+        {
+            StopScanTail = Window.Right(MaxStopStringLen - 1);
+        }
+    }
+
+    if (MaxResponseChars > 0 && StreamCharsReceived + Delta.Len() >= MaxResponseChars)
+    {
+        Delta.LeftInline(MaxResponseChars - StreamCharsReceived);
+        bStop = true;
+    }
+    StreamCharsReceived += Delta.Len();
+    return bStop;
+}
+
+void UDeepSeekFunction::StopStream()
+{
+    // 与收到[DONE]相同，按正常结束处理；调用方返回false后HTTP层中止传输
+    bStreamFinished = true;
+    if (IsStreamBatched())
+    {
+        bStreamEndSignalled = true;
+    }
+    else
+    {
+        CompleteRequest(AccumulatedStreamText);
+    }
+}
+
+void UDeepSeekFunction::UnregisterInFlight()
+{
+    if (!bIsInFlightLeader)
+    {
+        return;
+    }
+
+    // 结束后新的相同请求不再合并到这里
+    FScopeLock InFlightLock(&DeepSeekInFlight::Lock);
+    const TWeakObjectPtr<UDeepSeekFunction>* Existing = DeepSeekInFlight::Leaders.Find(RequestHash);
+    if (Existing != nullptr && (!Existing->IsValid() || Existing->Get() == this))
+    {
+        DeepSeekInFlight::Leaders.Remove(RequestHash);
+    }
+    bIsInFlightLeader = false;
+}
+
+bool UDeepSeekFunction::AttachFollower(UDeepSeekFunction* Follower, bool bFollowerStream)
+{
+    FScopeLock ScopeLock(&FollowersLock);
+    if (bIsRequestComplete || bIsBeingDestroyed)
+    {
+        return false;
+    }
+
+    // 已经收到的文本先缓存在跟随者中，下一帧再一次性回放
+    {
+        FScopeLock FollowerLock(&Follower->FollowersLock);
+        Follower->AccumulatedStreamText = AccumulatedStreamText;
+        Follower->bFollowerStream = bFollowerStream;
+        Follower->bFollowerReady = false;
+        Follower->bLeaderFinished = false;
+    }
+    Follower->InFlightLeader = this;
+    Followers.Add(Follower);
+
+    Follower->DeferredTicker = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(Follower, &UDeepSeekFunction::TickFollower));
+    return true;
+}
+
+void UDeepSeekFunction::ForwardStreamToFollowers(const FString& Content)
+{
+    FScopeLock ScopeLock(&FollowersLock);
+    for (const TWeakObjectPtr<UDeepSeekFunction>& Follower : Followers)
+    {
+        if (UDeepSeekFunction* FollowerPtr = Follower.Get())
+        {
+            FScopeLock FollowerLock(&FollowerPtr->FollowersLock);
+            if (FollowerPtr->bIsRequestComplete)
+            {
+                continue;
+            }
+            FollowerPtr->AccumulatedStreamText.Append(Content);
+            if (FollowerPtr->bFollowerReady && FollowerPtr->bFollowerStream)
+            {
+                FollowerPtr->OnStream.Broadcast(Content);
+            }
+        }
+    }
+}
+
+void UDeepSeekFunction::ForwardResultToFollowers(bool bSuccess, const FString& Result)
+{
+    FScopeLock ScopeLock(&FollowersLock);
+    for (const TWeakObjectPtr<UDeepSeekFunction>& Follower : Followers)
+    {
+        if (UDeepSeekFunction* FollowerPtr = Follower.Get())
+        {
+            // 结果在跟随者自己的游戏线程tick中处理
+            FScopeLock FollowerLock(&FollowerPtr->FollowersLock);
+            FollowerPtr->bLeaderFinished = true;
+            FollowerPtr->bLeaderSucceeded = bSuccess;
+            FollowerPtr->LeaderResult = Result;
+            FollowerPtr->LastResponseCode = LastResponseCode;
+            FollowerPtr->ToolCalls = ToolCalls;
+        }
+    }
+    Followers.Empty();
+}
+
+bool UDeepSeekFunction::TickFollower(float DeltaTime)
+{
+    if (bIsBeingDestroyed)
+    {
+        return false;
+    }
+
+    bool bFinished = false;
+    bool bSucceeded = false;
+    FString Result;
+    {
+        FScopeLock ScopeLock(&FollowersLock);
+
+        // 第一帧：蓝图已绑定委托，回放合并前已收到的文本
+        if (!bFollowerReady)
+        {
+            bFollowerReady = true;
+            if (bFollowerStream && !AccumulatedStreamText.IsEmpty())
+            {
+                OnStream.Broadcast(AccumulatedStreamText);
+            }
+        }
+
+        bFinished = bLeaderFinished;
+        bSucceeded = bLeaderSucceeded;
+        Result = LeaderResult;
+    }
+
+    if (!bFinished)
+    {
+        if (InFlightLeader.IsValid())
+        {
+            return true;
+        }
+        bFinished = true;
+        bSucceeded = false;
+        Result = TEXT("Request cancelled");
+    }
+
+    if (bSucceeded)
+    {
+        // 非流式的原请求没有逐段转发，补发一次完整文本
+        if (bFollowerStream && AccumulatedStreamText.IsEmpty() && !Result.IsEmpty())
+        {
+            OnStream.Broadcast(Result);
+        }
+        AccumulatedStreamText = Result;
+        CompleteRequest(Result);
+    }
+    else
+    {
+        FailRequest(Result);
+    }
+
+    InFlightLeader.Reset();
+    DeferredTicker.Reset();
+    ReleaseRequest();
+    return false;
+}
+
+bool UDeepSeekFunction::HandleStreamData(FUtf8StringView EventData)
+{
+    // 防止在对象销毁过程中处理数据
+    if (bIsBeingDestroyed)
+    {
+        return false;
+    }
+
+    // 检查结束标记
+    if (EventData.TrimStartAndEnd().Equals(UTF8TEXTVIEW("[DONE]")))
+    {
+        bStreamFinished = true;
+        
+        // 流式响应结束，合并投递时交给游戏线程结束请求
+        if (IsStreamBatched())
+        {
+            bStreamEndSignalled = true;
+        }
+        else
+        {
+            CompleteRequest(AccumulatedStreamText);
+        }
+        return true;
+    }
+
+    // 直接从UTF-8字节中提取choices[0].delta.content等字段，不构建JSON对象树
+    bool bParsed;
+    {
+        SCOPE_CYCLE_COUNTER(STAT_PaasAI_ParseResponse);
+        const uint64 ParseStartCycles = FPlatformTime::Cycles64();
+        bParsed = StreamDelta.Parse(EventData);
+        Metrics.AddParseCycles(FPlatformTime::Cycles64() - ParseStartCycles);
+    }
+    if (!bParsed)
+    {
+        return true;
+    }
+
+    // 流中返回的错误
+    if (!StreamDelta.ErrorMessage.IsEmpty())
+    {
+        if (IsStreamBatched())
+        {
+            StreamEndError = StreamDelta.ErrorMessage;
+            bStreamEndSignalled = true;
+        }
+        else
+        {
+            FailRequest(StreamDelta.ErrorMessage);
+        }
+        return false;
+    }
+
+    // 对冲的另一方已经先收到文本或函数调用
+    if ((!StreamDelta.Content.IsEmpty() || StreamDelta.ToolCalls.Num() > 0) && !ClaimHedgeRace())
+    {
+        return false;
+    }
+
+    if (StreamDelta.ToolCalls.Num() > 0)
+    {
+        Metrics.MarkToken();
+        AppendToolCallFragments();
+    }
+
+    // 停止字符串和最大字符数在HTTP线程上检查，命中后立即停止接收
+    bool bStopStream = false;
+    if (!StreamDelta.Content.IsEmpty())
+    {
+        bStopStream = ApplyStopConditions(StreamDelta.Content);
+    }
+
+    if (!StreamDelta.Content.IsEmpty())
+    {
+        Metrics.MarkToken();
+        
+        if (IsStreamBatched())
+        {
+            // 交给游戏线程合并发出
+            PendingDeltas.Enqueue(StreamDelta.Content);
+        }
+        else
+        {
+            // 累积文本
+            AccumulatedStreamText.Append(StreamDelta.Content);
+            UpdateStreamBufferStats();
+
+            // 触发事件，并转发给合并到本请求的其他请求
+            OnStream.Broadcast(StreamDelta.Content);
+            FeedStructuredOutput(StreamDelta.Content);
+            FeedSegmenter(StreamDelta.Content);
+            ForwardStreamToFollowers(StreamDelta.Content);
+
+            if (StopPredicate && StopPredicate(AccumulatedStreamText))
+            {
+                bStopStream = true;
+            }
+        }
+        DEEPSEEK_LOG_TOKEN(TEXT("Stream content length: %d"), StreamDelta.Content.Len());
+    }
+
+    // finish_reason之后只会再有usage和[DONE]，连接提前关闭也视为正常结束
+    if (!StreamDelta.FinishReason.IsEmpty())
+    {
+        bStreamFinished = true;
+    }
+
+    if (StreamDelta.bHasUsage)
+    {
+        ReportedTotalTokens = StreamDelta.TotalTokens;
+        Metrics.SetReportedTokens(StreamDelta.CompletionTokens);
+        Metrics.SetPromptUsage(StreamDelta.PromptTokens, StreamDelta.PromptCacheHitTokens, StreamDelta.PromptCacheMissTokens);
+        DEEPSEEK_LOG_DEBUG(TEXT("Usage: prompt %d, completion %d, total %d"),
+            StreamDelta.PromptTokens, StreamDelta.CompletionTokens, StreamDelta.TotalTokens);
+    }
+
+    if (bStopStream)
+    {
+        DEEPSEEK_LOG_DEBUG(TEXT("Stop condition reached, aborting stream"));
+        StopStream();
+        return false;
+    }
+    return true;
+}
+
+FString UDeepSeekFunction::ExtractContentFromResponse(const FString& ResponseString)
+{
+    TSharedPtr<FJsonObject> JsonResponse;
+    TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(ResponseString);
+    
+    if (FJsonSerializer::Deserialize(Reader, JsonResponse))
+    {
+        // 获取choices
+        const TArray<TSharedPtr<FJsonValue>>* Choices = nullptr;
+        if (JsonResponse->TryGetArrayField(TEXT("choices"), Choices) && Choices->Num() > 0)
+        {
+            // 获取message
+            TSharedPtr<FJsonObject> ChoiceObject = (*Choices)[0]->AsObject();
+            const TSharedPtr<FJsonObject>* MessageObject = nullptr;
+            
+            if (ChoiceObject->TryGetObjectField(TEXT("message"), MessageObject))
+            {
+                // 只有函数调用时content为null
+                ExtractToolCalls(*MessageObject);
+                FString Content;
+                if ((*MessageObject)->TryGetStringField(TEXT("content"), Content) || ToolCalls.Num() > 0)
+                {
+                    return Content;
+                }
+            }
+        }
+    }
+    
+    // 无法解析
+    return ResponseString;
+}
+
+void UDeepSeekFunction::AppendToolCallFragments()
+{
+    // 同一个调用的片段按下标拼接，参数只追加，完整后才由调用方解析
+    for (FDeepSeekStreamDelta::FToolCallFragment& Fragment : StreamDelta.ToolCalls)
+    {
+        if (Fragment.Index < 0 || Fragment.Index >= DeepSeekTools::MaxToolCalls)
+        {
+            continue;
+        }
+        if (ToolCalls.Num() <= Fragment.Index)
+        {
+            ToolCalls.SetNum(Fragment.Index + 1);
+        }
+
+        FDeepSeekToolCall& ToolCall = ToolCalls[Fragment.Index];
+        if (!Fragment.Id.IsEmpty())
+        {
+            ToolCall.Id = MoveTemp(Fragment.Id);
+        }
+        ToolCall.Name.Append(Fragment.Name);
+        ToolCall.Arguments.Append(Fragment.Arguments);
+    }
+}
+
+void UDeepSeekFunction::ExtractToolCalls(const TSharedPtr<FJsonObject>& MessageObject)
+{
+    const TArray<TSharedPtr<FJsonValue>>* ToolCallValues = nullptr;
+    if (!MessageObject->TryGetArrayField(TEXT("tool_calls"), ToolCallValues))
+    {
+        return;
+    }
+
+    for (const TSharedPtr<FJsonValue>& Value : *ToolCallValues)
+    {
+        const TSharedPtr<FJsonObject>* CallObject = nullptr;
+        if (!Value.IsValid() || !Value->TryGetObject(CallObject))
+        {
+            continue;
+        }
+
+        FDeepSeekToolCall& ToolCall = ToolCalls.AddDefaulted_GetRef();
+        (*CallObject)->TryGetStringField(TEXT("id"), ToolCall.Id);
+
+        const TSharedPtr<FJsonObject>* FunctionObject = nullptr;
+        if ((*CallObject)->TryGetObjectField(TEXT("function"), FunctionObject))
+        {
+            (*FunctionObject)->TryGetStringField(TEXT("name"), ToolCall.Name);
+            (*FunctionObject)->TryGetStringField(TEXT("arguments"), ToolCall.Arguments);
+        }
+    }
+}
+
+void UDeepSeekFunction::FeedStructuredOutput(FStringView Text)
+{
+    if (bStructuredOutput && !StructuredParser.IsComplete())
+    {
+        StructuredParser.Feed(Text, [this](const FString& Name, const FString& RawValue) { HandleStructuredField(Name, RawValue); });
+    }
+}
+
+void UDeepSeekFunction::HandleStructuredField(const FString& Name, const FString& RawValue)
+{
+    // 只解析这一个字段的值，包在数组中交给JSON读取器
+    TArray<TSharedPtr<FJsonValue>> Values;
+    TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(FString::Printf(TEXT("[%s]"), *RawValue));
+    if (!FJsonSerializer::Deserialize(Reader, Values) || Values.Num() != 1 || !Values[0].IsValid())
+    {
+        DEEPSEEK_LOG_DEBUG_ERROR(TEXT("Malformed structured field %s: %s"), *Name, *RawValue);
+        return;
+    }
+
+    const TSharedPtr<FJsonValue>& Value = Values[0];
+    if (StructuredOutputStruct != nullptr)
+    {
+        FProperty* Property = StructuredOutputStruct->FindPropertyByName(FName(*Name));
+        for (TFieldIterator<FProperty> It(StructuredOutputStruct); It && Property == nullptr; ++It)
+        {
+            if (It->GetName().Equals(Name, ESearchCase::IgnoreCase))
+            {
+                Property = *It;
+            }
+        }
+        if (Property != nullptr)
+        {
+            FJsonObjectConverter::JsonValueToUProperty(Value, Property, Property->ContainerPtrToValuePtr<void>(StructuredOutputTarget));
+        }
+    }
+
+    OnStructuredField.Broadcast(Name, Value->Type == EJson::String ? Value->AsString() : RawValue);
+}
+
+void UDeepSeekFunction::FeedSegmenter(FStringView Text)
+{
+    if (!bSegmentStream)
+    {
+        return;
+    }
+
+    const double Now = FPlatformTime::Seconds();
+    auto Emit = [this](int32 Index, const FString& Segment) { BroadcastSegment(Index, Segment); };
+    Segmenter.Feed(Text, Now, Emit);
+    
+    // 逐token投递时没有游戏线程的定时检查，收到文本时顺便检查等待超时
+    if (!IsStreamBatched())
+    {
+        Segmenter.FlushIfExpired(Now, Emit);
+    }
+}
+
+void UDeepSeekFunction::BroadcastSegment(int32 Index, const FString& Segment)
+{
+    DEEPSEEK_LOG_TOKEN(TEXT("Segment %d length: %d"), Index, Segment.Len());
+    OnSegment.Broadcast(Index, Segment);
+}
@@ -0,0 +1,279 @@
+﻿// DeepSeekBatch.cpp
+#include "DeepSeekBatch.h"
+#include "DeepSeekRequestWriter.h"
+#include "Containers/Ticker.h"
+#include "Misc/FileHelper.h"
+#include "Json.h"
+
+namespace DeepSeekBatch
+{
+    // 第一次重试前等待的秒数，之后每次加倍
+    static constexpr float RetryBaseDelay = 1.0f;
+
+    static const TCHAR* CustomIdPrefix = TEXT("item-");
+
+    // 取出URL中的路径部分，批处理文件只需要相对路径
+    static FString GetUrlPath(const FString& URL)
+    {
+        const int32 SchemeEnd = URL.Find(TEXT("://"));
+        const int32 PathStart = URL.Find(TEXT("/"), ESearchCase::CaseSensitive, ESearchDir::FromStart, SchemeEnd == INDEX_NONE ? 0 : SchemeEnd + 3);
+        return PathStart == INDEX_NONE ? FString(TEXT("/")) : URL.RightChop(PathStart);
+    }
+
+    // 从chat-completion响应对象中取出choices[0].message.content
+    static bool ExtractContent(const TSharedPtr<FJsonObject>& Body, FString& OutContent)
+    {
+        const TArray<TSharedPtr<FJsonValue>>* Choices = nullptr;
+        if (!Body.IsValid() || !Body->TryGetArrayField(TEXT("choices"), Choices) || Choices->Num() == 0)
+        {
+            return false;
+        }
+
+        const TSharedPtr<FJsonObject> Choice = (*Choices)[0]->AsObject();
+        const TSharedPtr<FJsonObject>* Message = nullptr;
+        return Choice.IsValid()
+            && Choice->TryGetObjectField(TEXT("message"), Message)
+            && (*Message)->TryGetStringField(TEXT("content"), OutContent);
+    }
+}
+
+UDeepSeekBatch* UDeepSeekBatch::SendBatchRequest(const TArray<FDeepSeekRequestParams>& InItems, int32 InMaxConcurrency, int32 InMaxRetries)
+{
+    UDeepSeekBatch* Batch = NewObject<UDeepSeekBatch>();
+    Batch->Items = InItems;
+    Batch->MaxConcurrency = FMath::Max(1, InMaxConcurrency);
+    Batch->MaxRetries = FMath::Clamp(InMaxRetries, 0, 255);
+    return Batch;
+}
+
+UDeepSeekBatch* UDeepSeekBatch::QuickSendBatch(
+    const FString& APIKey,
+    const TArray<FString>& Prompts,
+    const FString& SystemPrompt,
+    const FString& Model,
+    int32 InMaxConcurrency)
+{
+    // 系统提示只编码一次，所有条目共享
+    TSharedPtr<TArray<uint8>> EncodedSystem;
+    if (!SystemPrompt.IsEmpty())
+    {
+        EncodedSystem = MakeShared<TArray<uint8>>();
+        FDeepSeekRequestWriter::AppendMessage(*EncodedSystem, FDeepSeekMessage(TEXT("system"), SystemPrompt));
+        FDeepSeekRequestWriter::AppendLiteral(*EncodedSystem, ",");
+    }
+
+    TArray<FDeepSeekRequestParams> BatchItems;
+    BatchItems.SetNum(Prompts.Num());
+    for (int32 Index = 0; Index < Prompts.Num(); ++Index)
+    {
+        FDeepSeekRequestParams& Params = BatchItems[Index];
+        Params.APIKey = APIKey;
+        Params.Model = Model;
+        Params.Priority = EDeepSeekRequestPriority::Background;
+
+        if (EncodedSystem.IsValid())
+        {
+            TSharedPtr<TArray<uint8>> Encoded = MakeShared<TArray<uint8>>(*EncodedSystem);
+            FDeepSeekRequestWriter::AppendMessage(*Encoded, FDeepSeekMessage(TEXT("user"), Prompts[Index]));
+            Params.EncodedMessages = Encoded;
+        }
+        else
+        {
+            Params.Messages.Add(FDeepSeekMessage(TEXT("user"), Prompts[Index]));
+        }
+    }
+
+    return SendBatchRequest(BatchItems, InMaxConcurrency);
+}
+
+void UDeepSeekBatch::Activate()
+{
+    if (bActivated)
+    {
+        return;
+    }
+    bActivated = true;
+
+    // 所有条目结束前保持存活
+    AddToRoot();
+
+    Results.SetNum(Items.Num());
+    Attempts.SetNumZeroed(Items.Num());
+
+    if (Items.Num() == 0)
+    {
+        OnCompleted.Broadcast(0, 0);
+        OnCompletedNative.ExecuteIfBound(0, 0);
+        SetReadyToDestroy();
+        RemoveFromRoot();
+        return;
+    }
+
+    // 激活前已经取消
+    if (bCancelled)
+    {
+        Cancel();
+        return;
+    }
+
+    Pump();
+}
+
+void UDeepSeekBatch::Cancel()
+{
+    bCancelled = true;
+    if (!bActivated)
+    {
+        return;
+    }
+
+    // 尚未发出的条目直接以失败结束
+    while (NextItem < Items.Num())
+    {
+        FinishItem(NextItem++, false, TEXT("Batch cancelled"));
+    }
+}
+
+void UDeepSeekBatch::Pump()
+{
+    while (!bCancelled && NumInFlight < MaxConcurrency && NextItem < Items.Num())
+    {
+        ++NumInFlight;
+        LaunchItem(NextItem++);
+    }
+}
+
+void UDeepSeekBatch::LaunchItem(int32 Index)
+{
+    // 批量条目只关心最终结果，不使用流式传输
+    FDeepSeekRequestParams& Params = Items[Index];
+    Params.bStream = false;
+
+    UDeepSeekFunction* Request = UDeepSeekFunction::SendPooledRequest(Params);
+    Request->OnFinishedNative.BindUObject(this, &UDeepSeekBatch::HandleItemFinished, Index);
+}
+
+void UDeepSeekBatch::HandleItemFinished(bool bSuccess, const FString& Result, int32 ResponseCode, int32 Index)
+{
+    // 只重试连接失败、超时、限流和服务器错误，参数和鉴权错误重试也不会成功
+    if (!bSuccess && !bCancelled && Attempts[Index] < MaxRetries && UDeepSeekFunction::IsRetryableResponseCode(ResponseCode))
+    {
+        // 指数退避后重试，期间继续占用并发名额
+        const float Delay = DeepSeekBatch::RetryBaseDelay * static_cast<float>(1 << FMath::Min<int32>(Attempts[Index], 6));
+        ++Attempts[Index];
+        FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateWeakLambda(this, [this, Index](float DeltaTime)
+        {
+            // 等待重试期间批次被取消时不再发出
+            if (bCancelled)
+            {
+                --NumInFlight;
+                FinishItem(Index, false, TEXT("Batch cancelled"));
+                return false;
+            }
+            LaunchItem(Index);
+            return false;
+        }), Delay);
+        return;
+    }
+
+    --NumInFlight;
+    FinishItem(Index, bSuccess, Result);
+    Pump();
+}
+
+void UDeepSeekBatch::FinishItem(int32 Index, bool bSuccess, const FString& Result)
+{
+    Results[Index] = Result;
+    ++NumFinished;
+    if (bSuccess)
+    {
+        ++NumSucceeded;
+    }
+
+    OnItemCompleted.Broadcast(Index, bSuccess, Result);
+    OnProgress.Broadcast(NumFinished, Items.Num());
+
+    if (NumFinished == Items.Num())
+    {
+        OnCompleted.Broadcast(NumSucceeded, NumFinished - NumSucceeded);
+        OnCompletedNative.ExecuteIfBound(NumSucceeded, NumFinished - NumSucceeded);
+        SetReadyToDestroy();
+        if (IsRooted())
+        {
+            RemoveFromRoot();
+        }
+    }
+}
+
+bool UDeepSeekBatch::WriteBatchFile(const TArray<FDeepSeekRequestParams>& InItems, const FString& FilePath)
+{
+    TArray<uint8> File;
+    TArray<uint8> Body;
+    for (int32 Index = 0; Index < InItems.Num(); ++Index)
+    {
+        FDeepSeekRequestParams Params = InItems[Index];
+        Params.bStream = false;
+        FDeepSeekRequestWriter::WriteRequestBody(Params, Body);
+
+        FDeepSeekRequestWriter::AppendLiteral(File, "{\"custom_id\":");
+        FDeepSeekRequestWriter::AppendString(File, FString::Printf(TEXT("%s%d"), DeepSeekBatch::CustomIdPrefix, Index));
+        FDeepSeekRequestWriter::AppendLiteral(File, ",\"method\":\"POST\",\"url\":");
+        FDeepSeekRequestWriter::AppendString(File, DeepSeekBatch::GetUrlPath(Params.URL));
+        FDeepSeekRequestWriter::AppendLiteral(File, ",\"body\":");
+        File.Append(Body);
+        FDeepSeekRequestWriter::AppendLiteral(File, "}\n");
+    }
+    return FFileHelper::SaveArrayToFile(File, *FilePath);
+}
+
+bool UDeepSeekBatch::ReadBatchResultFile(const FString& FilePath, int32 ItemCount, TArray<FString>& OutResults, TArray<bool>& OutSucceeded)
+{
+    OutResults.Reset();
+    OutResults.SetNum(FMath::Max(0, ItemCount));
+    OutSucceeded.Reset();
+    OutSucceeded.SetNumZeroed(FMath::Max(0, ItemCount));
+
+    FString FileContent;
+    if (!FFileHelper::LoadFileToString(FileContent, *FilePath))
+    {
+        return false;
+    }
+
+    TArray<FString> Lines;
+    FileContent.ParseIntoArrayLines(Lines);
+
+    for (const FString& Line : Lines)
+    {
+        TSharedPtr<FJsonObject> Entry;
+        TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Line);
+        if (!FJsonSerializer::Deserialize(Reader, Entry) || !Entry.IsValid())
+        {
+            continue;
+        }
+
+        FString CustomId;
+        int32 Index = INDEX_NONE;
+        if (!Entry->TryGetStringField(TEXT("custom_id"), CustomId)
+            || !CustomId.StartsWith(DeepSeekBatch::CustomIdPrefix)
+            || !LexTryParseString(Index, *CustomId.RightChop(FCString::Strlen(DeepSeekBatch::CustomIdPrefix)))
+            || !OutResults.IsValidIndex(Index))
+        {
+            continue;
+        }
+
+        // 成功的条目在response.body中，失败的条目在error中
+        const TSharedPtr<FJsonObject>* Response = nullptr;
+        const TSharedPtr<FJsonObject>* Body = nullptr;
+        if (Entry->TryGetObjectField(TEXT("response"), Response) && (*Response)->TryGetObjectField(TEXT("body"), Body))
+        {
+            OutSucceeded[Index] = DeepSeekBatch::ExtractContent(*Body, OutResults[Index]);
+        }
+
+        const TSharedPtr<FJsonObject>* Error = nullptr;
+        if (!OutSucceeded[Index] && Entry->TryGetObjectField(TEXT("error"), Error))
+        {
+            (*Error)->TryGetStringField(TEXT("message"), OutResults[Index]);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,676 @@
+﻿// DeepSeekBenchmark.cpp
+// 开发用的性能测试命令，发行版中不编译
+#include "CoreMinimal.h"
+
+#if !UE_BUILD_SHIPPING
+
+#include "AIFunction.h"
+#include "DeepSeekBatch.h"
+#include "DeepSeekMockServer.h"
+#include "DeepSeekRequestWriter.h"
+#include "DeepSeekSSEParser.h"
+#include "DeepSeekStreamDelta.h"
+#include "PaasAILog.h"
+#include "Dom/JsonObject.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/MemoryBase.h"
+#include "HAL/PlatformTLS.h"
+#include "Math/RandomStream.h"
+#include "Misc/Parse.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include <atomic>
+
+namespace DeepSeekBenchmark
+{
+    /**
+     * 统计当前线程分配次数和字节数的GMalloc代理，其他线程的分配直接转发
+     * 只在测试期间替换GMalloc，之后一直保留，避免其他线程正在调用时被销毁
+     */
+    class FCountingMalloc final : public FMalloc
+    {
+    public:
+        static FCountingMalloc& Get()
+        {
+            static FCountingMalloc Instance;
+            return Instance;
+        }
+
+        void Begin()
+        {
+            check(GMalloc != this);
+            Inner = GMalloc;
+            Allocations = 0;
+            Bytes = 0;
+            CountingThreadId = FPlatformTLS::GetCurrentThreadId();
+            GMalloc = this;
+        }
+
+        void End()
+        {
+            GMalloc = Inner;
+            CountingThreadId = 0;
+        }
+
+        int64 GetAllocations() const { return Allocations; }
+        int64 GetBytes() const { return Bytes; }
+
+        virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+        {
+            Record(Count);
+            return Inner->Malloc(Count, Alignment);
+        }
+
+        virtual void* TryMalloc(SIZE_T Count, uint32 Alignment) override
+        {
+            Record(Count);
+            return Inner->TryMalloc(Count, Alignment);
+        }
+
+        virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+        {
+            Record(Count);
+            return Inner->Realloc(Original, Count, Alignment);
+        }
+
+        virtual void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override
+        {
+            Record(Count);
+            return Inner->TryRealloc(Original, Count, Alignment);
+        }
+
+        virtual void Free(void* Original) override { Inner->Free(Original); }
+        virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+        virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+        virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+        virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+        virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+        virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+        virtual bool ValidateHeap() override { return Inner->ValidateHeap(); }
+        virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+    private:
+        void Record(SIZE_T Size)
+        {
+            if (Size > 0 && FPlatformTLS::GetCurrentThreadId() == CountingThreadId)
+            {
+                ++Allocations;
+                Bytes += Size;
+            }
+        }
+
+        FMalloc* Inner = nullptr;
+        std::atomic<uint32> CountingThreadId { 0 };
+        int64 Allocations = 0;
+        int64 Bytes = 0;
+    };
+
+    /** 原来的做法：事件转成FString后构建完整的JSON DOM，再逐层取出choices[0].delta.content */
+    static bool ParseEventWithDom(FUtf8StringView EventData, FString& OutContent)
+    {
+        const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(EventData.GetData()), EventData.Len());
+        const FString JsonData(Converted.Length(), Converted.Get());
+
+        TSharedPtr<FJsonObject> JsonObject;
+        TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonData);
+        if (!FJsonSerializer::Deserialize(Reader, JsonObject) || !JsonObject.IsValid())
+        {
+            return false;
+        }
+
+        const TArray<TSharedPtr<FJsonValue>>* Choices = nullptr;
+        const TSharedPtr<FJsonObject>* ChoiceObject = nullptr;
+        const TSharedPtr<FJsonObject>* DeltaObject = nullptr;
+        return JsonObject->TryGetArrayField(TEXT("choices"), Choices) && Choices->Num() > 0
+            && (*Choices)[0]->TryGetObject(ChoiceObject)
+            && (*ChoiceObject)->TryGetObjectField(TEXT("delta"), DeltaObject)
+            && (*DeltaObject)->TryGetStringField(TEXT("content"), OutContent);
+    }
+
+    /** 一种解析方式的测试结果 */
+    struct FParseResult
+    {
+        double Seconds = 0.0;
+        int64 Allocations = 0;
+        int64 AllocatedBytes = 0;
+        int32 Events = 0;
+        bool bMatched = true;
+    };
+
+    /** 把录制的流按ChunkBytes切块解析一遍，返回拼接出的文本 */
+    static void ParseOnce(const TArray<uint8>& Stream, int32 ChunkBytes, bool bUseDom, FRandomStream& Random,
+        FDeepSeekSSEParser& Parser, FDeepSeekStreamDelta& Delta, FString& Text, int32& Events)
+    {
+        Parser.Reset();
+        Text.Reset();
+
+        FString DomContent;
+        auto OnEvent = [bUseDom, &Delta, &DomContent, &Text, &Events](FUtf8StringView EventData)
+        {
+            if (EventData == UTF8TEXTVIEW("[DONE]"))
+            {
+                return true;
+            }
+            if (bUseDom)
+            {
+                if (ParseEventWithDom(EventData, DomContent))
+                {
+                    Text.Append(DomContent);
+                    ++Events;
+                }
+                return true;
+            }
+            Delta.Reset();
+            if (Delta.Parse(EventData))
+            {
+                Text.Append(Delta.Content);
+                ++Events;
+            }
+            return true;
+        };
+
+        int64 Offset = 0;
+        while (Offset < Stream.Num())
+        {
+            const int64 Length = FMath::Min<int64>(Stream.Num() - Offset, ChunkBytes > 0 ? ChunkBytes : Random.RandRange(1, 64));
+            Parser.Feed(Stream.GetData() + Offset, Length, OnEvent);
+            Offset += Length;
+        }
+        Parser.Finish(OnEvent);
+    }
+
+    static FParseResult MeasureParse(const TArray<uint8>& Stream, const FString& Expected, int32 ChunkBytes, int32 Iterations, bool bUseDom)
+    {
+        FDeepSeekSSEParser Parser;
+        FDeepSeekStreamDelta Delta;
+        FString Text;
+        FRandomStream Random(Stream.Num());
+        FParseResult Result;
+
+        // 预热一遍让解析器和文本缓冲达到稳定容量，再单独统计一遍的分配，计时的循环不经过分配代理
+        ParseOnce(Stream, ChunkBytes, bUseDom, Random, Parser, Delta, Text, Result.Events);
+        FCountingMalloc& Counter = FCountingMalloc::Get();
+        Counter.Begin();
+        ParseOnce(Stream, ChunkBytes, bUseDom, Random, Parser, Delta, Text, Result.Events);
+        Counter.End();
+        Result.Allocations = Counter.GetAllocations();
+        Result.AllocatedBytes = Counter.GetBytes();
+
+        Result.Events = 0;
+        const uint64 StartCycles = FPlatformTime::Cycles64();
+        for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+        {
+            ParseOnce(Stream, ChunkBytes, bUseDom, Random, Parser, Delta, Text, Result.Events);
+            Result.bMatched &= Text.Equals(Expected, ESearchCase::CaseSensitive);
+        }
+        Result.Seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+        return Result;
+    }
+
+    /**
+     * PaasAI.Bench.Parse [Tokens] [ChunkBytes] [Iterations] [scanner|dom|both]
+     * 把录制的流按固定大小(ChunkBytes<=0时随机1~64字节)切块，走HTTP线程上的SSE解析和delta提取路径。
+     * dom为原来每个事件FJsonSerializer::Deserialize的做法，用于对比扫描器的耗时和每个token的分配
+     */
+    static void RunParseBenchmark(const TArray<FString>& Args)
+    {
+        const int32 NumTokens = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 2000;
+        const int32 ChunkBytes = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 7;
+        const int32 Iterations = Args.Num() > 2 ? FMath::Max(1, FCString::Atoi(*Args[2])) : 50;
+        const FString Mode = Args.Num() > 3 ? Args[3] : TEXT("both");
+
+        TArray<uint8> Stream;
+        const FString Expected = FDeepSeekMockServer::BuildStream(NumTokens, Stream);
+
+        for (const bool bUseDom : { false, true })
+        {
+            if (!Mode.Equals(TEXT("both"), ESearchCase::IgnoreCase) && Mode.Equals(TEXT("dom"), ESearchCase::IgnoreCase) != bUseDom)
+            {
+                continue;
+            }
+
+            const FParseResult Result = MeasureParse(Stream, Expected, ChunkBytes, Iterations, bUseDom);
+            const double TotalTokens = static_cast<double>(NumTokens) * Iterations;
+            UE_LOG(LogPaasAI, Display, TEXT("Parse benchmark (%s): %d tokens x %d, chunk %s bytes, %.1f MB/s, %.0f tokens/s, %.3f us/token, %.2f allocs/token, %.1f bytes/token, %d events, text %s"),
+                bUseDom ? TEXT("dom") : TEXT("scanner"), NumTokens, Iterations, ChunkBytes > 0 ? *FString::FromInt(ChunkBytes) : TEXT("1-64"),
+                Stream.Num() * Iterations / Result.Seconds / (1024.0 * 1024.0), TotalTokens / Result.Seconds, Result.Seconds * 1.0e6 / TotalTokens,
+                static_cast<double>(Result.Allocations) / NumTokens, static_cast<double>(Result.AllocatedBytes) / NumTokens,
+                Result.Events, Result.bMatched ? TEXT("matched") : TEXT("MISMATCHED"));
+        }
+    }
+
+    /** 原来的做法：构建FJsonObject，序列化为FString，再由SetContentAsString转换为UTF-8 */
+    static void WriteLegacyBody(const FDeepSeekRequestParams& Params, TArray<uint8>& OutBody)
+    {
+        TSharedPtr<FJsonObject> JsonObject = MakeShareable(new FJsonObject);
+        JsonObject->SetStringField(TEXT("model"), Params.Model);
+
+        TArray<TSharedPtr<FJsonValue>> MessagesArray;
+        MessagesArray.Reserve(Params.Messages.Num());
+        for (const FDeepSeekMessage& Message : Params.Messages)
+        {
+            TSharedPtr<FJsonObject> MessageObject = MakeShareable(new FJsonObject);
+            MessageObject->SetStringField(TEXT("role"), Message.Role);
+            MessageObject->SetStringField(TEXT("content"), Message.Content);
+            MessagesArray.Add(MakeShareable(new FJsonValueObject(MessageObject)));
+        }
+
+        JsonObject->SetArrayField(TEXT("messages"), MessagesArray);
+        JsonObject->SetBoolField(TEXT("stream"), Params.bStream);
+        JsonObject->SetNumberField(TEXT("temperature"), FMath::Clamp(Params.Temperature, 0.0f, 1.0f));
+        JsonObject->SetNumberField(TEXT("max_tokens"), FMath::Max(1, Params.MaxTokens));
+
+        FString RequestBody;
+        TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&RequestBody);
+        FJsonSerializer::Serialize(JsonObject.ToSharedRef(), Writer);
+
+        const FTCHARToUTF8 Converted(*RequestBody, RequestBody.Len());
+        OutBody.Reset();
+        OutBody.Append(reinterpret_cast<const uint8*>(Converted.Get()), Converted.Length());
+    }
+
+    /**
+     * PaasAI.Bench.Write [Iterations] [MessageChars]
+     * 分别用10、100、1000条消息的对话比较FDeepSeekRequestWriter和原来的FJsonObject路径，
+     * 报告每个请求的耗时、分配次数和分配字节数。两者每次都写入新的数组，与发送请求时一致
+     */
+    static void RunWriteBenchmark(const TArray<FString>& Args)
+    {
+        const int32 Iterations = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 200;
+        const int32 MessageChars = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 200;
+
+        // 中英文混合并带有需要转义的引号和换行
+        const FString Sentence = TEXT("玩家问道：\"这座城堡里有什么？\"\nThe guard replies slowly. ");
+        FString Content;
+        while (Content.Len() < MessageChars)
+        {
+            Content.Append(Sentence);
+        }
+        Content.LeftInline(MessageChars);
+
+        for (const int32 NumMessages : { 10, 100, 1000 })
+        {
+            FDeepSeekRequestParams Params;
+            Params.Messages.Reserve(NumMessages);
+            Params.Messages.Add(FDeepSeekMessage(TEXT("system"), Content));
+            for (int32 Index = 1; Index < NumMessages; ++Index)
+            {
+                Params.Messages.Add(FDeepSeekMessage(Index % 2 == 1 ? TEXT("user") : TEXT("assistant"), Content));
+            }
+
+            for (const bool bLegacy : { false, true })
+            {
+                auto WriteBody = [&Params, bLegacy](TArray<uint8>& OutBody)
+                {
+                    if (bLegacy)
+                    {
+                        WriteLegacyBody(Params, OutBody);
+                    }
+                    else
+                    {
+                        FDeepSeekRequestWriter::WriteRequestBody(Params, OutBody);
+                    }
+                };
+
+                FCountingMalloc& Counter = FCountingMalloc::Get();
+                int64 BodyBytes = 0;
+                Counter.Begin();
+                {
+                    TArray<uint8> Body;
+                    WriteBody(Body);
+                    BodyBytes = Body.Num();
+                }
+                Counter.End();
+
+                const uint64 StartCycles = FPlatformTime::Cycles64();
+                for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+                {
+                    TArray<uint8> Body;
+                    WriteBody(Body);
+                }
+                const double Seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+
+                UE_LOG(LogPaasAI, Display, TEXT("Write benchmark (%s): %d messages x %d chars, body %lld bytes, %.1f us/request, %lld allocs/request, %lld bytes allocated/request"),
+                    bLegacy ? TEXT("json object") : TEXT("writer"), NumMessages, MessageChars, BodyBytes,
+                    Seconds * 1.0e6 / Iterations, Counter.GetAllocations(), Counter.GetBytes());
+            }
+        }
+    }
+
+    /** 把命令参数分为位置参数和Key=Value形式的选项 */
+    static void SplitArgs(const TArray<FString>& Args, TArray<FString>& OutPositional, FString& OutOptions)
+    {
+        for (const FString& Arg : Args)
+        {
+            if (Arg.Contains(TEXT("=")))
+            {
+                OutOptions += TEXT(" ") + Arg;
+            }
+            else
+            {
+                OutPositional.Add(Arg);
+            }
+        }
+    }
+
+    /** 按Tokens、TokenDelay、FirstDelay、Chunk选项启动进程内的模拟服务器，失败时返回空 */
+    static TUniquePtr<FDeepSeekMockServer> StartMockServer(const FString& Options)
+    {
+        FDeepSeekMockServerConfig MockConfig;
+        MockConfig.FirstTokenDelaySeconds = 0.2f;
+        MockConfig.TokenDelaySeconds = 0.02f;
+        FParse::Value(*Options, TEXT("Tokens="), MockConfig.NumTokens);
+        FParse::Value(*Options, TEXT("TokenDelay="), MockConfig.TokenDelaySeconds);
+        FParse::Value(*Options, TEXT("FirstDelay="), MockConfig.FirstTokenDelaySeconds);
+        FParse::Value(*Options, TEXT("Chunk="), MockConfig.ChunkBytes);
+
+        TUniquePtr<FDeepSeekMockServer> MockServer = MakeUnique<FDeepSeekMockServer>();
+        if (!MockServer->Start())
+        {
+            UE_LOG(LogPaasAI, Warning, TEXT("Benchmark: failed to start the mock server"));
+            return nullptr;
+        }
+        MockServer->SetConfig(MockConfig);
+        return MockServer;
+    }
+
+    /** 负载测试的进度，由游戏线程上的完成回调更新 */
+    struct FLoadRun : public TSharedFromThis<FLoadRun>
+    {
+        FDeepSeekRequestParams Params;
+        TArray<int32> ConcurrencyLevels;
+        int32 LevelIndex = 0;
+        int32 Concurrency = 1;
+        int32 TotalRequests = 0;
+        int32 Launched = 0;
+        int32 Finished = 0;
+        int32 Failed = 0;
+        int64 Tokens = 0;
+        double ParseSeconds = 0.0;
+        double GameThreadSeconds = 0.0;
+        double StartTime = 0.0;
+        TArray<float> QueueWaits;
+        TArray<float> FirstTokenTimes;
+
+        // URL为mock时由测试自己启动，所有并发档位跑完后关闭
+        TUniquePtr<FDeepSeekMockServer> MockServer;
+
+        /** 开始下一个并发档位 */
+        void StartLevel()
+        {
+            Concurrency = ConcurrencyLevels[LevelIndex];
+            Launched = 0;
+            Finished = 0;
+            Failed = 0;
+            Tokens = 0;
+            ParseSeconds = 0.0;
+            GameThreadSeconds = 0.0;
+            QueueWaits.Reset(TotalRequests);
+            FirstTokenTimes.Reset(TotalRequests);
+            StartTime = FPlatformTime::Seconds();
+            LaunchNext();
+        }
+
+        void LaunchNext()
+        {
+            while (Launched < TotalRequests && Launched - Finished < Concurrency)
+            {
+                ++Launched;
+                UDeepSeekFunction* Function = UDeepSeekFunction::SendPooledRequest(Params);
+                TWeakObjectPtr<UDeepSeekFunction> WeakFunction(Function);
+                Function->OnFinishedNative.BindLambda([Run = AsShared(), WeakFunction](bool bSuccess, const FString& Result, int32 ResponseCode)
+                {
+                    Run->OnFinished(WeakFunction.Get(), bSuccess);
+                });
+            }
+        }
+
+        void OnFinished(const UDeepSeekFunction* Function, bool bSuccess)
+        {
+            ++Finished;
+            if (!bSuccess)
+            {
+                ++Failed;
+            }
+            if (Function != nullptr)
+            {
+                const FDeepSeekRequestMetrics Metrics = Function->GetMetrics();
+                Tokens += Metrics.CompletionTokens;
+                ParseSeconds += Metrics.ParseSeconds;
+                GameThreadSeconds += Metrics.GameThreadSeconds;
+                QueueWaits.Add(Metrics.QueueWaitSeconds);
+                if (bSuccess && Metrics.TimeToFirstTokenSeconds > 0.0f)
+                {
+                    FirstTokenTimes.Add(Metrics.TimeToFirstTokenSeconds);
+                }
+            }
+
+            if (Finished == TotalRequests)
+            {
+                Report();
+                if (++LevelIndex < ConcurrencyLevels.Num())
+                {
+                    StartLevel();
+                }
+                else
+                {
+                    MockServer.Reset();
+                }
+                return;
+            }
+            LaunchNext();
+        }
+
+        static float Percentile(const TArray<float>& Sorted, float Fraction)
+        {
+            return Sorted.Num() > 0 ? Sorted[FMath::Clamp(FMath::RoundToInt(Fraction * (Sorted.Num() - 1)), 0, Sorted.Num() - 1)] : 0.0f;
+        }
+
+        void Report()
+        {
+            const double Seconds = FMath::Max(FPlatformTime::Seconds() - StartTime, UE_DOUBLE_SMALL_NUMBER);
+            QueueWaits.Sort();
+            FirstTokenTimes.Sort();
+            UE_LOG(LogPaasAI, Display, TEXT("Load benchmark: %d requests (%d failed) at concurrency %d in %.2fs, %.1f requests/s, %.0f tokens/s, parse %.4f ms/token, game thread %.4f ms/token"),
+                TotalRequests, Failed, Concurrency, Seconds, TotalRequests / Seconds, Tokens / Seconds,
+                Tokens > 0 ? ParseSeconds * 1000.0 / Tokens : 0.0, Tokens > 0 ? GameThreadSeconds * 1000.0 / Tokens : 0.0);
+            UE_LOG(LogPaasAI, Display, TEXT("  TTFT p50 %.1f ms, p90 %.1f ms, p99 %.1f ms; queue wait p50 %.1f ms, p99 %.1f ms"),
+                Percentile(FirstTokenTimes, 0.5f) * 1000.0f, Percentile(FirstTokenTimes, 0.9f) * 1000.0f, Percentile(FirstTokenTimes, 0.99f) * 1000.0f,
+                Percentile(QueueWaits, 0.5f) * 1000.0f, Percentile(QueueWaits, 0.99f) * 1000.0f);
+        }
+    };
+
+    /**
+     * PaasAI.Bench.Load URL|mock [Concurrency] [Requests] [APIKey] [Tokens=64] [TokenDelay=0.02] [FirstDelay=0.2] [Chunk=0]
+     * 向指定端点保持固定并发，走完整的调度、HTTP和投递路径。Concurrency可以是逗号分隔的列表，依次测试各档位。
+     * URL为mock时启动进程内的模拟服务器，后面的键值参数配置它的回答长度、token间隔和切块大小。
+     * 并发超过MaxInFlightPerEndpoint的部分在调度器中排队，体现为排队时间
+     */
+    static void RunLoadBenchmark(const TArray<FString>& Args)
+    {
+        TArray<FString> Positional;
+        FString Options;
+        SplitArgs(Args, Positional, Options);
+
+        if (Positional.Num() < 1)
+        {
+            UE_LOG(LogPaasAI, Warning, TEXT("Usage: PaasAI.Bench.Load URL|mock [Concurrency=10|1,10,100] [Requests=100] [APIKey] [Tokens=64] [TokenDelay=0.02] [FirstDelay=0.2] [Chunk=0]"));
+            return;
+        }
+
+        TSharedRef<FLoadRun> Run = MakeShared<FLoadRun>();
+        if (Positional[0].Equals(TEXT("mock"), ESearchCase::IgnoreCase))
+        {
+            Run->MockServer = StartMockServer(Options);
+            if (!Run->MockServer.IsValid())
+            {
+                return;
+            }
+            Run->Params.URL = Run->MockServer->GetURL();
+        }
+        else
+        {
+            Run->Params.URL = Positional[0];
+        }
+        Run->Params.APIKey = Positional.Num() > 3 ? Positional[3] : TEXT("bench");
+        Run->Params.bUseEndpointPool = false;
+        Run->Params.Messages.Add(FDeepSeekMessage(TEXT("user"), TEXT("Benchmark")));
+        Run->TotalRequests = Positional.Num() > 2 ? FMath::Max(1, FCString::Atoi(*Positional[2])) : 100;
+
+        TArray<FString> Levels;
+        (Positional.Num() > 1 ? Positional[1] : FString(TEXT("10"))).ParseIntoArray(Levels, TEXT(","));
+        for (const FString& Level : Levels)
+        {
+            Run->ConcurrencyLevels.Add(FMath::Max(1, FCString::Atoi(*Level)));
+        }
+        if (Run->ConcurrencyLevels.Num() == 0)
+        {
+            Run->ConcurrencyLevels.Add(10);
+        }
+        Run->StartLevel();
+    }
+
+    /** 批量与逐个节点的对比测试，先逐个节点发出全部提示词，结束后再用一个批量节点发出同样的提示词 */
+    struct FBatchRun : public TSharedFromThis<FBatchRun>
+    {
+        TArray<FDeepSeekRequestParams> Items;
+        int32 Concurrency = 8;
+        int32 Finished = 0;
+        int32 Failed = 0;
+        double StartTime = 0.0;
+        uint64 StartGameThreadCycles = 0;
+        double LaunchSeconds = 0.0;
+        int64 LaunchAllocations = 0;
+        TUniquePtr<FDeepSeekMockServer> MockServer;
+
+        void Begin()
+        {
+            Finished = 0;
+            Failed = 0;
+            StartTime = FPlatformTime::Seconds();
+            StartGameThreadCycles = FDeepSeekMetricsRecorder::GetTotalGameThreadCycles();
+        }
+
+        /** 与蓝图循环中逐个调用QuickSendRequest相同：每个提示词一个节点，全部立即发出，由调度器排队 */
+        void RunPerNode()
+        {
+            Begin();
+            FCountingMalloc& Counter = FCountingMalloc::Get();
+            Counter.Begin();
+            const uint64 LaunchStart = FPlatformTime::Cycles64();
+            for (const FDeepSeekRequestParams& Params : Items)
+            {
+                UDeepSeekFunction* Function = UDeepSeekFunction::SendRequest(Params);
+                Function->OnFinishedNative.BindLambda([Run = AsShared()](bool bSuccess, const FString& Result, int32 ResponseCode)
+                {
+                    Run->Failed += bSuccess ? 0 : 1;
+                    if (++Run->Finished == Run->Items.Num())
+                    {
+                        Run->Report(TEXT("per node"));
+                        Run->RunBatch();
+                    }
+                });
+            }
+            LaunchSeconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - LaunchStart);
+            Counter.End();
+            LaunchAllocations = Counter.GetAllocations();
+        }
+
+        void RunBatch()
+        {
+            Begin();
+            FCountingMalloc& Counter = FCountingMalloc::Get();
+            Counter.Begin();
+            const uint64 LaunchStart = FPlatformTime::Cycles64();
+            UDeepSeekBatch* Batch = UDeepSeekBatch::SendBatchRequest(Items, Concurrency, 0);
+            Batch->OnCompletedNative.BindLambda([Run = AsShared()](int32 Succeeded, int32 BatchFailed)
+            {
+                Run->Finished = Succeeded + BatchFailed;
+                Run->Failed = BatchFailed;
+                Run->Report(TEXT("batch"));
+                Run->MockServer.Reset();
+            });
+            Batch->Activate();
+            LaunchSeconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - LaunchStart);
+            Counter.End();
+            LaunchAllocations = Counter.GetAllocations();
+        }
+
+        void Report(const TCHAR* Mode) const
+        {
+            const double Seconds = FMath::Max(FPlatformTime::Seconds() - StartTime, UE_DOUBLE_SMALL_NUMBER);
+            const double GameThreadSeconds = FPlatformTime::ToSeconds64(FDeepSeekMetricsRecorder::GetTotalGameThreadCycles() - StartGameThreadCycles);
+            UE_LOG(LogPaasAI, Display, TEXT("Batch benchmark (%s): %d items (%d failed) in %.2fs, %.1f items/s, launch %.2f ms with %lld allocs, game thread %.3f ms/item"),
+                Mode, Items.Num(), Failed, Seconds, Items.Num() / Seconds, LaunchSeconds * 1000.0, LaunchAllocations,
+                (LaunchSeconds + GameThreadSeconds) * 1000.0 / FMath::Max(1, Items.Num()));
+        }
+    };
+
+    /**
+     * PaasAI.Bench.Batch URL|mock [Items] [Concurrency] [APIKey] [Tokens=] [FirstDelay=]
+     * 比较每个提示词一个异步节点和UDeepSeekBatch两种做法发出同一组非流式提示词的总耗时、
+     * 发出时游戏线程的耗时和分配，以及每个条目在游戏线程上的总开销
+     */
+    static void RunBatchBenchmark(const TArray<FString>& Args)
+    {
+        TArray<FString> Positional;
+        FString Options;
+        SplitArgs(Args, Positional, Options);
+
+        if (Positional.Num() < 1)
+        {
+            UE_LOG(LogPaasAI, Warning, TEXT("Usage: PaasAI.Bench.Batch URL|mock [Items=500] [Concurrency=8] [APIKey] [Tokens=64] [FirstDelay=0.2]"));
+            return;
+        }
+
+        TSharedRef<FBatchRun> Run = MakeShared<FBatchRun>();
+        FString URL = Positional[0];
+        if (URL.Equals(TEXT("mock"), ESearchCase::IgnoreCase))
+        {
+            Run->MockServer = StartMockServer(Options);
+            if (!Run->MockServer.IsValid())
+            {
+                return;
+            }
+            URL = Run->MockServer->GetURL();
+        }
+
+        const int32 NumItems = Positional.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Positional[1])) : 500;
+        Run->Concurrency = Positional.Num() > 2 ? FMath::Max(1, FCString::Atoi(*Positional[2])) : 8;
+        Run->Items.SetNum(NumItems);
+        for (int32 Index = 0; Index < NumItems; ++Index)
+        {
+            FDeepSeekRequestParams& Params = Run->Items[Index];
+            Params.URL = URL;
+            Params.APIKey = Positional.Num() > 3 ? Positional[3] : TEXT("bench");
+            Params.bUseEndpointPool = false;
+            Params.bStream = false;
+            Params.Priority = EDeepSeekRequestPriority::Background;
+            Params.Messages.Add(FDeepSeekMessage(TEXT("user"), FString::Printf(TEXT("Describe item %d"), Index)));
+        }
+        Run->RunPerNode();
+    }
+
+    static FAutoConsoleCommand ParseCommand(
+        TEXT("PaasAI.Bench.Parse"),
+        TEXT("离线测试SSE解析吞吐和分配：PaasAI.Bench.Parse [Tokens] [ChunkBytes] [Iterations] [scanner|dom|both]"),
+        FConsoleCommandWithArgsDelegate::CreateStatic(&RunParseBenchmark));
+
+    static FAutoConsoleCommand WriteCommand(
+        TEXT("PaasAI.Bench.Write"),
+        TEXT("比较请求体写入器和FJsonObject路径的耗时和分配：PaasAI.Bench.Write [Iterations] [MessageChars]"),
+        FConsoleCommandWithArgsDelegate::CreateStatic(&RunWriteBenchmark));
+
+    static FAutoConsoleCommand LoadCommand(
+        TEXT("PaasAI.Bench.Load"),
+        TEXT("对端点或进程内模拟服务器做并发测试：PaasAI.Bench.Load URL|mock [Concurrency|1,10,100] [Requests] [APIKey] [Tokens=] [TokenDelay=] [FirstDelay=] [Chunk=]"),
+        FConsoleCommandWithArgsDelegate::CreateStatic(&RunLoadBenchmark));
+
+    static FAutoConsoleCommand BatchCommand(
+        TEXT("PaasAI.Bench.Batch"),
+        TEXT("比较逐个节点和批量节点发出同一组提示词：PaasAI.Bench.Batch URL|mock [Items] [Concurrency] [APIKey] [Tokens=] [FirstDelay=]"),
+        FConsoleCommandWithArgsDelegate::CreateStatic(&RunBatchBenchmark));
+}
+
+#endif
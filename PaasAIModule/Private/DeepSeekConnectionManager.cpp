@@ -0,0 +1,276 @@
+﻿// DeepSeekConnectionManager.cpp
+#include "DeepSeekConnectionManager.h"
+#include "PaasAIModule.h"
+#include "PaasAIStats.h"
+#include "PaasAILog.h"
+#include "HttpModule.h"
+#include "Interfaces/IHttpResponse.h"
+
+namespace DeepSeekConnections
+{
+    // 检查保活和连接超时的间隔
+    static constexpr float TickInterval = 1.0f;
+
+    // 探测请求的超时，握手卡住时不长期占用连接
+    static constexpr float ProbeTimeoutSeconds = 10.0f;
+}
+
+FDeepSeekConnectionManager::FDeepSeekConnectionManager()
+{
+    TickerHandle = FTSTicker::GetCoreTicker().AddTicker(
+        FTickerDelegate::CreateRaw(this, &FDeepSeekConnectionManager::Tick), DeepSeekConnections::TickInterval);
+}
+
+FDeepSeekConnectionManager::~FDeepSeekConnectionManager()
+{
+    FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+
+    // 进行中的探测不再回调到已销毁的对象
+    for (const FHttpRequestPtr& Probe : Probes)
+    {
+        Probe->OnProcessRequestComplete().Unbind();
+        Probe->CancelRequest();
+    }
+}
+
+void FDeepSeekConnectionManager::Configure(int32 InConnectionsPerOrigin, float InKeepAliveSeconds, float InIdleTimeoutSeconds, float InMaxIdleSeconds)
+{
+    FScopeLock ScopeLock(&Lock);
+    ConnectionsPerOrigin = FMath::Max(0, InConnectionsPerOrigin);
+    KeepAliveSeconds = FMath::Max(0.0f, InKeepAliveSeconds);
+    IdleTimeoutSeconds = FMath::Max(1.0f, InIdleTimeoutSeconds);
+    MaxIdleSeconds = FMath::Max(0.0f, InMaxIdleSeconds);
+}
+
+FString FDeepSeekConnectionManager::GetOrigin(const FString& URL)
+{
+    const int32 SchemeEnd = URL.Find(TEXT("://"));
+    const int32 HostStart = SchemeEnd == INDEX_NONE ? 0 : SchemeEnd + 3;
+    int32 PathStart = URL.Find(TEXT("/"), ESearchCase::CaseSensitive, ESearchDir::FromStart, HostStart);
+    if (PathStart == INDEX_NONE)
+    {
+        PathStart = URL.Len();
+    }
+    return URL.Left(PathStart).ToLower();
+}
+
+FDeepSeekConnectionManager::FOrigin& FDeepSeekConnectionManager::FindOrAddOrigin(const FString& URL, const FString& Origin)
+{
+    FOrigin& Entry = Origins.FindOrAdd(Origin);
+    if (Entry.URL.IsEmpty())
+    {
+        Entry.URL = URL;
+        Entry.Stats.Origin = Origin;
+    }
+    return Entry;
+}
+
+void FDeepSeekConnectionManager::AddOrigin(const FString& URL)
+{
+    const FString Origin = GetOrigin(URL);
+    if (Origin.IsEmpty())
+    {
+        return;
+    }
+
+    FScopeLock ScopeLock(&Lock);
+    FindOrAddOrigin(URL, Origin);
+}
+
+void FDeepSeekConnectionManager::ExpireIdle(FOrigin& Entry, double Now) const
+{
+    if (Entry.Idle > 0 && Now - Entry.LastIdleTime >= IdleTimeoutSeconds)
+    {
+        Entry.Idle = 0;
+    }
+}
+
+void FDeepSeekConnectionManager::Prewarm(const FString& URL)
+{
+    FScopeLock ScopeLock(&Lock);
+
+    const double Now = FPlatformTime::Seconds();
+    const FString TargetOrigin = URL.IsEmpty() ? FString() : GetOrigin(URL);
+    if (!URL.IsEmpty())
+    {
+        FindOrAddOrigin(URL, TargetOrigin);
+    }
+
+    for (TPair<FString, FOrigin>& Pair : Origins)
+    {
+        if (!TargetOrigin.IsEmpty() && Pair.Key != TargetOrigin)
+        {
+            continue;
+        }
+
+        // 预热算作一次使用，之后的保活从现在开始计时
+        FOrigin& Entry = Pair.Value;
+        ExpireIdle(Entry, Now);
+        Entry.LastRequestTime = Now;
+        for (int32 Missing = ConnectionsPerOrigin - Entry.Idle - Entry.Probing; Missing > 0; --Missing)
+        {
+            SendProbe(Pair.Key, Entry, false);
+        }
+    }
+}
+
+void FDeepSeekConnectionManager::SendProbe(const FString& Origin, FOrigin& Entry, bool bKeepAlive)
+{
+    // HEAD请求不带密钥也不产生token，服务器返回什么状态码都说明连接已经建立
+    TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = FHttpModule::Get().CreateRequest();
+    Request->SetURL(Entry.URL);
+    Request->SetVerb(TEXT("HEAD"));
+    Request->SetTimeout(DeepSeekConnections::ProbeTimeoutSeconds);
+    Request->OnProcessRequestComplete().BindRaw(this, &FDeepSeekConnectionManager::HandleProbeFinished,
+        Origin, bKeepAlive, FPlatformTime::Seconds());
+
+    ++Entry.Probing;
+    if (bKeepAlive)
+    {
+        // 保活请求占用一个空闲连接，结束后归还
+        --Entry.Idle;
+        ++Entry.Stats.KeepAlivePings;
+        INC_DWORD_STAT(STAT_PaasAI_KeepAlivePings);
+    }
+    else
+    {
+        ++Entry.Stats.Prewarms;
+        INC_DWORD_STAT(STAT_PaasAI_ConnectionPrewarms);
+    }
+
+    Probes.Add(Request);
+    Request->ProcessRequest();
+}
+
+void FDeepSeekConnectionManager::HandleProbeFinished(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful, FString Origin, bool bKeepAlive, double SentTime)
+{
+    FScopeLock ScopeLock(&Lock);
+
+    Probes.RemoveSingleSwap(Request);
+    FOrigin* Entry = Origins.Find(Origin);
+    if (Entry == nullptr)
+    {
+        return;
+    }
+
+    const double Now = FPlatformTime::Seconds();
+    Entry->Probing = FMath::Max(0, Entry->Probing - 1);
+    if (!bWasSuccessful || !Response.IsValid())
+    {
+        UE_LOG(LogPaasAI, Verbose, TEXT("[Connections] %s to %s failed"), bKeepAlive ? TEXT("Keep-alive ping") : TEXT("Prewarm"), *Origin);
+        return;
+    }
+
+    ExpireIdle(*Entry, Now);
+    ++Entry->Idle;
+    Entry->LastIdleTime = Now;
+    if (!bKeepAlive)
+    {
+        Entry->Stats.LastPrewarmMs = static_cast<float>((Now - SentTime) * 1000.0);
+        UE_LOG(LogPaasAI, Verbose, TEXT("[Connections] Prewarmed %s in %.0fms"), *Origin, Entry->Stats.LastPrewarmMs);
+    }
+}
+
+bool FDeepSeekConnectionManager::NoteRequestStarted(const FString& URL)
+{
+    const FString Origin = GetOrigin(URL);
+    if (Origin.IsEmpty())
+    {
+        return false;
+    }
+
+    FScopeLock ScopeLock(&Lock);
+
+    const double Now = FPlatformTime::Seconds();
+    FOrigin& Entry = FindOrAddOrigin(URL, Origin);
+    ExpireIdle(Entry, Now);
+    Entry.LastRequestTime = Now;
+
+    const bool bReused = Entry.Idle > 0;
+    if (bReused)
+    {
+        --Entry.Idle;
+        ++Entry.Stats.ReusedRequests;
+        INC_DWORD_STAT(STAT_PaasAI_ConnectionsReused);
+    }
+    else
+    {
+        ++Entry.Stats.NewConnectionRequests;
+        INC_DWORD_STAT(STAT_PaasAI_ConnectionsOpened);
+    }
+    return bReused;
+}
+
+void FDeepSeekConnectionManager::NoteRequestFinished(const FString& URL, bool bConnectionKept)
+{
+    if (!bConnectionKept)
+    {
+        return;
+    }
+
+    FScopeLock ScopeLock(&Lock);
+
+    FOrigin* Entry = Origins.Find(GetOrigin(URL));
+    if (Entry != nullptr)
+    {
+        const double Now = FPlatformTime::Seconds();
+        ExpireIdle(*Entry, Now);
+        ++Entry->Idle;
+        Entry->LastIdleTime = Now;
+    }
+}
+
+bool FDeepSeekConnectionManager::Tick(float DeltaTime)
+{
+    FScopeLock ScopeLock(&Lock);
+
+    const double Now = FPlatformTime::Seconds();
+    for (TPair<FString, FOrigin>& Pair : Origins)
+    {
+        FOrigin& Entry = Pair.Value;
+        ExpireIdle(Entry, Now);
+
+        // 长时间没有真实请求时让连接自然关闭，下次使用前可以再预热
+        const bool bKeepAlive = KeepAliveSeconds > 0.0
+            && Entry.Idle > 0
+            && Now - Entry.LastIdleTime >= KeepAliveSeconds
+            && (MaxIdleSeconds <= 0.0 || Now - Entry.LastRequestTime < MaxIdleSeconds);
+        if (bKeepAlive)
+        {
+            for (int32 Pings = Entry.Idle; Pings > 0; --Pings)
+            {
+                SendProbe(Pair.Key, Entry, true);
+            }
+        }
+    }
+    return true;
+}
+
+TArray<FDeepSeekConnectionStats> FDeepSeekConnectionManager::GetStats() const
+{
+    FScopeLock ScopeLock(&Lock);
+
+    const double Now = FPlatformTime::Seconds();
+    TArray<FDeepSeekConnectionStats> Stats;
+    Stats.Reserve(Origins.Num());
+    for (const TPair<FString, FOrigin>& Pair : Origins)
+    {
+        FDeepSeekConnectionStats& Entry = Stats.Add_GetRef(Pair.Value.Stats);
+        Entry.IdleConnections = Now - Pair.Value.LastIdleTime < IdleTimeoutSeconds ? Pair.Value.Idle : 0;
+    }
+    return Stats;
+}
+
+void UDeepSeekConnectionLibrary::PrewarmConnections(const FString& URL)
+{
+    if (FPaasAIModuleModule* Module = FPaasAIModuleModule::Get())
+    {
+        Module->GetConnectionManager().Prewarm(URL);
+    }
+}
+
+TArray<FDeepSeekConnectionStats> UDeepSeekConnectionLibrary::GetConnectionStats()
+{
+    FPaasAIModuleModule* Module = FPaasAIModuleModule::Get();
+    return Module != nullptr ? Module->GetConnectionManager().GetStats() : TArray<FDeepSeekConnectionStats>();
+}
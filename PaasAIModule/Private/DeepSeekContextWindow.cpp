@@ -0,0 +1,197 @@
+﻿// DeepSeekContextWindow.cpp
+#include "DeepSeekContextWindow.h"
+#include "AIFunction.h"
+#include "DeepSeekRequestWriter.h"
+
+namespace DeepSeekContext
+{
+    // 每条消息的角色和分隔符大约占用的token数
+    static constexpr int32 MessageOverheadTokens = 4;
+
+    static const TCHAR* SummaryPrefix = TEXT("Summary of the earlier conversation:\n");
+
+    // 前缀稳定模式下超出预算时淘汰到预算的这个比例，之后若干轮都不需要再改写前缀
+    static constexpr float PrefixStableLowWater = 0.6f;
+}
+
+FDeepSeekContextWindow::FDeepSeekContextWindow()
+    : Encoded(MakeShared<TArray<uint8>>())
+{
+}
+
+int32 FDeepSeekContextWindow::EstimateTokens(FStringView Text)
+{
+    // DeepSeek给出的经验比例：1个英文字符约0.3个token，1个中文字符约0.6个token
+    int32 AsciiChars = 0;
+    int32 OtherChars = 0;
+    for (const TCHAR Char : Text)
+    {
+        if (Char < 0x80)
+        {
+            ++AsciiChars;
+        }
+        else
+        {
+            ++OtherChars;
+        }
+    }
+    return (AsciiChars * 3 + OtherChars * 6 + 9) / 10;
+}
+
+int32 FDeepSeekContextWindow::EstimateMessageTokens(const FDeepSeekMessage& Message)
+{
+    int32 Tokens = EstimateTokens(Message.Content) + DeepSeekContext::MessageOverheadTokens;
+    for (const FDeepSeekToolCall& ToolCall : Message.ToolCalls)
+    {
+        Tokens += EstimateTokens(ToolCall.Name) + EstimateTokens(ToolCall.Arguments) + DeepSeekContext::MessageOverheadTokens;
+    }
+    return Tokens;
+}
+
+void FDeepSeekContextWindow::Reset()
+{
+    MessageTokens.Reset();
+    Encoded = MakeShared<TArray<uint8>>();
+    PinnedCount = 0;
+    PinnedTokens = 0;
+    WindowStart = 0;
+    WindowTokens = 0;
+    Summary.Reset();
+    SummaryTokens = 0;
+    SummarizedEnd = 0;
+    PendingSummary.Reset();
+    PendingSummarizedEnd = 0;
+}
+
+void FDeepSeekContextWindow::Append(const FDeepSeekMessage& Message)
+{
+    const int32 Tokens = EstimateMessageTokens(Message);
+    MessageTokens.Add(Tokens);
+
+    // 对话开头的系统提示固定保留，不参与淘汰
+    if (MessageTokens.Num() == 1 && Message.Role == TEXT("system"))
+    {
+        PinnedCount = 1;
+        PinnedTokens = Tokens;
+        WindowStart = 1;
+        SummarizedEnd = 1;
+    }
+    else
+    {
+        WindowTokens += Tokens;
+    }
+
+    // 新消息只在加入历史时编码一次，之后每轮发送直接复用
+    AppendEncoded(Message);
+}
+
+bool FDeepSeekContextWindow::Trim(const TArray<FDeepSeekMessage>& History)
+{
+    check(History.Num() == MessageTokens.Num());
+
+    if (TokenBudget <= 0 || GetContextTokens() <= TokenBudget)
+    {
+        return false;
+    }
+
+    // 最新的一轮从最后一条用户消息开始，不能淘汰
+    int32 LastTurnStart = History.Num() - 1;
+    while (LastTurnStart > WindowStart && History[LastTurnStart].Role != TEXT("user"))
+    {
+        --LastTurnStart;
+    }
+
+    // 反正要改写前缀，顺便加入推迟的摘要
+    if (!PendingSummary.IsEmpty())
+    {
+        ApplySummary(MoveTemp(PendingSummary), PendingSummarizedEnd);
+        PendingSummary.Reset();
+    }
+
+    const int32 TargetTokens = bPrefixStable
+        ? FMath::Max(1, FMath::FloorToInt(TokenBudget * DeepSeekContext::PrefixStableLowWater))
+        : TokenBudget;
+
+    const int32 OldWindowStart = WindowStart;
+    while (GetContextTokens() > TargetTokens && WindowStart < LastTurnStart)
+    {
+        // 以完整轮次为单位淘汰，保证窗口总是从用户消息开始
+        do
+        {
+            WindowTokens -= MessageTokens[WindowStart];
+            ++WindowStart;
+        }
+        while (WindowStart < LastTurnStart && History[WindowStart].Role != TEXT("user"));
+    }
+
+    if (WindowStart == OldWindowStart)
+    {
+        return false;
+    }
+
+    Rebuild(History);
+    return true;
+}
+
+void FDeepSeekContextWindow::SetSummary(FString&& InSummary, int32 InSummarizedEnd, const TArray<FDeepSeekMessage>& History)
+{
+    // 立即加入摘要会改写已发送的前缀，留到下一次淘汰
+    if (bPrefixStable)
+    {
+        PendingSummary = MoveTemp(InSummary);
+        PendingSummarizedEnd = InSummarizedEnd;
+        return;
+    }
+
+    ApplySummary(MoveTemp(InSummary), InSummarizedEnd);
+
+    // 摘要占用了预算，必要时继续淘汰；没有淘汰时也需要重新编码以加入摘要
+    if (!Trim(History))
+    {
+        Rebuild(History);
+    }
+}
+
+void FDeepSeekContextWindow::ApplySummary(FString&& InSummary, int32 InSummarizedEnd)
+{
+    Summary = MoveTemp(InSummary);
+    SummarizedEnd = FMath::Clamp(InSummarizedEnd, PinnedCount, WindowStart);
+    SummaryTokens = Summary.IsEmpty() ? 0
+        : EstimateTokens(DeepSeekContext::SummaryPrefix) + EstimateTokens(Summary) + DeepSeekContext::MessageOverheadTokens;
+}
+
+void FDeepSeekContextWindow::Rebuild(const TArray<FDeepSeekMessage>& History)
+{
+    if (Encoded->Num() > 0)
+    {
+        ++PrefixInvalidations;
+    }
+
+    // 请求只在发送时读取一次编码，可以原地重写并保留容量
+    Encoded->Reset();
+
+    for (int32 Index = 0; Index < PinnedCount; ++Index)
+    {
+        AppendEncoded(History[Index]);
+    }
+
+    if (!Summary.IsEmpty())
+    {
+        FDeepSeekMessage SummaryMessage(TEXT("system"), FString(DeepSeekContext::SummaryPrefix) + Summary);
+        AppendEncoded(SummaryMessage);
+    }
+
+    for (int32 Index = WindowStart; Index < History.Num(); ++Index)
+    {
+        AppendEncoded(History[Index]);
+    }
+}
+
+void FDeepSeekContextWindow::AppendEncoded(const FDeepSeekMessage& Message)
+{
+    if (Encoded->Num() > 0)
+    {
+        FDeepSeekRequestWriter::AppendLiteral(*Encoded, ",");
+    }
+    FDeepSeekRequestWriter::AppendMessage(*Encoded, Message);
+}
@@ -0,0 +1,344 @@
+﻿// DeepSeekEndpointPool.cpp
+#include "DeepSeekEndpointPool.h"
+#include "PaasAIModule.h"
+#include "PaasAILog.h"
+
+namespace DeepSeekEndpoints
+{
+    // 延迟和错误率的平滑系数，越大越偏向最近的样本
+    static constexpr double LatencyAlpha = 0.2;
+    static constexpr double ErrorAlpha = 0.1;
+
+    // 还没有延迟样本的端点按这个值计算，让新端点尽快得到样本
+    static constexpr double MinLatencySeconds = 0.05;
+
+    // 探测失败时冷却时间加倍的上限
+    static constexpr int32 MaxCooldownShift = 3;
+
+    // 所有端点都在等待探测结果时，隔多久再尝试选择
+    static constexpr double ProbeWaitSeconds = 1.0;
+}
+
+void FDeepSeekEndpointPool::AddEndpoint(const FDeepSeekEndpointConfig& Config)
+{
+    FScopeLock ScopeLock(&Lock);
+
+    FEndpoint* Existing = Endpoints.FindByPredicate([&Config](const FEndpoint& Endpoint) { return Endpoint.Config.Name == Config.Name; });
+    if (Existing != nullptr)
+    {
+        // 替换配置后按新端点重新统计，执行中的请求仍按旧Id结束
+        *Existing = FEndpoint();
+        Existing->Id = NextId++;
+        Existing->Config = Config;
+        return;
+    }
+
+    FEndpoint& Endpoint = Endpoints.AddDefaulted_GetRef();
+    Endpoint.Id = NextId++;
+    Endpoint.Config = Config;
+}
+
+bool FDeepSeekEndpointPool::RemoveEndpoint(const FString& Name)
+{
+    FScopeLock ScopeLock(&Lock);
+    return Endpoints.RemoveAll([&Name](const FEndpoint& Endpoint) { return Endpoint.Config.Name == Name; }) > 0;
+}
+
+void FDeepSeekEndpointPool::Empty()
+{
+    FScopeLock ScopeLock(&Lock);
+    Endpoints.Empty();
+}
+
+bool FDeepSeekEndpointPool::IsEmpty() const
+{
+    FScopeLock ScopeLock(&Lock);
+    return Endpoints.Num() == 0;
+}
+
+void FDeepSeekEndpointPool::SetPolicy(EDeepSeekRoutingPolicy InPolicy)
+{
+    FScopeLock ScopeLock(&Lock);
+    Policy = InPolicy;
+}
+
+void FDeepSeekEndpointPool::SetCircuitBreaker(int32 InFailureThreshold, float InCooldownSeconds)
+{
+    FScopeLock ScopeLock(&Lock);
+    FailureThreshold = FMath::Max(1, InFailureThreshold);
+    CooldownSeconds = FMath::Max(0.0f, InCooldownSeconds);
+}
+
+bool FDeepSeekEndpointPool::IsAvailable(FEndpoint& Endpoint, double Now)
+{
+    switch (Endpoint.State)
+    {
+    case EDeepSeekCircuitState::Open:
+        if (Now < Endpoint.OpenUntil)
+        {
+            return false;
+        }
+        Endpoint.State = EDeepSeekCircuitState::HalfOpen;
+        Endpoint.bProbeInFlight = false;
+        return true;
+
+    case EDeepSeekCircuitState::HalfOpen:
+        return !Endpoint.bProbeInFlight;
+
+    default:
+        return true;
+    }
+}
+
+bool FDeepSeekEndpointPool::HasCapacity(const FEndpoint& Endpoint) const
+{
+    return Endpoint.Config.MaxInFlight <= 0 || Endpoint.Outstanding < Endpoint.Config.MaxInFlight;
+}
+
+FDeepSeekEndpointPool::EAcquireResult FDeepSeekEndpointPool::Acquire(FLease& OutLease, int32 ExcludeId, double& OutWaitSeconds)
+{
+    FScopeLock ScopeLock(&Lock);
+    OutWaitSeconds = 0.0;
+    if (Endpoints.Num() == 0)
+    {
+        return EAcquireResult::Empty;
+    }
+
+    const double Now = FPlatformTime::Seconds();
+
+    // 依次放宽条件：常规端点、溢出端点、被排除的端点、已满的端点
+    TArray<int32, TInlineAllocator<8>> Available;
+    for (int32 Index = 0; Index < Endpoints.Num(); ++Index)
+    {
+        if (IsAvailable(Endpoints[Index], Now))
+        {
+            Available.Add(Index);
+        }
+    }
+
+    TArray<int32> Candidates;
+    for (int32 Pass = 0; Pass < 4 && Candidates.Num() == 0; ++Pass)
+    {
+        for (const int32 Index : Available)
+        {
+            const FEndpoint& Endpoint = Endpoints[Index];
+            const bool bAllowOverflow = Pass >= 1;
+            const bool bAllowExcluded = Pass >= 2;
+            const bool bAllowFull = Pass >= 3;
+            if ((bAllowOverflow || !Endpoint.Config.bOverflowOnly)
+                && (bAllowExcluded || Endpoint.Id != ExcludeId)
+                && (bAllowFull || HasCapacity(Endpoint)))
+            {
+                Candidates.Add(Index);
+            }
+        }
+    }
+
+    if (Candidates.Num() == 0)
+    {
+        // 全部熔断或正在探测时不额外放行探测请求，返回最早结束冷却的等待时间
+        OutWaitSeconds = DeepSeekEndpoints::ProbeWaitSeconds;
+        for (const FEndpoint& Endpoint : Endpoints)
+        {
+            if (Endpoint.State == EDeepSeekCircuitState::Open)
+            {
+                OutWaitSeconds = FMath::Min(OutWaitSeconds, FMath::Max(0.0, Endpoint.OpenUntil - Now));
+            }
+        }
+        return EAcquireResult::Unavailable;
+    }
+
+    const int32 Selected = Policy == EDeepSeekRoutingPolicy::LatencyWeighted
+        ? SelectLatencyWeighted(Candidates)
+        : SelectLeastOutstanding(Candidates);
+
+    FEndpoint& Endpoint = Endpoints[Selected];
+    if (Endpoint.State == EDeepSeekCircuitState::HalfOpen)
+    {
+        Endpoint.bProbeInFlight = true;
+    }
+    ++Endpoint.Outstanding;
+    ++Endpoint.TotalRequests;
+
+    OutLease.EndpointId = Endpoint.Id;
+    OutLease.URL = Endpoint.Config.URL;
+    OutLease.APIKey = Endpoint.Config.APIKey;
+    return EAcquireResult::Acquired;
+}
+
+int32 FDeepSeekEndpointPool::SelectLeastOutstanding(const TArray<int32>& Candidates) const
+{
+    int32 Best = Candidates[0];
+    double BestLoad = MAX_dbl;
+    for (const int32 Index : Candidates)
+    {
+        const FEndpoint& Endpoint = Endpoints[Index];
+        const double Load = (Endpoint.Outstanding + 1) / FMath::Max(0.01, static_cast<double>(Endpoint.Config.Weight));
+        if (Load < BestLoad || (Load == BestLoad && Endpoint.LatencyEwma < Endpoints[Best].LatencyEwma))
+        {
+            Best = Index;
+            BestLoad = Load;
+        }
+    }
+    return Best;
+}
+
+int32 FDeepSeekEndpointPool::SelectLatencyWeighted(const TArray<int32>& Candidates) const
+{
+    using namespace DeepSeekEndpoints;
+
+    // 权重与延迟成反比，并扣除错误率；执行中的请求越多权重越低
+    TArray<double, TInlineAllocator<8>> Weights;
+    double TotalWeight = 0.0;
+    for (const int32 Index : Candidates)
+    {
+        const FEndpoint& Endpoint = Endpoints[Index];
+        const double Latency = FMath::Max(MinLatencySeconds, Endpoint.LatencyEwma);
+        const double Weight = FMath::Max(0.01, static_cast<double>(Endpoint.Config.Weight))
+            * FMath::Max(0.05, 1.0 - Endpoint.ErrorEwma)
+            / (Latency * (Endpoint.Outstanding + 1));
+        Weights.Add(Weight);
+        TotalWeight += Weight;
+    }
+
+    double Pick = FMath::FRand() * TotalWeight;
+    for (int32 Index = 0; Index < Candidates.Num(); ++Index)
+    {
+        Pick -= Weights[Index];
+        if (Pick <= 0.0)
+        {
+            return Candidates[Index];
+        }
+    }
+    return Candidates.Last();
+}
+
+void FDeepSeekEndpointPool::Release(int32 EndpointId, EOutcome Outcome, double LatencySeconds)
+{
+    using namespace DeepSeekEndpoints;
+
+    FScopeLock ScopeLock(&Lock);
+
+    // 端点可能已被删除或替换
+    FEndpoint* Endpoint = Endpoints.FindByPredicate([EndpointId](const FEndpoint& Candidate) { return Candidate.Id == EndpointId; });
+    if (Endpoint == nullptr)
+    {
+        return;
+    }
+
+    Endpoint->Outstanding = FMath::Max(0, Endpoint->Outstanding - 1);
+    const bool bWasProbe = Endpoint->State == EDeepSeekCircuitState::HalfOpen && Endpoint->bProbeInFlight;
+    if (bWasProbe)
+    {
+        Endpoint->bProbeInFlight = false;
+    }
+
+    if (LatencySeconds > 0.0)
+    {
+        Endpoint->LatencyEwma = Endpoint->LatencyEwma > 0.0
+            ? Endpoint->LatencyEwma + LatencyAlpha * (LatencySeconds - Endpoint->LatencyEwma)
+            : LatencySeconds;
+    }
+
+    const double Now = FPlatformTime::Seconds();
+    switch (Outcome)
+    {
+    case EOutcome::Succeeded:
+        Endpoint->ErrorEwma += ErrorAlpha * (0.0 - Endpoint->ErrorEwma);
+        Endpoint->ConsecutiveFailures = 0;
+        if (Endpoint->State != EDeepSeekCircuitState::Closed)
+        {
+            UE_LOG(LogPaasAI, Log, TEXT("[Endpoints] %s recovered"), *Endpoint->Config.Name);
+            Endpoint->State = EDeepSeekCircuitState::Closed;
+            Endpoint->Trips = 0;
+        }
+        break;
+
+    case EOutcome::Failed:
+        Endpoint->ErrorEwma += ErrorAlpha * (1.0 - Endpoint->ErrorEwma);
+        ++Endpoint->TotalFailures;
+        ++Endpoint->ConsecutiveFailures;
+        if (bWasProbe || (Endpoint->State == EDeepSeekCircuitState::Closed && Endpoint->ConsecutiveFailures >= FailureThreshold))
+        {
+            Trip(*Endpoint, Now);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void FDeepSeekEndpointPool::Trip(FEndpoint& Endpoint, double Now)
+{
+    const double Cooldown = CooldownSeconds * static_cast<double>(1 << FMath::Min(Endpoint.Trips, DeepSeekEndpoints::MaxCooldownShift));
+    Endpoint.State = EDeepSeekCircuitState::Open;
+    Endpoint.OpenUntil = Now + Cooldown;
+    ++Endpoint.Trips;
+
+    UE_LOG(LogPaasAI, Warning, TEXT("[Endpoints] %s failed %d times in a row, paused for %.0fs"),
+        *Endpoint.Config.Name, Endpoint.ConsecutiveFailures, Cooldown);
+}
+
+TArray<FDeepSeekEndpointStats> FDeepSeekEndpointPool::GetStats() const
+{
+    FScopeLock ScopeLock(&Lock);
+
+    TArray<FDeepSeekEndpointStats> Stats;
+    Stats.Reserve(Endpoints.Num());
+    for (const FEndpoint& Endpoint : Endpoints)
+    {
+        FDeepSeekEndpointStats& Entry = Stats.AddDefaulted_GetRef();
+        Entry.Name = Endpoint.Config.Name;
+        Entry.URL = Endpoint.Config.URL;
+        Entry.Outstanding = Endpoint.Outstanding;
+        Entry.LatencyMs = static_cast<float>(Endpoint.LatencyEwma * 1000.0);
+        Entry.ErrorRate = static_cast<float>(Endpoint.ErrorEwma);
+        Entry.CircuitState = Endpoint.State;
+        Entry.TotalRequests = Endpoint.TotalRequests;
+        Entry.TotalFailures = Endpoint.TotalFailures;
+    }
+    return Stats;
+}
+
+void UDeepSeekEndpointLibrary::AddEndpoint(const FDeepSeekEndpointConfig& Config)
+{
+    if (FPaasAIModuleModule* Module = FPaasAIModuleModule::Get())
+    {
+        Module->AddEndpoint(Config);
+    }
+}
+
+bool UDeepSeekEndpointLibrary::RemoveEndpoint(const FString& Name)
+{
+    FPaasAIModuleModule* Module = FPaasAIModuleModule::Get();
+    return Module != nullptr && Module->GetEndpointPool().RemoveEndpoint(Name);
+}
+
+void UDeepSeekEndpointLibrary::ClearEndpoints()
+{
+    if (FPaasAIModuleModule* Module = FPaasAIModuleModule::Get())
+    {
+        Module->GetEndpointPool().Empty();
+    }
+}
+
+void UDeepSeekEndpointLibrary::SetRoutingPolicy(EDeepSeekRoutingPolicy Policy)
+{
+    if (FPaasAIModuleModule* Module = FPaasAIModuleModule::Get())
+    {
+        Module->GetEndpointPool().SetPolicy(Policy);
+    }
+}
+
+TArray<FDeepSeekEndpointStats> UDeepSeekEndpointLibrary::GetEndpointStats()
+{
+    FPaasAIModuleModule* Module = FPaasAIModuleModule::Get();
+    return Module != nullptr ? Module->GetEndpointPool().GetStats() : TArray<FDeepSeekEndpointStats>();
+}
+
+bool UDeepSeekEndpointLibrary::HasEndpoints()
+{
+    FPaasAIModuleModule* Module = FPaasAIModuleModule::Get();
+    return Module != nullptr && !Module->GetEndpointPool().IsEmpty();
+}
@@ -0,0 +1,373 @@
+﻿// DeepSeekJsonScanner.cpp
+#include "DeepSeekJsonScanner.h"
+
+namespace DeepSeekJsonScanner
+{
+    static int32 HexDigitValue(UTF8CHAR Char)
+    {
+        if (Char >= '0' && Char <= '9') return Char - '0';
+        if (Char >= 'a' && Char <= 'f') return Char - 'a' + 10;
+        if (Char >= 'A' && Char <= 'F') return Char - 'A' + 10;
+        return -1;
+    }
+
+    static bool ParseHex4(const UTF8CHAR* Begin, const UTF8CHAR* End, uint32& OutValue)
+    {
+        if (End - Begin < 4)
+        {
+            return false;
+        }
+
+        OutValue = 0;
+        for (int32 Index = 0; Index < 4; ++Index)
+        {
+            const int32 Digit = HexDigitValue(Begin[Index]);
+            if (Digit < 0)
+            {
+                return false;
+            }
+            OutValue = (OutValue << 4) | static_cast<uint32>(Digit);
+        }
+        return true;
+    }
+
+    static void AppendUTF8Run(FString& Out, const UTF8CHAR* Begin, const UTF8CHAR* End)
+    {
+        if (Begin < End)
+        {
+            // FUTF8ToTCHAR自带内联缓冲，普通长度的token不会产生堆分配
+            FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Begin), static_cast<int32>(End - Begin));
+            Out.AppendChars(Converted.Get(), Converted.Length());
+        }
+    }
+
+    static void AppendCodepoint(FString& Out, uint32 Codepoint)
+    {
+        if (sizeof(TCHAR) == 2 && Codepoint > 0xFFFF)
+        {
+            Codepoint -= 0x10000;
+            Out.AppendChar(static_cast<TCHAR>(0xD800 + (Codepoint >> 10)));
+            Out.AppendChar(static_cast<TCHAR>(0xDC00 + (Codepoint & 0x3FF)));
+        }
+        else
+        {
+            Out.AppendChar(static_cast<TCHAR>(Codepoint));
+        }
+    }
+}
+
+FDeepSeekJsonScanner::FDeepSeekJsonScanner(FUtf8StringView InJson)
+    : Cursor(InJson.GetData())
+    , End(InJson.GetData() + InJson.Len())
+{
+}
+
+bool FDeepSeekJsonScanner::BeginObject()
+{
+    return Expect('{');
+}
+
+bool FDeepSeekJsonScanner::NextKey(FUtf8StringView& OutKey)
+{
+    SkipWhitespace();
+    if (Cursor < End && *Cursor == ',')
+    {
+        ++Cursor;
+        SkipWhitespace();
+    }
+
+    if (Cursor >= End)
+    {
+        return Fail();
+    }
+
+    if (*Cursor == '}')
+    {
+        ++Cursor;
+        return false;
+    }
+
+    const UTF8CHAR* KeyBegin = nullptr;
+    const UTF8CHAR* KeyEnd = nullptr;
+    if (!ScanString(KeyBegin, KeyEnd) || !Expect(':'))
+    {
+        return Fail();
+    }
+
+    OutKey = FUtf8StringView(KeyBegin, static_cast<int32>(KeyEnd - KeyBegin));
+    return true;
+}
+
+bool FDeepSeekJsonScanner::BeginArray()
+{
+    return Expect('[');
+}
+
+bool FDeepSeekJsonScanner::NextElement()
+{
+    SkipWhitespace();
+    if (Cursor < End && *Cursor == ',')
+    {
+        ++Cursor;
+        SkipWhitespace();
+    }
+
+    if (Cursor >= End)
+    {
+        return Fail();
+    }
+
+    if (*Cursor == ']')
+    {
+        ++Cursor;
+        return false;
+    }
+    return true;
+}
+
+bool FDeepSeekJsonScanner::ReadString(FString& Out)
+{
+    if (TryReadNull())
+    {
+        return false;
+    }
+
+    const UTF8CHAR* Begin = nullptr;
+    const UTF8CHAR* StringEnd = nullptr;
+    if (!ScanString(Begin, StringEnd))
+    {
+        return Fail();
+    }
+
+    AppendUnescaped(Out, Begin, StringEnd);
+    return true;
+}
+
+bool FDeepSeekJsonScanner::ReadInteger(int64& OutValue)
+{
+    if (TryReadNull())
+    {
+        return false;
+    }
+
+    bool bNegative = false;
+    if (Cursor < End && *Cursor == '-')
+    {
+        bNegative = true;
+        ++Cursor;
+    }
+
+    if (Cursor >= End || *Cursor < '0' || *Cursor > '9')
+    {
+        return Fail();
+    }
+
+    int64 Value = 0;
+    while (Cursor < End && *Cursor >= '0' && *Cursor <= '9')
+    {
+        Value = Value * 10 + (*Cursor - '0');
+        ++Cursor;
+    }
+
+    // 忽略小数和指数部分
+    while (Cursor < End && (*Cursor == '.' || *Cursor == 'e' || *Cursor == 'E' || *Cursor == '+' || *Cursor == '-' || (*Cursor >= '0' && *Cursor <= '9')))
+    {
+        ++Cursor;
+    }
+
+    OutValue = bNegative ? -Value : Value;
+    return true;
+}
+
+bool FDeepSeekJsonScanner::TryReadNull()
+{
+    SkipWhitespace();
+    if (End - Cursor >= 4 && FMemory::Memcmp(Cursor, "null", 4) == 0)
+    {
+        Cursor += 4;
+        return true;
+    }
+    return false;
+}
+
+UTF8CHAR FDeepSeekJsonScanner::PeekValue()
+{
+    SkipWhitespace();
+    return Cursor < End ? *Cursor : UTF8CHAR('\0');
+}
+
+bool FDeepSeekJsonScanner::SkipValue()
+{
+    SkipWhitespace();
+    if (Cursor >= End)
+    {
+        return Fail();
+    }
+
+    if (*Cursor == '"')
+    {
+        const UTF8CHAR* Begin = nullptr;
+        const UTF8CHAR* StringEnd = nullptr;
+        return ScanString(Begin, StringEnd) || Fail();
+    }
+
+    if (*Cursor == '{' || *Cursor == '[')
+    {
+        // 只需匹配括号深度，字符串内的括号要跳过
+        int32 Depth = 0;
+        while (Cursor < End)
+        {
+            const UTF8CHAR Char = *Cursor;
+            if (Char == '"')
+            {
+                const UTF8CHAR* Begin = nullptr;
+                const UTF8CHAR* StringEnd = nullptr;
+                if (!ScanString(Begin, StringEnd))
+                {
+                    return Fail();
+                }
+                continue;
+            }
+
+            ++Cursor;
+            if (Char == '{' || Char == '[')
+            {
+                ++Depth;
+            }
+            else if ((Char == '}' || Char == ']') && --Depth == 0)
+            {
+                return true;
+            }
+        }
+        return Fail();
+    }
+
+    // 数字、true、false、null
+    while (Cursor < End && *Cursor != ',' && *Cursor != '}' && *Cursor != ']'
+        && *Cursor != ' ' && *Cursor != '\t' && *Cursor != '\r' && *Cursor != '\n')
+    {
+        ++Cursor;
+    }
+    return true;
+}
+
+void FDeepSeekJsonScanner::AppendUnescaped(FString& Out, const UTF8CHAR* Begin, const UTF8CHAR* StringEnd)
+{
+    const UTF8CHAR* RunBegin = Begin;
+    const UTF8CHAR* Current = Begin;
+
+    while (Current < StringEnd)
+    {
+        if (*Current != '\\')
+        {
+            ++Current;
+            continue;
+        }
+
+        // 先输出转义符之前的连续普通字符
+        DeepSeekJsonScanner::AppendUTF8Run(Out, RunBegin, Current);
+        if (Current + 1 >= StringEnd)
+        {
+            return;
+        }
+
+        const UTF8CHAR Escaped = Current[1];
+        Current += 2;
+        switch (Escaped)
+        {
+        case 'n': Out.AppendChar(TEXT('\n')); break;
+        case 't': Out.AppendChar(TEXT('\t')); break;
+        case 'r': Out.AppendChar(TEXT('\r')); break;
+        case 'b': Out.AppendChar(TEXT('\b')); break;
+        case 'f': Out.AppendChar(TEXT('\f')); break;
+        case 'u':
+            {
+                uint32 Codepoint = 0;
+                if (!DeepSeekJsonScanner::ParseHex4(Current, StringEnd, Codepoint))
+                {
+                    break;
+                }
+                Current += 4;
+
+                // 代理对
+                uint32 LowSurrogate = 0;
+                if (Codepoint >= 0xD800 && Codepoint <= 0xDBFF
+                    && StringEnd - Current >= 6 && Current[0] == '\\' && Current[1] == 'u'
+                    && DeepSeekJsonScanner::ParseHex4(Current + 2, StringEnd, LowSurrogate)
+                    && LowSurrogate >= 0xDC00 && LowSurrogate <= 0xDFFF)
+                {
+                    Codepoint = 0x10000 + ((Codepoint - 0xD800) << 10) + (LowSurrogate - 0xDC00);
+                    Current += 6;
+                }
+                DeepSeekJsonScanner::AppendCodepoint(Out, Codepoint);
+                break;
+            }
+        default:
+            // \" \\ \/ 直接输出字符本身
+            Out.AppendChar(static_cast<TCHAR>(Escaped));
+            break;
+        }
+        RunBegin = Current;
+    }
+
+    DeepSeekJsonScanner::AppendUTF8Run(Out, RunBegin, StringEnd);
+}
+
+void FDeepSeekJsonScanner::SkipWhitespace()
+{
+    while (Cursor < End && (*Cursor == ' ' || *Cursor == '\t' || *Cursor == '\r' || *Cursor == '\n'))
+    {
+        ++Cursor;
+    }
+}
+
+bool FDeepSeekJsonScanner::Expect(ANSICHAR Char)
+{
+    SkipWhitespace();
+    if (Cursor < End && *Cursor == Char)
+    {
+        ++Cursor;
+        return true;
+    }
+    return Fail();
+}
+
+bool FDeepSeekJsonScanner::ScanString(const UTF8CHAR*& OutBegin, const UTF8CHAR*& OutEnd)
+{
+    SkipWhitespace();
+    if (Cursor >= End || *Cursor != '"')
+    {
+        return false;
+    }
+
+    const UTF8CHAR* Begin = ++Cursor;
+    while (Cursor < End)
+    {
+        if (*Cursor == '\\')
+        {
+            if (End - Cursor < 2)
+            {
+                break;
+            }
+            Cursor += 2;
+            continue;
+        }
+        if (*Cursor == '"')
+        {
+            OutBegin = Begin;
+            OutEnd = Cursor++;
+            return true;
+        }
+        ++Cursor;
+    }
+
+    Cursor = End;
+    return false;
+}
+
+bool FDeepSeekJsonScanner::Fail()
+{
+    bError = true;
+    Cursor = End;
+    return false;
+}
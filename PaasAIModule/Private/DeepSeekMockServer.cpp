@@ -0,0 +1,485 @@
+﻿// DeepSeekMockServer.cpp
+#include "DeepSeekMockServer.h"
+
+#if !UE_BUILD_SHIPPING
+
+#include "PaasAILog.h"
+#include "HAL/RunnableThread.h"
+#include "IPAddress.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+
+namespace DeepSeekMockServer
+{
+    // 轮流使用ASCII、中文和4字节字符，"\\n"是JSON转义后的换行
+    static const TCHAR* const TokenPieces[] =
+    {
+        TEXT("Hello"), TEXT(" world"), TEXT("，"), TEXT("你好"), TEXT("世界"), TEXT("。"), TEXT("\\n"), TEXT("\U0001F600")
+    };
+
+    static const TCHAR* const ChatPath = TEXT("/v1/chat/completions");
+
+    // 服务线程没有进展时的休眠秒数
+    static constexpr float IdleSleepSeconds = 0.0005f;
+
+    static constexpr int32 RecvBufferSize = 16 * 1024;
+
+    static const TCHAR* GetReasonPhrase(int32 Code)
+    {
+        switch (Code)
+        {
+        case 200: return TEXT("OK");
+        case 400: return TEXT("Bad Request");
+        case 401: return TEXT("Unauthorized");
+        case 404: return TEXT("Not Found");
+        case 408: return TEXT("Request Timeout");
+        case 429: return TEXT("Too Many Requests");
+        case 503: return TEXT("Service Unavailable");
+        default: return Code >= 500 ? TEXT("Internal Server Error") : TEXT("Error");
+        }
+    }
+
+    /** 在字节中查找子串，找不到时返回INDEX_NONE */
+    static int32 Find(const TArray<uint8>& Data, FAnsiStringView Needle, int32 StartIndex = 0)
+    {
+        for (int32 Index = StartIndex; Index + Needle.Len() <= Data.Num(); ++Index)
+        {
+            if (FMemory::Memcmp(Data.GetData() + Index, Needle.GetData(), Needle.Len()) == 0)
+            {
+                return Index;
+            }
+        }
+        return INDEX_NONE;
+    }
+}
+
+FDeepSeekMockServer::~FDeepSeekMockServer()
+{
+    Shutdown();
+}
+
+bool FDeepSeekMockServer::Start(uint16 Port)
+{
+    if (Thread != nullptr)
+    {
+        return true;
+    }
+
+    ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+    if (SocketSubsystem == nullptr)
+    {
+        return false;
+    }
+
+    ListenSocket = SocketSubsystem->CreateSocket(NAME_Stream, TEXT("PaasAI mock server"), FNetworkProtocolTypes::IPv4);
+    if (ListenSocket == nullptr)
+    {
+        return false;
+    }
+
+    TSharedRef<FInternetAddr> Address = SocketSubsystem->CreateInternetAddr(FNetworkProtocolTypes::IPv4);
+    Address->SetLoopbackAddress();
+    Address->SetPort(Port);
+    ListenSocket->SetReuseAddr(true);
+    ListenSocket->SetNonBlocking(true);
+    if (!ListenSocket->Bind(*Address) || !ListenSocket->Listen(1024))
+    {
+        UE_LOG(LogPaasAI, Warning, TEXT("[MockServer] Failed to listen on port %d"), Port);
+        SocketSubsystem->DestroySocket(ListenSocket);
+        ListenSocket = nullptr;
+        return false;
+    }
+
+    BoundPort = static_cast<uint16>(ListenSocket->GetPortNo());
+    bStopping = false;
+    RequestCount = 0;
+    Thread = FRunnableThread::Create(this, TEXT("PaasAIMockServer"));
+    UE_LOG(LogPaasAI, Log, TEXT("[MockServer] Listening on %s"), *GetURL());
+    return Thread != nullptr;
+}
+
+void FDeepSeekMockServer::Shutdown()
+{
+    if (Thread != nullptr)
+    {
+        bStopping = true;
+        Thread->WaitForCompletion();
+        delete Thread;
+        Thread = nullptr;
+    }
+
+    for (FConnection& Connection : Connections)
+    {
+        CloseConnection(Connection);
+    }
+    Connections.Reset();
+
+    if (ListenSocket != nullptr)
+    {
+        ListenSocket->Close();
+        ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(ListenSocket);
+        ListenSocket = nullptr;
+    }
+}
+
+FString FDeepSeekMockServer::GetURL() const
+{
+    return FString::Printf(TEXT("http://127.0.0.1:%d%s"), BoundPort, DeepSeekMockServer::ChatPath);
+}
+
+void FDeepSeekMockServer::SetConfig(const FDeepSeekMockServerConfig& InConfig)
+{
+    FScopeLock ScopeLock(&ConfigLock);
+    Config = InConfig;
+}
+
+FString FDeepSeekMockServer::BuildStream(int32 NumTokens, TArray<uint8>& OutStream, TArray<int32>* OutEventEnds)
+{
+    using namespace DeepSeekMockServer;
+
+    FString Expected;
+    OutStream.Reset();
+    if (OutEventEnds != nullptr)
+    {
+        OutEventEnds->Reset(NumTokens + 2);
+    }
+
+    auto AppendEvent = [&OutStream, OutEventEnds](const FString& Event)
+    {
+        AppendString(OutStream, Event);
+        if (OutEventEnds != nullptr)
+        {
+            OutEventEnds->Add(OutStream.Num());
+        }
+    };
+
+    for (int32 Index = 0; Index < NumTokens; ++Index)
+    {
+        const TCHAR* Piece = TokenPieces[Index % UE_ARRAY_COUNT(TokenPieces)];
+        AppendEvent(FString::Printf(TEXT("data: {\"id\":\"mock\",\"object\":\"chat.completion.chunk\",\"choices\":[{\"index\":0,\"delta\":{\"content\":\"%s\"},\"finish_reason\":null}]}\n\n"), Piece));
+        Expected.Append(FCString::Strcmp(Piece, TEXT("\\n")) == 0 ? TEXT("\n") : Piece);
+    }
+    AppendEvent(FString::Printf(TEXT("data: {\"id\":\"mock\",\"choices\":[{\"index\":0,\"delta\":{},\"finish_reason\":\"stop\"}],\"usage\":{\"prompt_tokens\":16,\"completion_tokens\":%d,\"total_tokens\":%d}}\n\n"), NumTokens, NumTokens + 16));
+    AppendEvent(TEXT("data: [DONE]\n\n"));
+    return Expected;
+}
+
+void FDeepSeekMockServer::AppendString(TArray<uint8>& Out, const FString& Text)
+{
+    const FTCHARToUTF8 Utf8(*Text, Text.Len());
+    Out.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+}
+
+uint32 FDeepSeekMockServer::Run()
+{
+    while (!bStopping)
+    {
+        bool bProgress = false;
+
+        bool bPendingConnection = false;
+        while (ListenSocket->HasPendingConnection(bPendingConnection) && bPendingConnection)
+        {
+            FSocket* Socket = ListenSocket->Accept(TEXT("PaasAI mock connection"));
+            if (Socket == nullptr)
+            {
+                break;
+            }
+            Socket->SetNonBlocking(true);
+            Socket->SetNoDelay(true);
+            Connections.AddDefaulted_GetRef().Socket = Socket;
+            bProgress = true;
+        }
+
+        for (int32 Index = Connections.Num() - 1; Index >= 0; --Index)
+        {
+            FConnection& Connection = Connections[Index];
+            if (!Connection.bClosing)
+            {
+                bProgress |= ReadRequests(Connection);
+            }
+            if (Connection.bStreaming && !Connection.bClosing)
+            {
+                bProgress |= WriteStream(Connection);
+            }
+            bProgress |= FlushOutbox(Connection);
+
+            if (Connection.bClosing && Connection.Outbox.Num() == 0)
+            {
+                CloseConnection(Connection);
+                Connections.RemoveAtSwap(Index);
+            }
+        }
+
+        if (!bProgress)
+        {
+            FPlatformProcess::Sleep(DeepSeekMockServer::IdleSleepSeconds);
+        }
+    }
+    return 0;
+}
+
+bool FDeepSeekMockServer::ReadRequests(FConnection& Connection)
+{
+    using namespace DeepSeekMockServer;
+
+    bool bProgress = false;
+    uint8 Buffer[RecvBufferSize];
+    for (;;)
+    {
+        // 没有数据时Recv返回true和0字节，对方关闭连接时返回false
+        int32 BytesRead = 0;
+        if (!Connection.Socket->Recv(Buffer, RecvBufferSize, BytesRead))
+        {
+            Connection.bStreaming = false;
+            Connection.bClosing = true;
+            Connection.Outbox.Reset();
+            return true;
+        }
+        if (BytesRead == 0)
+        {
+            break;
+        }
+        Connection.Received.Append(Buffer, BytesRead);
+        bProgress = true;
+    }
+
+    // 上一个回答发完之前不处理同一连接上的下一个请求
+    while (!Connection.bStreaming && !Connection.bClosing)
+    {
+        const int32 HeaderEnd = Find(Connection.Received, "\r\n\r\n");
+        if (HeaderEnd == INDEX_NONE)
+        {
+            break;
+        }
+
+        const FString Headers(HeaderEnd, reinterpret_cast<const ANSICHAR*>(Connection.Received.GetData()));
+        TArray<FString> Lines;
+        Headers.ParseIntoArrayLines(Lines);
+        if (Lines.Num() == 0)
+        {
+            Connection.bClosing = true;
+            break;
+        }
+
+        int32 ContentLength = 0;
+        bool bExpectContinue = false;
+        for (int32 LineIndex = 1; LineIndex < Lines.Num(); ++LineIndex)
+        {
+            FString Name;
+            FString Value;
+            if (Lines[LineIndex].Split(TEXT(":"), &Name, &Value))
+            {
+                Value.TrimStartAndEndInline();
+                if (Name.Equals(TEXT("Content-Length"), ESearchCase::IgnoreCase))
+                {
+                    ContentLength = FCString::Atoi(*Value);
+                }
+                else if (Name.Equals(TEXT("Expect"), ESearchCase::IgnoreCase))
+                {
+                    bExpectContinue = Value.Equals(TEXT("100-continue"), ESearchCase::IgnoreCase);
+                }
+            }
+        }
+
+        const int32 BodyStart = HeaderEnd + 4;
+        if (Connection.Received.Num() < BodyStart + ContentLength)
+        {
+            if (bExpectContinue && !Connection.bSentContinue)
+            {
+                AppendString(Connection.Outbox, TEXT("HTTP/1.1 100 Continue\r\n\r\n"));
+                Connection.bSentContinue = true;
+            }
+            break;
+        }
+
+        const bool bHead = Lines[0].StartsWith(TEXT("HEAD "));
+        const int32 StreamFlag = Find(Connection.Received, "\"stream\":true", BodyStart);
+        const bool bStream = StreamFlag != INDEX_NONE && StreamFlag < BodyStart + ContentLength;
+        Connection.Received.RemoveAt(0, BodyStart + ContentLength);
+        Connection.bSentContinue = false;
+
+        BeginResponse(Connection, bHead, bStream);
+        bProgress = true;
+    }
+    return bProgress;
+}
+
+void FDeepSeekMockServer::BeginResponse(FConnection& Connection, bool bHead, bool bStream)
+{
+    using namespace DeepSeekMockServer;
+
+    // 连接预热的HEAD请求不计数
+    if (bHead)
+    {
+        AppendString(Connection.Outbox, TEXT("HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: keep-alive\r\n\r\n"));
+        return;
+    }
+
+    {
+        FScopeLock ScopeLock(&ConfigLock);
+        Connection.Config = Config;
+    }
+    const FDeepSeekMockServerConfig& RequestConfig = Connection.Config;
+
+    const int32 RequestIndex = RequestCount++;
+    if (RequestIndex < RequestConfig.FailFirstRequests || Random.FRand() < RequestConfig.ErrorRate)
+    {
+        const FString ErrorBody = FString::Printf(TEXT("{\"error\":{\"message\":\"Mock error %d\",\"type\":\"mock_error\"}}"), RequestConfig.ErrorCode);
+        const FTCHARToUTF8 ErrorUtf8(*ErrorBody);
+        FString Header = FString::Printf(TEXT("HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %d\r\nConnection: keep-alive\r\n"),
+            RequestConfig.ErrorCode, GetReasonPhrase(RequestConfig.ErrorCode), ErrorUtf8.Length());
+        if (RequestConfig.ErrorCode == 429)
+        {
+            Header.Appendf(TEXT("Retry-After: %d\r\n"), RequestConfig.RetryAfterSeconds);
+        }
+        Header.Append(TEXT("\r\n"));
+        AppendString(Connection.Outbox, Header);
+        Connection.Outbox.Append(reinterpret_cast<const uint8*>(ErrorUtf8.Get()), ErrorUtf8.Length());
+        return;
+    }
+
+    Connection.bStreaming = true;
+    Connection.bChunked = bStream;
+    Connection.BodySent = 0;
+    Connection.NextEvent = 0;
+    Connection.ResponseStart = FPlatformTime::Seconds();
+
+    if (!bStream)
+    {
+        // 非流式回答在首token延迟之后一次写出
+        FString Content;
+        for (int32 Index = 0; Index < RequestConfig.NumTokens; ++Index)
+        {
+            Content.Append(TokenPieces[Index % UE_ARRAY_COUNT(TokenPieces)]);
+        }
+        const FString Body = FString::Printf(TEXT("{\"id\":\"mock\",\"object\":\"chat.completion\",\"choices\":[{\"index\":0,\"message\":{\"role\":\"assistant\",\"content\":\"%s\"},\"finish_reason\":\"stop\"}],\"usage\":{\"prompt_tokens\":16,\"completion_tokens\":%d,\"total_tokens\":%d}}"),
+            *Content, RequestConfig.NumTokens, RequestConfig.NumTokens + 16);
+        const FTCHARToUTF8 BodyUtf8(*Body);
+        Connection.Body.Reset();
+        AppendString(Connection.Body, FString::Printf(TEXT("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %d\r\nConnection: keep-alive\r\n\r\n"), BodyUtf8.Length()));
+        Connection.Body.Append(reinterpret_cast<const uint8*>(BodyUtf8.Get()), BodyUtf8.Length());
+        Connection.EventEnds.Reset();
+        Connection.EventEnds.Add(Connection.Body.Num());
+        Connection.DisconnectAt = INDEX_NONE;
+        return;
+    }
+
+    AppendString(Connection.Outbox, TEXT("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nTransfer-Encoding: chunked\r\nConnection: keep-alive\r\n\r\n"));
+    BuildStream(FMath::Max(1, RequestConfig.NumTokens), Connection.Body, &Connection.EventEnds);
+    Connection.DisconnectAt = Random.FRand() < RequestConfig.DisconnectRate ? Connection.Body.Num() / 2 : INDEX_NONE;
+}
+
+bool FDeepSeekMockServer::WriteStream(FConnection& Connection)
+{
+    const FDeepSeekMockServerConfig& RequestConfig = Connection.Config;
+    const int32 LastTokenEvent = FMath::Max(1, RequestConfig.NumTokens) - 1;
+
+    // 第i个事件在首token延迟之后的第i个间隔发出，结束事件和[DONE]随最后一个token一起发出
+    const double Elapsed = FPlatformTime::Seconds() - Connection.ResponseStart;
+    while (Connection.NextEvent < Connection.EventEnds.Num())
+    {
+        const double EventTime = RequestConfig.FirstTokenDelaySeconds
+            + RequestConfig.TokenDelaySeconds * FMath::Min(Connection.NextEvent, LastTokenEvent);
+        if (EventTime > Elapsed)
+        {
+            break;
+        }
+        ++Connection.NextEvent;
+    }
+    const int32 Released = Connection.NextEvent > 0 ? Connection.EventEnds[Connection.NextEvent - 1] : 0;
+    if (Connection.BodySent >= Released)
+    {
+        return false;
+    }
+
+    if (!Connection.bChunked)
+    {
+        Connection.Outbox.Append(Connection.Body.GetData() + Connection.BodySent, Released - Connection.BodySent);
+        Connection.BodySent = Released;
+        Connection.bStreaming = false;
+        return true;
+    }
+
+    int32 EventCursor = 0;
+    while (Connection.BodySent < Released)
+    {
+        // 每块单独编码为一个HTTP分块，块大小为0时按事件边界切分
+        int32 PieceEnd;
+        if (RequestConfig.ChunkBytes > 0)
+        {
+            PieceEnd = Connection.BodySent + RequestConfig.ChunkBytes;
+        }
+        else if (RequestConfig.ChunkBytes < 0)
+        {
+            PieceEnd = Connection.BodySent + Random.RandRange(1, 64);
+        }
+        else
+        {
+            while (Connection.EventEnds[EventCursor] <= Connection.BodySent)
+            {
+                ++EventCursor;
+            }
+            PieceEnd = Connection.EventEnds[EventCursor];
+        }
+        PieceEnd = FMath::Min(PieceEnd, Released);
+
+        if (Connection.DisconnectAt != INDEX_NONE && PieceEnd >= Connection.DisconnectAt)
+        {
+            // 模拟连接中断：发出一半后不再结束分块编码，直接关闭
+            Connection.bStreaming = false;
+            Connection.bClosing = true;
+            return true;
+        }
+
+        const int32 PieceLength = PieceEnd - Connection.BodySent;
+        AppendString(Connection.Outbox, FString::Printf(TEXT("%x\r\n"), PieceLength));
+        Connection.Outbox.Append(Connection.Body.GetData() + Connection.BodySent, PieceLength);
+        AppendString(Connection.Outbox, TEXT("\r\n"));
+        Connection.BodySent = PieceEnd;
+
+        // 小块逐个写入套接字，客户端才会分多次收到
+        FlushOutbox(Connection);
+    }
+
+    if (Connection.BodySent == Connection.Body.Num())
+    {
+        AppendString(Connection.Outbox, TEXT("0\r\n\r\n"));
+        Connection.bStreaming = false;
+    }
+    return true;
+}
+
+bool FDeepSeekMockServer::FlushOutbox(FConnection& Connection)
+{
+    if (Connection.Outbox.Num() == 0 || Connection.Socket == nullptr)
+    {
+        return false;
+    }
+
+    int32 BytesSent = 0;
+    if (!Connection.Socket->Send(Connection.Outbox.GetData(), Connection.Outbox.Num(), BytesSent))
+    {
+        // 发送缓冲区已满时下次再写，其他错误说明连接已经断开
+        if (ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->GetLastErrorCode() != SE_EWOULDBLOCK)
+        {
+            Connection.Outbox.Reset();
+            Connection.bStreaming = false;
+            Connection.bClosing = true;
+        }
+        return false;
+    }
+    Connection.Outbox.RemoveAt(0, BytesSent);
+    return BytesSent > 0;
+}
+
+void FDeepSeekMockServer::CloseConnection(FConnection& Connection)
+{
+    if (Connection.Socket != nullptr)
+    {
+        Connection.Socket->Close();
+        ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Connection.Socket);
+        Connection.Socket = nullptr;
+    }
+}
+
+#endif
@@ -0,0 +1,137 @@
+﻿// DeepSeekMockServer.h
+// 开发用的模拟服务器，发行版中不编译
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if !UE_BUILD_SHIPPING
+
+#include "HAL/Runnable.h"
+#include "Math/RandomStream.h"
+#include <atomic>
+
+class FSocket;
+class FRunnableThread;
+
+/**
+ * 模拟服务器的行为
+ * 运行中修改时对之后收到的请求生效
+ */
+struct FDeepSeekMockServerConfig
+{
+    /** 每个回答的token数 */
+    int32 NumTokens = 64;
+
+    /** 流式回答每次写出的字节数，0表示每个事件写出一次，负数表示随机1~64字节；较小的值会切开UTF-8字符和行 */
+    int32 ChunkBytes = 0;
+
+    /** 收到请求到发出第一个token的秒数 */
+    float FirstTokenDelaySeconds = 0.0f;
+
+    /** 相邻两个token之间的秒数 */
+    float TokenDelaySeconds = 0.0f;
+
+    /** 最先收到的几个请求直接返回ErrorCode，用于测试重试 */
+    int32 FailFirstRequests = 0;
+
+    /** 其余请求按这个比例随机返回ErrorCode */
+    float ErrorRate = 0.0f;
+
+    /** 注入的错误状态码，429时同时返回Retry-After */
+    int32 ErrorCode = 500;
+    int32 RetryAfterSeconds = 1;
+
+    /** 按这个比例在流式回答发出一半时断开连接 */
+    float DisconnectRate = 0.0f;
+};
+
+/**
+ * 进程内的OpenAI兼容模拟服务器
+ * 在本机回环地址上监听，独立线程用非阻塞套接字服务所有连接；支持keep-alive，
+ * 流式回答使用分块传输编码，按配置的延迟和块大小发出录制格式的SSE流。
+ * 供自动化测试和性能测试在没有网络的环境下使用
+ */
+class FDeepSeekMockServer : public FRunnable
+{
+public:
+    virtual ~FDeepSeekMockServer();
+
+    /**
+     * 开始监听
+     * @param Port 为0时由系统分配，通过GetURL获取
+     */
+    bool Start(uint16 Port = 0);
+
+    /** 停止监听并关闭所有连接，等待服务线程退出 */
+    void Shutdown();
+
+    bool IsRunning() const { return Thread != nullptr; }
+
+    /** chat/completions的完整URL */
+    FString GetURL() const;
+
+    void SetConfig(const FDeepSeekMockServerConfig& InConfig);
+
+    /** 收到的chat/completions请求数，包括注入错误的请求 */
+    int32 GetRequestCount() const { return RequestCount.load(); }
+
+    /**
+     * 生成录制格式的SSE流，与服务器发出的内容相同
+     * 轮流使用ASCII、中文和4字节字符，按字节切块时边界会落在UTF-8字符中间
+     * @param OutEventEnds 每个事件结束处的字节偏移
+     * @return 客户端应当拼接出的文本
+     */
+    static FString BuildStream(int32 NumTokens, TArray<uint8>& OutStream, TArray<int32>* OutEventEnds = nullptr);
+
+    //~ FRunnable
+    virtual uint32 Run() override;
+    virtual void Stop() override { bStopping = true; }
+
+private:
+    struct FConnection
+    {
+        FSocket* Socket = nullptr;
+
+        // 尚未处理的请求字节，以及已经编码、尚未写入套接字的字节
+        TArray<uint8> Received;
+        TArray<uint8> Outbox;
+        bool bSentContinue = false;
+
+        // 正在按延迟发出的回答；非流式回答整体作为一个事件，不使用分块编码
+        bool bStreaming = false;
+        bool bChunked = false;
+        TArray<uint8> Body;
+        TArray<int32> EventEnds;
+        int32 BodySent = 0;
+        int32 NextEvent = 0;
+        int32 DisconnectAt = INDEX_NONE;
+        double ResponseStart = 0.0;
+        FDeepSeekMockServerConfig Config;
+
+        bool bClosing = false;
+    };
+
+    // 各步骤返回是否有进展，没有进展时服务线程短暂休眠
+    bool ReadRequests(FConnection& Connection);
+    void BeginResponse(FConnection& Connection, bool bHead, bool bStream);
+    bool WriteStream(FConnection& Connection);
+    bool FlushOutbox(FConnection& Connection);
+    void CloseConnection(FConnection& Connection);
+
+    static void AppendString(TArray<uint8>& Out, const FString& Text);
+
+    FSocket* ListenSocket = nullptr;
+    FRunnableThread* Thread = nullptr;
+    uint16 BoundPort = 0;
+    std::atomic<bool> bStopping { false };
+    std::atomic<int32> RequestCount { 0 };
+
+    // 只由服务线程访问
+    TArray<FConnection> Connections;
+    FRandomStream Random { 42 };
+
+    FCriticalSection ConfigLock;
+    FDeepSeekMockServerConfig Config;
+};
+
+#endif
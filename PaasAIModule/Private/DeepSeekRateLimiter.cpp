@@ -0,0 +1,232 @@
+﻿// DeepSeekRateLimiter.cpp
+#include "DeepSeekRateLimiter.h"
+#include "Interfaces/IHttpResponse.h"
+
+void FDeepSeekRateLimiter::FBucket::SetLimit(double InCapacity, double Now)
+{
+    if (Capacity <= 0.0)
+    {
+        // 第一次得知限额，按满额开始
+        Available = InCapacity;
+        LastRefill = Now;
+    }
+    Capacity = InCapacity;
+    Available = FMath::Min(Available, Capacity);
+}
+
+void FDeepSeekRateLimiter::FBucket::Refill(double Now)
+{
+    if (Capacity <= 0.0)
+    {
+        return;
+    }
+    
+    // 限额按分钟计算，均匀回填
+    Available = FMath::Min(Capacity, Available + (Now - LastRefill) * Capacity / 60.0);
+    LastRefill = Now;
+}
+
+double FDeepSeekRateLimiter::FBucket::GetWaitSeconds(double Amount) const
+{
+    if (Capacity <= 0.0)
+    {
+        return 0.0;
+    }
+    
+    // 单次需求超过总容量时，等到桶满即可放行
+    const double Needed = FMath::Min(Amount, Capacity) - Available;
+    return Needed > 0.0 ? Needed * 60.0 / Capacity : 0.0;
+}
+
+double FDeepSeekRateLimiter::TryAcquire(const FString& EndpointKey, int32 EstimatedTokens, double Now)
+{
+    FScopeLock ScopeLock(&Lock);
+    
+    FEndpointState& State = FindOrAddState(EndpointKey, Now);
+    if (State.BlockedUntil > Now)
+    {
+        return State.BlockedUntil - Now;
+    }
+    
+    State.Requests.Refill(Now);
+    State.Tokens.Refill(Now);
+    
+    const double Wait = FMath::Max(State.Requests.GetWaitSeconds(1.0), State.Tokens.GetWaitSeconds(EstimatedTokens));
+    if (Wait > 0.0)
+    {
+        return Wait;
+    }
+    
+    if (State.Requests.Capacity > 0.0)
+    {
+        State.Requests.Available -= 1.0;
+    }
+    if (State.Tokens.Capacity > 0.0)
+    {
+        State.Tokens.Available -= FMath::Min<double>(EstimatedTokens, State.Tokens.Capacity);
+    }
+    return 0.0;
+}
+
+void FDeepSeekRateLimiter::UpdateFromResponse(const FString& EndpointKey, const IHttpResponse& Response, double Now)
+{
+    FScopeLock ScopeLock(&Lock);
+    
+    FEndpointState& State = FindOrAddState(EndpointKey, Now);
+    
+    // 服务器返回的限额和剩余量比本地估算更准确
+    const FString LimitRequests = Response.GetHeader(TEXT("x-ratelimit-limit-requests"));
+    if (!LimitRequests.IsEmpty())
+    {
+        State.Requests.SetLimit(FCString::Atod(*LimitRequests), Now);
+    }
+    
+    const FString LimitTokens = Response.GetHeader(TEXT("x-ratelimit-limit-tokens"));
+    if (!LimitTokens.IsEmpty())
+    {
+        State.Tokens.SetLimit(FCString::Atod(*LimitTokens), Now);
+    }
+    
+    const FString RemainingRequests = Response.GetHeader(TEXT("x-ratelimit-remaining-requests"));
+    if (!RemainingRequests.IsEmpty() && State.Requests.Capacity > 0.0)
+    {
+        State.Requests.Refill(Now);
+        State.Requests.Available = FMath::Min(State.Requests.Available, FCString::Atod(*RemainingRequests));
+        if (State.Requests.Available <= 0.0)
+        {
+            const double Reset = ParseDuration(Response.GetHeader(TEXT("x-ratelimit-reset-requests")));
+            State.BlockedUntil = FMath::Max(State.BlockedUntil, Now + Reset);
+        }
+    }
+    
+    const FString RemainingTokens = Response.GetHeader(TEXT("x-ratelimit-remaining-tokens"));
+    if (!RemainingTokens.IsEmpty() && State.Tokens.Capacity > 0.0)
+    {
+        State.Tokens.Refill(Now);
+        State.Tokens.Available = FMath::Min(State.Tokens.Available, FCString::Atod(*RemainingTokens));
+        if (State.Tokens.Available <= 0.0)
+        {
+            const double Reset = ParseDuration(Response.GetHeader(TEXT("x-ratelimit-reset-tokens")));
+            State.BlockedUntil = FMath::Max(State.BlockedUntil, Now + Reset);
+        }
+    }
+    
+    const int32 ResponseCode = Response.GetResponseCode();
+    if (ResponseCode == 429 || ResponseCode == 503)
+    {
+        const FString RetryAfter = Response.GetHeader(TEXT("Retry-After"));
+        double Delay = RetryAfter.IsEmpty() ? 0.0 : ParseDuration(RetryAfter);
+        if (Delay <= 0.0)
+        {
+            // 没有给出等待时间时指数退避
+            State.FallbackBackoff = FMath::Clamp(State.FallbackBackoff * 2.0, 1.0, 60.0);
+            Delay = State.FallbackBackoff;
+        }
+        State.BlockedUntil = FMath::Max(State.BlockedUntil, Now + Delay);
+    }
+    else if (ResponseCode >= 200 && ResponseCode < 300)
+    {
+        State.FallbackBackoff = 0.0;
+    }
+}
+
+void FDeepSeekRateLimiter::ReportTokenUsage(const FString& EndpointKey, int32 EstimatedTokens, int32 ActualTokens)
+{
+    FScopeLock ScopeLock(&Lock);
+    
+    FEndpointState* State = Endpoints.Find(EndpointKey);
+    if (State && State->Tokens.Capacity > 0.0 && ActualTokens > 0)
+    {
+        // 归还多预留的部分，或补扣少算的部分
+        State->Tokens.Available = FMath::Min(State->Tokens.Capacity, State->Tokens.Available + (EstimatedTokens - ActualTokens));
+    }
+}
+
+void FDeepSeekRateLimiter::SetDefaultLimits(int32 RequestsPerMinute, int32 TokensPerMinute)
+{
+    FScopeLock ScopeLock(&Lock);
+    DefaultRequestsPerMinute = FMath::Max(0, RequestsPerMinute);
+    DefaultTokensPerMinute = FMath::Max(0, TokensPerMinute);
+}
+
+int32 FDeepSeekRateLimiter::EstimateRequestTokens(int32 RequestBodyBytes, int32 MaxTokens)
+{
+    // 服务商按max_tokens预留输出额度
+    return RequestBodyBytes / 4 + FMath::Max(1, MaxTokens);
+}
+
+double FDeepSeekRateLimiter::ParseDuration(const FString& Value)
+{
+    const FString Trimmed = Value.TrimStartAndEnd();
+    if (Trimmed.IsEmpty())
+    {
+        return 0.0;
+    }
+    
+    // Retry-After通常是秒数
+    if (Trimmed.IsNumeric())
+    {
+        return FCString::Atod(*Trimmed);
+    }
+    
+    // OpenAI风格的时长，如 "1m30s"、"250ms"
+    double Seconds = 0.0;
+    int32 Index = 0;
+    while (Index < Trimmed.Len())
+    {
+        const int32 NumberStart = Index;
+        while (Index < Trimmed.Len() && (FChar::IsDigit(Trimmed[Index]) || Trimmed[Index] == TEXT('.')))
+        {
+            ++Index;
+        }
+        if (NumberStart == Index)
+        {
+            return Seconds;
+        }
+        
+        const double Number = FCString::Atod(*Trimmed.Mid(NumberStart, Index - NumberStart));
+        if (Trimmed.Mid(Index, 2) == TEXT("ms"))
+        {
+            Seconds += Number / 1000.0;
+            Index += 2;
+        }
+        else if (Index < Trimmed.Len() && Trimmed[Index] == TEXT('h'))
+        {
+            Seconds += Number * 3600.0;
+            ++Index;
+        }
+        else if (Index < Trimmed.Len() && Trimmed[Index] == TEXT('m'))
+        {
+            Seconds += Number * 60.0;
+            ++Index;
+        }
+        else
+        {
+            Seconds += Number;
+            if (Index < Trimmed.Len() && Trimmed[Index] == TEXT('s'))
+            {
+                ++Index;
+            }
+        }
+    }
+    return Seconds;
+}
+
+FDeepSeekRateLimiter::FEndpointState& FDeepSeekRateLimiter::FindOrAddState(const FString& EndpointKey, double Now)
+{
+    if (FEndpointState* Existing = Endpoints.Find(EndpointKey))
+    {
+        return *Existing;
+    }
+    
+    FEndpointState& State = Endpoints.Add(EndpointKey);
+    if (DefaultRequestsPerMinute > 0)
+    {
+        State.Requests.SetLimit(DefaultRequestsPerMinute, Now);
+    }
+    if (DefaultTokensPerMinute > 0)
+    {
+        State.Tokens.SetLimit(DefaultTokensPerMinute, Now);
+    }
+    return State;
+}
@@ -0,0 +1,280 @@
+﻿// DeepSeekRequestMetrics.cpp
+#include "DeepSeekRequestMetrics.h"
+#include "PaasAIStats.h"
+#include "HAL/IConsoleManager.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ProfilingDebugging/CountersTrace.h"
+
+CSV_DEFINE_CATEGORY(PaasAI, true);
+
+TRACE_DECLARE_FLOAT_COUNTER(PaasAI_QueueWait, TEXT("PaasAI/QueueWaitMs"));
+TRACE_DECLARE_FLOAT_COUNTER(PaasAI_TimeToFirstByte, TEXT("PaasAI/TimeToFirstByteMs"));
+TRACE_DECLARE_FLOAT_COUNTER(PaasAI_TimeToFirstToken, TEXT("PaasAI/TimeToFirstTokenMs"));
+TRACE_DECLARE_FLOAT_COUNTER(PaasAI_TokensPerSecond, TEXT("PaasAI/TokensPerSecond"));
+
+namespace DeepSeekMetrics
+{
+    // 文本块间隔直方图各桶的上限(毫秒)，最后一桶没有上限
+    static const double LatencyBucketBoundsMs[FDeepSeekMetricsRecorder::NumLatencyBuckets - 1] =
+    {
+        10.0, 25.0, 50.0, 100.0, 250.0, 500.0, 1000.0
+    };
+
+    static float SecondsBetween(double From, double To)
+    {
+        return (From > 0.0 && To >= From) ? static_cast<float>(To - From) : 0.0f;
+    }
+
+    // 所有进行中请求的流式文本缓冲区总量及其峰值，可能在HTTP线程更新
+    static std::atomic<int64> ActiveStreamBufferBytes { 0 };
+    static std::atomic<int64> PeakActiveStreamBufferBytes { 0 };
+
+    // 所有请求在游戏线程上的累计耗时
+    static std::atomic<uint64> TotalGameThreadCycles { 0 };
+
+    static void RaisePeak(std::atomic<int64>& Peak, int64 Value)
+    {
+        int64 Previous = Peak.load();
+        while (Value > Previous && !Peak.compare_exchange_weak(Previous, Value))
+        {
+        }
+    }
+
+    static FAutoConsoleCommand ResetStreamBufferPeakCommand(
+        TEXT("PaasAI.ResetStreamBufferPeak"),
+        TEXT("把流式文本缓冲区总量的峰值重置为当前值"),
+        FConsoleCommandDelegate::CreateStatic(&FDeepSeekMetricsRecorder::ResetPeakActiveStreamBufferBytes));
+}
+
+void FDeepSeekMetricsRecorder::Begin(int64 InRequestBytes)
+{
+    StartTime = FPlatformTime::Seconds();
+    SentTime = StartTime;
+    EndTime = 0.0;
+    QueueWait = 0.0;
+    FirstByteTime = 0.0;
+    FirstTokenTime = 0.0;
+    LastTokenTime = 0.0;
+    TokenChunks = 0;
+    ReportedTokens = 0;
+    PromptTokens = 0;
+    PromptCacheHitTokens = 0;
+    PromptCacheMissTokens = 0;
+    for (std::atomic<int32>& Bucket : LatencyBuckets)
+    {
+        Bucket = 0;
+    }
+    ResponseBytes = 0;
+    ParseCycles = 0;
+    GameThreadCycles = 0;
+    PeakStreamBufferBytes = StreamBufferBytes.load();
+    RequestBytes = InRequestBytes;
+    Retries = 0;
+    bHedged = false;
+    bHedgeWon = false;
+    bConnectionReused = false;
+    bFromCache = false;
+    bFinished = false;
+}
+
+void FDeepSeekMetricsRecorder::MarkSent(double QueueWaitSeconds)
+{
+    SentTime = FPlatformTime::Seconds();
+    QueueWait = QueueWaitSeconds;
+}
+
+void FDeepSeekMetricsRecorder::AddGameThreadCycles(uint64 Cycles)
+{
+    GameThreadCycles += Cycles;
+    DeepSeekMetrics::TotalGameThreadCycles += Cycles;
+}
+
+uint64 FDeepSeekMetricsRecorder::GetTotalGameThreadCycles()
+{
+    return DeepSeekMetrics::TotalGameThreadCycles.load();
+}
+
+void FDeepSeekMetricsRecorder::SetStreamBufferBytes(int64 Bytes)
+{
+    using namespace DeepSeekMetrics;
+
+    // 只统计实际分配的容量，扩容时才会变化
+    const int64 Delta = Bytes - StreamBufferBytes.exchange(Bytes);
+    if (Delta == 0)
+    {
+        return;
+    }
+    RaisePeak(PeakStreamBufferBytes, Bytes);
+
+    const int64 Total = ActiveStreamBufferBytes.fetch_add(Delta) + Delta;
+    if (Delta > 0)
+    {
+        INC_MEMORY_STAT_BY(STAT_PaasAI_StreamBufferMemory, Delta);
+        RaisePeak(PeakActiveStreamBufferBytes, Total);
+        SET_DWORD_STAT(STAT_PaasAI_PeakStreamBufferBytes, static_cast<uint32>(PeakActiveStreamBufferBytes.load()));
+    }
+    else
+    {
+        DEC_MEMORY_STAT_BY(STAT_PaasAI_StreamBufferMemory, -Delta);
+    }
+}
+
+int64 FDeepSeekMetricsRecorder::GetActiveStreamBufferBytes()
+{
+    return DeepSeekMetrics::ActiveStreamBufferBytes.load();
+}
+
+int64 FDeepSeekMetricsRecorder::GetPeakActiveStreamBufferBytes()
+{
+    return DeepSeekMetrics::PeakActiveStreamBufferBytes.load();
+}
+
+void FDeepSeekMetricsRecorder::ResetPeakActiveStreamBufferBytes()
+{
+    using namespace DeepSeekMetrics;
+
+    const int64 Current = ActiveStreamBufferBytes.load();
+    PeakActiveStreamBufferBytes = Current;
+    SET_DWORD_STAT(STAT_PaasAI_PeakStreamBufferBytes, static_cast<uint32>(Current));
+}
+
+void FDeepSeekMetricsRecorder::AddRetry()
+{
+    ++Retries;
+    FirstByteTime = 0.0;
+}
+
+void FDeepSeekMetricsRecorder::MarkFirstByte()
+{
+    double Expected = 0.0;
+    FirstByteTime.compare_exchange_strong(Expected, FPlatformTime::Seconds());
+}
+
+double FDeepSeekMetricsRecorder::GetTimeToFirstByte() const
+{
+    return DeepSeekMetrics::SecondsBetween(SentTime, FirstByteTime);
+}
+
+void FDeepSeekMetricsRecorder::MarkToken()
+{
+    const double Now = FPlatformTime::Seconds();
+    if (TokenChunks++ == 0)
+    {
+        FirstTokenTime = Now;
+    }
+    else
+    {
+        const double GapMs = (Now - LastTokenTime) * 1000.0;
+        int32 Bucket = 0;
+        while (Bucket < NumLatencyBuckets - 1 && GapMs > DeepSeekMetrics::LatencyBucketBoundsMs[Bucket])
+        {
+            ++Bucket;
+        }
+        ++LatencyBuckets[Bucket];
+    }
+    LastTokenTime = Now;
+}
+
+void FDeepSeekMetricsRecorder::Finish(bool bSucceeded)
+{
+    if (bFinished)
+    {
+        return;
+    }
+    EndTime = FPlatformTime::Seconds();
+    bFinished = true;
+
+    if (bSucceeded)
+    {
+        INC_DWORD_STAT(STAT_PaasAI_RequestsSucceeded);
+    }
+    else
+    {
+        INC_DWORD_STAT(STAT_PaasAI_RequestsFailed);
+    }
+
+    // 缓存命中、合并的请求以及连接失败的请求没有收到数据，不计入延迟统计
+    if (bFromCache || FirstByteTime.load() <= 0.0)
+    {
+        return;
+    }
+
+    const FDeepSeekRequestMetrics Metrics = GetSnapshot();
+    const float QueueWaitMs = Metrics.QueueWaitSeconds * 1000.0f;
+    const float FirstByteMs = Metrics.TimeToFirstByteSeconds * 1000.0f;
+    const float FirstTokenMs = Metrics.TimeToFirstTokenSeconds * 1000.0f;
+
+    INC_DWORD_STAT_BY(STAT_PaasAI_BytesSent, Metrics.RequestBytes);
+    INC_DWORD_STAT_BY(STAT_PaasAI_BytesReceived, Metrics.ResponseBytes);
+    SET_FLOAT_STAT(STAT_PaasAI_LastQueueWaitMs, QueueWaitMs);
+    SET_FLOAT_STAT(STAT_PaasAI_LastTimeToFirstByteMs, FirstByteMs);
+    SET_FLOAT_STAT(STAT_PaasAI_LastTimeToFirstTokenMs, FirstTokenMs);
+    SET_FLOAT_STAT(STAT_PaasAI_LastTokensPerSecond, Metrics.TokensPerSecond);
+
+    INC_DWORD_STAT_BY(STAT_PaasAI_PromptCacheHitTokens, Metrics.PromptCacheHitTokens);
+    INC_DWORD_STAT_BY(STAT_PaasAI_PromptCacheMissTokens, Metrics.PromptCacheMissTokens);
+
+    CSV_CUSTOM_STAT(PaasAI, QueueWaitMs, QueueWaitMs, ECsvCustomStatOp::Set);
+    CSV_CUSTOM_STAT(PaasAI, TimeToFirstByteMs, FirstByteMs, ECsvCustomStatOp::Set);
+    CSV_CUSTOM_STAT(PaasAI, TimeToFirstTokenMs, FirstTokenMs, ECsvCustomStatOp::Set);
+    CSV_CUSTOM_STAT(PaasAI, TokensPerSecond, Metrics.TokensPerSecond, ECsvCustomStatOp::Set);
+    CSV_CUSTOM_STAT(PaasAI, ParseMs, Metrics.ParseSeconds * 1000.0f, ECsvCustomStatOp::Accumulate);
+    CSV_CUSTOM_STAT(PaasAI, PeakStreamBufferKB, static_cast<float>(Metrics.PeakStreamBufferBytes) / 1024.0f, ECsvCustomStatOp::Max);
+    CSV_CUSTOM_STAT(PaasAI, Requests, 1, ECsvCustomStatOp::Accumulate);
+    CSV_CUSTOM_STAT(PaasAI, ReusedConnections, Metrics.bConnectionReused ? 1 : 0, ECsvCustomStatOp::Accumulate);
+    CSV_CUSTOM_STAT(PaasAI, PromptCacheHitTokens, Metrics.PromptCacheHitTokens, ECsvCustomStatOp::Accumulate);
+    CSV_CUSTOM_STAT(PaasAI, PromptCacheMissTokens, Metrics.PromptCacheMissTokens, ECsvCustomStatOp::Accumulate);
+
+    TRACE_COUNTER_SET(PaasAI_QueueWait, QueueWaitMs);
+    TRACE_COUNTER_SET(PaasAI_TimeToFirstByte, FirstByteMs);
+    TRACE_COUNTER_SET(PaasAI_TimeToFirstToken, FirstTokenMs);
+    TRACE_COUNTER_SET(PaasAI_TokensPerSecond, Metrics.TokensPerSecond);
+}
+
+FDeepSeekRequestMetrics FDeepSeekMetricsRecorder::GetSnapshot() const
+{
+    using namespace DeepSeekMetrics;
+
+    FDeepSeekRequestMetrics Metrics;
+    const double Now = bFinished ? EndTime : FPlatformTime::Seconds();
+    const double FirstToken = FirstTokenTime;
+
+    Metrics.QueueWaitSeconds = static_cast<float>(QueueWait);
+    Metrics.TimeToFirstByteSeconds = SecondsBetween(SentTime, FirstByteTime);
+    Metrics.TimeToFirstTokenSeconds = SecondsBetween(SentTime, FirstToken);
+    Metrics.TotalSeconds = SecondsBetween(StartTime, Now);
+
+    const int32 Reported = ReportedTokens;
+    Metrics.CompletionTokens = Reported > 0 ? Reported : TokenChunks.load();
+
+    // 生成速度只统计第一段文本之后的时间，不包括排队和首token等待
+    const float GenerationSeconds = SecondsBetween(FirstToken, bFinished ? EndTime : LastTokenTime);
+    if (GenerationSeconds > 0.0f && Metrics.CompletionTokens > 1)
+    {
+        Metrics.TokensPerSecond = (Metrics.CompletionTokens - 1) / GenerationSeconds;
+    }
+
+    Metrics.PromptTokens = PromptTokens;
+    Metrics.PromptCacheHitTokens = PromptCacheHitTokens;
+    Metrics.PromptCacheMissTokens = PromptCacheMissTokens;
+
+    Metrics.RequestBytes = RequestBytes;
+    Metrics.ResponseBytes = ResponseBytes;
+    Metrics.PeakStreamBufferBytes = PeakStreamBufferBytes;
+    Metrics.ParseSeconds = static_cast<float>(FPlatformTime::ToSeconds64(ParseCycles));
+    Metrics.GameThreadSeconds = static_cast<float>(FPlatformTime::ToSeconds64(GameThreadCycles));
+
+    Metrics.InterTokenLatencyHistogram.SetNumUninitialized(NumLatencyBuckets);
+    for (int32 Index = 0; Index < NumLatencyBuckets; ++Index)
+    {
+        Metrics.InterTokenLatencyHistogram[Index] = LatencyBuckets[Index];
+    }
+
+    Metrics.Retries = Retries;
+    Metrics.bHedged = bHedged;
+    Metrics.bHedgeWon = bHedgeWon;
+    Metrics.bConnectionReused = bConnectionReused;
+    Metrics.bFromCache = bFromCache;
+    Metrics.bFinished = bFinished;
+    return Metrics;
+}
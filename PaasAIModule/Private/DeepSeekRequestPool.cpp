@@ -0,0 +1,102 @@
+﻿// DeepSeekRequestPool.cpp
+#include "DeepSeekRequestPool.h"
+#include "AIFunction.h"
+#include "PaasAIStats.h"
+
+FDeepSeekRequestPool::FDeepSeekRequestPool()
+{
+    RecycleTicker = FTSTicker::GetCoreTicker().AddTicker(
+        FTickerDelegate::CreateRaw(this, &FDeepSeekRequestPool::RecyclePending));
+}
+
+FDeepSeekRequestPool::~FDeepSeekRequestPool()
+{
+    FTSTicker::GetCoreTicker().RemoveTicker(RecycleTicker);
+}
+
+UDeepSeekFunction* FDeepSeekRequestPool::Acquire()
+{
+    check(IsInGameThread());
+    
+    if (FreeRequests.Num() > 0)
+    {
+        INC_DWORD_STAT(STAT_PaasAI_RequestPoolHits);
+        UDeepSeekFunction* Request = FreeRequests.Pop();
+        UpdateStats();
+        return Request;
+    }
+    
+    INC_DWORD_STAT(STAT_PaasAI_RequestPoolMisses);
+    return NewObject<UDeepSeekFunction>();
+}
+
+void FDeepSeekRequestPool::MarkActive(UDeepSeekFunction* Request)
+{
+    check(IsInGameThread());
+    
+    ActiveRequests.AddUnique(Request);
+    UpdateStats();
+}
+
+void FDeepSeekRequestPool::Release(UDeepSeekFunction* Request)
+{
+    check(IsInGameThread());
+    
+    if (ActiveRequests.RemoveSingleSwap(Request) == 0)
+    {
+        return;
+    }
+    
+    // 本帧内OnCompleted的监听者可能还在读取结果，下一帧再回收；
+    // 指针可能被外部保存的对象不回收，交给垃圾回收
+    if (MaxPooled > 0 && Request->bRecyclable)
+    {
+        PendingRecycle.Add(Request);
+    }
+    UpdateStats();
+}
+
+void FDeepSeekRequestPool::SetMaxPooled(int32 InMaxPooled)
+{
+    MaxPooled = FMath::Max(0, InMaxPooled);
+    if (FreeRequests.Num() > MaxPooled)
+    {
+        FreeRequests.SetNum(MaxPooled);
+    }
+}
+
+void FDeepSeekRequestPool::AddReferencedObjects(FReferenceCollector& Collector)
+{
+    Collector.AddReferencedObjects(ActiveRequests);
+    Collector.AddReferencedObjects(PendingRecycle);
+    Collector.AddReferencedObjects(FreeRequests);
+}
+
+FString FDeepSeekRequestPool::GetReferencerName() const
+{
+    return TEXT("FDeepSeekRequestPool");
+}
+
+bool FDeepSeekRequestPool::RecyclePending(float DeltaTime)
+{
+    for (UDeepSeekFunction* Request : PendingRecycle)
+    {
+        // 被重新激活或已满时不放回
+        if (Request == nullptr || ActiveRequests.Contains(Request) || FreeRequests.Num() >= MaxPooled)
+        {
+            continue;
+        }
+        
+        Request->ResetForReuse();
+        FreeRequests.Add(Request);
+    }
+    PendingRecycle.Reset();
+    UpdateStats();
+    return true;
+}
+
+void FDeepSeekRequestPool::UpdateStats() const
+{
+    SET_DWORD_STAT(STAT_PaasAI_LiveRequests, ActiveRequests.Num());
+    SET_DWORD_STAT(STAT_PaasAI_PooledRequests, FreeRequests.Num());
+}
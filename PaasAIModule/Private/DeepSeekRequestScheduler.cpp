@@ -0,0 +1,287 @@
+﻿// DeepSeekRequestScheduler.cpp
+#include "DeepSeekRequestScheduler.h"
+
+FDeepSeekRequestScheduler::~FDeepSeekRequestScheduler()
+{
+    if (WakeupHandle.IsValid())
+    {
+        FTSTicker::GetCoreTicker().RemoveTicker(WakeupHandle);
+    }
+}
+
+void FDeepSeekRequestScheduler::Submit(FHandle& OutHandle, const FString& EndpointKey, EDeepSeekRequestPriority Priority, int32 EstimatedTokens, FStartRequest&& StartRequest)
+{
+    TArray<FReadyRequest> Ready;
+    {
+        FScopeLock ScopeLock(&Lock);
+        
+        const FHandle Handle = NextHandle++;
+        OutHandle = Handle;
+        
+        FQueuedRequest& Queued = Lanes[static_cast<int32>(Priority)].AddDefaulted_GetRef();
+        Queued.Handle = Handle;
+        Queued.EndpointKey = EndpointKey;
+        Queued.StartRequest = MoveTemp(StartRequest);
+        Queued.EnqueueTime = FPlatformTime::Seconds();
+        Queued.EstimatedTokens = EstimatedTokens;
+        
+        FDeepSeekSchedulerLaneStats& Stats = LaneStats[static_cast<int32>(Priority)];
+        ++Stats.Submitted;
+        ++Stats.Queued;
+        
+        CollectReadyRequests(Ready);
+    }
+    
+    for (FReadyRequest& Request : Ready)
+    {
+        Request.StartRequest(Request.QueueWaitSeconds);
+    }
+}
+
+void FDeepSeekRequestScheduler::Finish(FHandle Handle)
+{
+    if (Handle == InvalidHandle)
+    {
+        return;
+    }
+    
+    TArray<FReadyRequest> Ready;
+    {
+        FScopeLock ScopeLock(&Lock);
+        
+        FActiveRequest Active;
+        if (ActiveRequests.RemoveAndCopyValue(Handle, Active))
+        {
+            int32& InFlight = InFlightPerEndpoint.FindOrAdd(Active.EndpointKey);
+            if (--InFlight <= 0)
+            {
+                InFlightPerEndpoint.Remove(Active.EndpointKey);
+            }
+            
+            FDeepSeekSchedulerLaneStats& Stats = LaneStats[static_cast<int32>(Active.Priority)];
+            --Stats.InFlight;
+            ++Stats.Finished;
+        }
+        else
+        {
+            // 还没发出就被中止
+            for (int32 LaneIndex = 0; LaneIndex < NumLanes; ++LaneIndex)
+            {
+                const int32 QueueIndex = Lanes[LaneIndex].IndexOfByPredicate([Handle](const FQueuedRequest& Queued) { return Queued.Handle == Handle; });
+                if (QueueIndex != INDEX_NONE)
+                {
+                    Lanes[LaneIndex].RemoveAt(QueueIndex);
+                    --LaneStats[LaneIndex].Queued;
+                    ++LaneStats[LaneIndex].Cancelled;
+                    break;
+                }
+            }
+        }
+        
+        CollectReadyRequests(Ready);
+    }
+    
+    for (FReadyRequest& Request : Ready)
+    {
+        Request.StartRequest(Request.QueueWaitSeconds);
+    }
+}
+
+void FDeepSeekRequestScheduler::Pump()
+{
+    TArray<FReadyRequest> Ready;
+    {
+        FScopeLock ScopeLock(&Lock);
+        CollectReadyRequests(Ready);
+    }
+    
+    for (FReadyRequest& Request : Ready)
+    {
+        Request.StartRequest(Request.QueueWaitSeconds);
+    }
+}
+
+void FDeepSeekRequestScheduler::SetMaxInFlightPerEndpoint(int32 MaxInFlight)
+{
+    TArray<FReadyRequest> Ready;
+    {
+        FScopeLock ScopeLock(&Lock);
+        MaxInFlightPerEndpoint = FMath::Max(1, MaxInFlight);
+        CollectReadyRequests(Ready);
+    }
+    
+    for (FReadyRequest& Request : Ready)
+    {
+        Request.StartRequest(Request.QueueWaitSeconds);
+    }
+}
+
+void FDeepSeekRequestScheduler::SetEndpointLimit(const FString& EndpointKey, int32 MaxInFlight)
+{
+    TArray<FReadyRequest> Ready;
+    {
+        FScopeLock ScopeLock(&Lock);
+        if (MaxInFlight > 0)
+        {
+            EndpointLimits.Add(EndpointKey, MaxInFlight);
+        }
+        else
+        {
+            EndpointLimits.Remove(EndpointKey);
+        }
+        CollectReadyRequests(Ready);
+    }
+    
+    for (FReadyRequest& Request : Ready)
+    {
+        Request.StartRequest(Request.QueueWaitSeconds);
+    }
+}
+
+void FDeepSeekRequestScheduler::SetBackgroundShare(int32 PlayerRequestsPerBackground)
+{
+    FScopeLock ScopeLock(&Lock);
+    BackgroundShare = FMath::Max(0, PlayerRequestsPerBackground);
+}
+
+FDeepSeekSchedulerLaneStats FDeepSeekRequestScheduler::GetLaneStats(EDeepSeekRequestPriority Priority) const
+{
+    FScopeLock ScopeLock(&Lock);
+    return LaneStats[static_cast<int32>(Priority)];
+}
+
+FString FDeepSeekRequestScheduler::MakeEndpointKey(const FString& URL, const FString& APIKey)
+{
+    return FString::Printf(TEXT("%s#%08x"), *URL, GetTypeHash(APIKey));
+}
+
+void FDeepSeekRequestScheduler::CollectReadyRequests(TArray<FReadyRequest>& OutReady)
+{
+    const double Now = FPlatformTime::Seconds();
+    PendingRateLimitWait = 0.0;
+    const int32 BackgroundLane = static_cast<int32>(EDeepSeekRequestPriority::Background);
+    
+    for (;;)
+    {
+        // 后台请求已经让出足够多次时先放行一个，避免被饿死
+        const bool bBackgroundTurn = BackgroundShare > 0
+            && PlayerDispatchesSinceBackground >= BackgroundShare
+            && Lanes[BackgroundLane].Num() > 0;
+        
+        if (bBackgroundTurn && TryDispatchFromLane(EDeepSeekRequestPriority::Background, Now, OutReady))
+        {
+            PlayerDispatchesSinceBackground = 0;
+            continue;
+        }
+        
+        if (TryDispatchFromLane(EDeepSeekRequestPriority::PlayerFacing, Now, OutReady))
+        {
+            if (Lanes[BackgroundLane].Num() > 0)
+            {
+                ++PlayerDispatchesSinceBackground;
+            }
+            continue;
+        }
+        
+        if (TryDispatchFromLane(EDeepSeekRequestPriority::Background, Now, OutReady))
+        {
+            PlayerDispatchesSinceBackground = 0;
+            continue;
+        }
+        
+        break;
+    }
+    
+    // 有请求因限流被推迟，到期后再调度一次
+    if (PendingRateLimitWait > 0.0)
+    {
+        ScheduleWakeup(PendingRateLimitWait);
+    }
+}
+
+bool FDeepSeekRequestScheduler::TryDispatchFromLane(EDeepSeekRequestPriority Priority, double Now, TArray<FReadyRequest>& OutReady)
+{
+    const int32 LaneIndex = static_cast<int32>(Priority);
+    TArray<FQueuedRequest>& Lane = Lanes[LaneIndex];
+    
+    // 按FIFO顺序找第一个端点还有名额的请求，已满或被限流的端点不会阻塞其他端点；
+    // 同一端点token预算不足时，预算内的较小请求可以先发出
+    for (int32 QueueIndex = 0; QueueIndex < Lane.Num(); ++QueueIndex)
+    {
+        FQueuedRequest& Queued = Lane[QueueIndex];
+        if (!HasCapacity(Queued.EndpointKey))
+        {
+            continue;
+        }
+        
+        const double RateLimitWait = RateLimiter.TryAcquire(Queued.EndpointKey, Queued.EstimatedTokens, Now);
+        if (RateLimitWait > 0.0)
+        {
+            PendingRateLimitWait = PendingRateLimitWait > 0.0 ? FMath::Min(PendingRateLimitWait, RateLimitWait) : RateLimitWait;
+            continue;
+        }
+        
+        ++InFlightPerEndpoint.FindOrAdd(Queued.EndpointKey);
+        
+        FActiveRequest& Active = ActiveRequests.Add(Queued.Handle);
+        Active.EndpointKey = Queued.EndpointKey;
+        Active.Priority = Priority;
+        
+        const double QueueWait = Now - Queued.EnqueueTime;
+        FDeepSeekSchedulerLaneStats& Stats = LaneStats[LaneIndex];
+        --Stats.Queued;
+        ++Stats.InFlight;
+        ++Stats.Dispatched;
+        Stats.TotalQueueWaitSeconds += QueueWait;
+        Stats.MaxQueueWaitSeconds = FMath::Max(Stats.MaxQueueWaitSeconds, QueueWait);
+        
+        FReadyRequest& Ready = OutReady.AddDefaulted_GetRef();
+        Ready.StartRequest = MoveTemp(Queued.StartRequest);
+        Ready.QueueWaitSeconds = QueueWait;
+        
+        Lane.RemoveAt(QueueIndex);
+        return true;
+    }
+    return false;
+}
+
+bool FDeepSeekRequestScheduler::HasCapacity(const FString& EndpointKey) const
+{
+    const int32* InFlight = InFlightPerEndpoint.Find(EndpointKey);
+    return (InFlight ? *InFlight : 0) < GetEndpointLimit(EndpointKey);
+}
+
+void FDeepSeekRequestScheduler::ScheduleWakeup(double DelaySeconds)
+{
+    const double Target = FPlatformTime::Seconds() + DelaySeconds;
+    if (WakeupHandle.IsValid())
+    {
+        if (WakeupTime <= Target)
+        {
+            return;
+        }
+        FTSTicker::GetCoreTicker().RemoveTicker(WakeupHandle);
+    }
+    
+    WakeupTime = Target;
+    WakeupHandle = FTSTicker::GetCoreTicker().AddTicker(
+        FTickerDelegate::CreateRaw(this, &FDeepSeekRequestScheduler::HandleWakeup), static_cast<float>(DelaySeconds));
+}
+
+bool FDeepSeekRequestScheduler::HandleWakeup(float DeltaTime)
+{
+    {
+        FScopeLock ScopeLock(&Lock);
+        WakeupHandle.Reset();
+    }
+    Pump();
+    
+    // 只触发一次
+    return false;
+}
+
+int32 FDeepSeekRequestScheduler::GetEndpointLimit(const FString& EndpointKey) const
+{
+    const int32* Limit = EndpointLimits.Find(EndpointKey);
+    return Limit ? *Limit : MaxInFlightPerEndpoint;
+}
@@ -0,0 +1,305 @@
+﻿// DeepSeekRequestWriter.cpp
+#include "DeepSeekRequestWriter.h"
+#include "AIFunction.h"
+
+namespace DeepSeekRequestWriter
+{
+    static const ANSICHAR HexDigits[] = "0123456789abcdef";
+
+    // 读取一个码点，处理UTF-16代理对
+    static FORCEINLINE uint32 ReadCodepoint(const TCHAR*& Current, const TCHAR* End)
+    {
+        uint32 Codepoint = static_cast<uint32>(*Current++);
+        if (Codepoint >= 0xD800 && Codepoint <= 0xDBFF && Current < End)
+        {
+            const uint32 Low = static_cast<uint32>(*Current);
+            if (Low >= 0xDC00 && Low <= 0xDFFF)
+            {
+                ++Current;
+                Codepoint = 0x10000 + ((Codepoint - 0xD800) << 10) + (Low - 0xDC00);
+            }
+        }
+        return Codepoint;
+    }
+
+    static FORCEINLINE int32 EncodedLength(uint32 Codepoint)
+    {
+        switch (Codepoint)
+        {
+        case '"': case '\\': case '\n': case '\r': case '\t': case '\b': case '\f':
+            return 2;
+        default:
+            break;
+        }
+
+        if (Codepoint < 0x20) return 6;
+        if (Codepoint < 0x80) return 1;
+        if (Codepoint < 0x800) return 2;
+        if (Codepoint < 0x10000) return 3;
+        return 4;
+    }
+
+    static FORCEINLINE uint8* EncodeCodepoint(uint32 Codepoint, uint8* Dest)
+    {
+        switch (Codepoint)
+        {
+        case '"':  *Dest++ = '\\'; *Dest++ = '"';  return Dest;
+        case '\\': *Dest++ = '\\'; *Dest++ = '\\'; return Dest;
+        case '\n': *Dest++ = '\\'; *Dest++ = 'n';  return Dest;
+        case '\r': *Dest++ = '\\'; *Dest++ = 'r';  return Dest;
+        case '\t': *Dest++ = '\\'; *Dest++ = 't';  return Dest;
+        case '\b': *Dest++ = '\\'; *Dest++ = 'b';  return Dest;
+        case '\f': *Dest++ = '\\'; *Dest++ = 'f';  return Dest;
+        default:
+            break;
+        }
+
+        if (Codepoint < 0x20)
+        {
+            *Dest++ = '\\'; *Dest++ = 'u'; *Dest++ = '0'; *Dest++ = '0';
+            *Dest++ = HexDigits[Codepoint >> 4];
+            *Dest++ = HexDigits[Codepoint & 0xF];
+        }
+        else if (Codepoint < 0x80)
+        {
+            *Dest++ = static_cast<uint8>(Codepoint);
+        }
+        else if (Codepoint < 0x800)
+        {
+            *Dest++ = static_cast<uint8>(0xC0 | (Codepoint >> 6));
+            *Dest++ = static_cast<uint8>(0x80 | (Codepoint & 0x3F));
+        }
+        else if (Codepoint < 0x10000)
+        {
+            *Dest++ = static_cast<uint8>(0xE0 | (Codepoint >> 12));
+            *Dest++ = static_cast<uint8>(0x80 | ((Codepoint >> 6) & 0x3F));
+            *Dest++ = static_cast<uint8>(0x80 | (Codepoint & 0x3F));
+        }
+        else
+        {
+            *Dest++ = static_cast<uint8>(0xF0 | (Codepoint >> 18));
+            *Dest++ = static_cast<uint8>(0x80 | ((Codepoint >> 12) & 0x3F));
+            *Dest++ = static_cast<uint8>(0x80 | ((Codepoint >> 6) & 0x3F));
+            *Dest++ = static_cast<uint8>(0x80 | (Codepoint & 0x3F));
+        }
+        return Dest;
+    }
+}
+
+int32 FDeepSeekRequestWriter::WriteRequestBody(const FDeepSeekRequestParams& Params, TArray<uint8>& OutBody)
+{
+    OutBody.Reset();
+    if (Params.EncodedMessages.IsValid())
+    {
+        OutBody.Reserve(Params.EncodedMessages->Num() + Params.Model.Len() + 128);
+    }
+
+    AppendLiteral(OutBody, "{\"model\":");
+    AppendString(OutBody, Params.Model);
+
+    AppendLiteral(OutBody, ",\"messages\":[");
+    if (Params.EncodedMessages.IsValid())
+    {
+        // 调用方已缓存编码结果，直接拼接
+        OutBody.Append(*Params.EncodedMessages);
+    }
+    else
+    {
+        for (int32 Index = 0; Index < Params.Messages.Num(); ++Index)
+        {
+            if (Index > 0)
+            {
+                AppendLiteral(OutBody, ",");
+            }
+            AppendMessage(OutBody, Params.Messages[Index]);
+        }
+    }
+    AppendLiteral(OutBody, "]");
+
+    AppendLiteral(OutBody, ",\"temperature\":");
+    AppendFloat(OutBody, FMath::Clamp(Params.Temperature, 0.0f, 1.0f));
+    AppendLiteral(OutBody, ",\"max_tokens\":");
+    AppendInteger(OutBody, FMath::Max(1, Params.MaxTokens));
+    // 停止字符串同时交给服务端，服务端停止生成后不再产生多余的token
+    bool bHasStop = false;
+    for (const FString& StopString : Params.StopStrings)
+    {
+        if (StopString.IsEmpty())
+        {
+            continue;
+        }
+        AppendLiteral(OutBody, bHasStop ? "," : ",\"stop\":[");
+        AppendString(OutBody, StopString);
+        bHasStop = true;
+    }
+    if (bHasStop)
+    {
+        AppendLiteral(OutBody, "]");
+    }
+    AppendTools(OutBody, Params);
+    if (Params.ResponseFormat == EDeepSeekResponseFormat::JsonObject)
+    {
+        AppendLiteral(OutBody, ",\"response_format\":{\"type\":\"json_object\"}");
+    }
+
+    // 以下为传输相关字段，不计入规范化部分
+    const int32 CanonicalLength = OutBody.Num();
+    AppendLiteral(OutBody, ",\"stream\":");
+    AppendBool(OutBody, Params.bStream);
+    AppendLiteral(OutBody, "}");
+    return CanonicalLength;
+}
+
+void FDeepSeekRequestWriter::AppendMessage(TArray<uint8>& Out, const FDeepSeekMessage& Message)
+{
+    AppendLiteral(Out, "{\"role\":");
+    AppendString(Out, Message.Role);
+    AppendLiteral(Out, ",\"content\":");
+    AppendString(Out, Message.Content);
+
+    for (int32 Index = 0; Index < Message.ToolCalls.Num(); ++Index)
+    {
+        const FDeepSeekToolCall& ToolCall = Message.ToolCalls[Index];
+        AppendLiteral(Out, Index == 0 ? ",\"tool_calls\":[{\"id\":" : ",{\"id\":");
+        AppendString(Out, ToolCall.Id);
+        AppendLiteral(Out, ",\"type\":\"function\",\"function\":{\"name\":");
+        AppendString(Out, ToolCall.Name);
+        AppendLiteral(Out, ",\"arguments\":");
+        AppendString(Out, ToolCall.Arguments);
+        AppendLiteral(Out, "}}");
+    }
+    if (Message.ToolCalls.Num() > 0)
+    {
+        AppendLiteral(Out, "]");
+    }
+
+    if (!Message.ToolCallId.IsEmpty())
+    {
+        AppendLiteral(Out, ",\"tool_call_id\":");
+        AppendString(Out, Message.ToolCallId);
+    }
+    AppendLiteral(Out, "}");
+}
+
+void FDeepSeekRequestWriter::AppendTools(TArray<uint8>& Out, const FDeepSeekRequestParams& Params)
+{
+    if (Params.Tools.Num() == 0)
+    {
+        return;
+    }
+
+    for (int32 Index = 0; Index < Params.Tools.Num(); ++Index)
+    {
+        const FDeepSeekToolDefinition& Tool = Params.Tools[Index];
+        AppendLiteral(Out, Index == 0 ? ",\"tools\":[" : ",");
+        AppendLiteral(Out, "{\"type\":\"function\",\"function\":{\"name\":");
+        AppendString(Out, Tool.Name);
+        if (!Tool.Description.IsEmpty())
+        {
+            AppendLiteral(Out, ",\"description\":");
+            AppendString(Out, Tool.Description);
+        }
+        AppendLiteral(Out, ",\"parameters\":");
+        const FStringView Schema = FStringView(Tool.ParametersSchema).TrimStartAndEnd();
+        if (Schema.IsEmpty())
+        {
+            AppendLiteral(Out, "{\"type\":\"object\",\"properties\":{}}");
+        }
+        else
+        {
+            AppendRawJson(Out, Schema);
+        }
+        AppendLiteral(Out, "}}");
+    }
+    AppendLiteral(Out, "]");
+
+    // auto/none/required之外的值视为要强制调用的函数名
+    if (!Params.ToolChoice.IsEmpty())
+    {
+        AppendLiteral(Out, ",\"tool_choice\":");
+        if (Params.ToolChoice == TEXT("auto") || Params.ToolChoice == TEXT("none") || Params.ToolChoice == TEXT("required"))
+        {
+            AppendString(Out, Params.ToolChoice);
+        }
+        else
+        {
+            AppendLiteral(Out, "{\"type\":\"function\",\"function\":{\"name\":");
+            AppendString(Out, Params.ToolChoice);
+            AppendLiteral(Out, "}}");
+        }
+    }
+}
+
+void FDeepSeekRequestWriter::AppendString(TArray<uint8>& Out, FStringView Value)
+{
+    const TCHAR* const Begin = Value.GetData();
+    const TCHAR* const End = Begin + Value.Len();
+
+    // 第一遍只计算编码后的长度，保证只扩容一次
+    int32 EncodedLength = 2;
+    for (const TCHAR* Current = Begin; Current < End;)
+    {
+        EncodedLength += DeepSeekRequestWriter::EncodedLength(DeepSeekRequestWriter::ReadCodepoint(Current, End));
+    }
+
+    const int32 Offset = Out.AddUninitialized(EncodedLength);
+    uint8* Dest = Out.GetData() + Offset;
+
+    *Dest++ = '"';
+    for (const TCHAR* Current = Begin; Current < End;)
+    {
+        Dest = DeepSeekRequestWriter::EncodeCodepoint(DeepSeekRequestWriter::ReadCodepoint(Current, End), Dest);
+    }
+    *Dest++ = '"';
+
+    check(Dest == Out.GetData() + Out.Num());
+}
+
+void FDeepSeekRequestWriter::AppendRawJson(TArray<uint8>& Out, FStringView Json)
+{
+    const FTCHARToUTF8 Utf8(Json.GetData(), Json.Len());
+    Out.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+}
+
+void FDeepSeekRequestWriter::AppendLiteral(TArray<uint8>& Out, const ANSICHAR* Literal)
+{
+    Out.Append(reinterpret_cast<const uint8*>(Literal), FCStringAnsi::Strlen(Literal));
+}
+
+void FDeepSeekRequestWriter::AppendInteger(TArray<uint8>& Out, int64 Value)
+{
+    ANSICHAR Buffer[32];
+    const int32 Length = FCStringAnsi::Snprintf(Buffer, UE_ARRAY_COUNT(Buffer), "%lld", static_cast<long long>(Value));
+    Out.Append(reinterpret_cast<const uint8*>(Buffer), FMath::Clamp(Length, 0, static_cast<int32>(UE_ARRAY_COUNT(Buffer)) - 1));
+}
+
+void FDeepSeekRequestWriter::AppendFloat(TArray<uint8>& Out, float Value)
+{
+    // 手动格式化，避免printf受本地化小数点影响
+    int64 Scaled = FMath::RoundToInt64(static_cast<double>(Value) * 1000.0);
+    if (Scaled < 0)
+    {
+        AppendLiteral(Out, "-");
+        Scaled = -Scaled;
+    }
+
+    AppendInteger(Out, Scaled / 1000);
+
+    int64 Fraction = Scaled % 1000;
+    if (Fraction != 0)
+    {
+        ANSICHAR Digits[4] = { '.', 0, 0, 0 };
+        int32 Length = 1;
+        for (int64 Divisor = 100; Divisor > 0 && Fraction != 0; Divisor /= 10)
+        {
+            Digits[Length++] = static_cast<ANSICHAR>('0' + Fraction / Divisor);
+            Fraction %= Divisor;
+        }
+        Out.Append(reinterpret_cast<const uint8*>(Digits), Length);
+    }
+}
+
+void FDeepSeekRequestWriter::AppendBool(TArray<uint8>& Out, bool bValue)
+{
+    AppendLiteral(Out, bValue ? "true" : "false");
+}
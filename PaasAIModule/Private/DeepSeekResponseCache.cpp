@@ -0,0 +1,276 @@
+﻿// DeepSeekResponseCache.cpp
+#include "DeepSeekResponseCache.h"
+#include "Async/Async.h"
+#include "Async/MappedFileHandle.h"
+#include "Hash/CityHash.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Guid.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+
+namespace DeepSeekResponseCache
+{
+    static const TCHAR* FileExtension = TEXT(".txt");
+}
+
+FDeepSeekResponseCache::~FDeepSeekResponseCache()
+{
+    Clear();
+}
+
+bool FDeepSeekResponseCache::Find(uint64 Key, FString& OutResponse)
+{
+    FScopeLock ScopeLock(&Lock);
+    
+    if (FEntryNode** Found = EntriesByKey.Find(Key))
+    {
+        // 移到链表头部
+        FEntryNode* Node = *Found;
+        Entries.RemoveNode(Node, false);
+        Entries.AddHead(Node);
+        
+        OutResponse = Node->GetValue().Response;
+        return true;
+    }
+    return false;
+}
+
+FString FDeepSeekResponseCache::FindOnDisk(uint64 Key) const
+{
+    FScopeLock ScopeLock(&Lock);
+    return DiskEntries.Contains(Key) ? GetDiskPath(Key) : FString();
+}
+
+void FDeepSeekResponseCache::Promote(uint64 Key, const FString& Response)
+{
+    FScopeLock ScopeLock(&Lock);
+    AddToMemory(Key, Response);
+}
+
+void FDeepSeekResponseCache::Add(uint64 Key, const FString& Response)
+{
+    FScopeLock ScopeLock(&Lock);
+    
+    AddToMemory(Key, Response);
+    
+    // 同一个键已经写过时保留已有的文件
+    if (DiskDirectory.IsEmpty() || DiskEntries.Contains(Key))
+    {
+        return;
+    }
+    
+    // 超过整个磁盘上限的回答不写盘
+    const int64 FileBytes = FTCHARToUTF8_Convert::ConvertedLength(*Response, Response.Len());
+    if (DiskBudget <= 0 || FileBytes <= DiskBudget)
+    {
+        DiskEntries.Add(Key, FileBytes);
+        DiskOrder.Add(Key);
+        DiskBytes += FileBytes;
+        EvictDisk();
+        
+        // 写盘放到后台线程，不阻塞游戏线程；先写入临时文件再移动到最终路径，
+        // 同时进行的查找不会读到只写了一半的回答
+        Async(EAsyncExecution::ThreadPool, [Path = GetDiskPath(Key), Response]()
+        {
+            const FString TempPath = FString::Printf(TEXT("%s.%s.tmp"), *Path, *FGuid::NewGuid().ToString());
+            IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+            if (!FFileHelper::SaveStringToFile(Response, *TempPath, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+            {
+                PlatformFile.DeleteFile(*TempPath);
+                return;
+            }
+            
+            if (!PlatformFile.MoveFile(*Path, *TempPath))
+            {
+                PlatformFile.DeleteFile(*TempPath);
+            }
+        });
+    }
+}
+
+void FDeepSeekResponseCache::SetMemoryBudget(int64 Bytes)
+{
+    FScopeLock ScopeLock(&Lock);
+    MemoryBudget = FMath::Max<int64>(0, Bytes);
+    Evict();
+}
+
+void FDeepSeekResponseCache::SetDiskBudget(int64 Bytes)
+{
+    FScopeLock ScopeLock(&Lock);
+    DiskBudget = FMath::Max<int64>(0, Bytes);
+    EvictDisk();
+}
+
+void FDeepSeekResponseCache::SetDiskDirectory(const FString& Directory)
+{
+    FScopeLock ScopeLock(&Lock);
+    DiskDirectory = Directory;
+    DiskEntries.Reset();
+    DiskOrder.Reset();
+    DiskBytes = 0;
+    if (DiskDirectory.IsEmpty())
+    {
+        return;
+    }
+    
+    IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+    PlatformFile.CreateDirectoryTree(*DiskDirectory);
+    
+    // 启动时扫描一次目录，之后只维护内存中的键集合；上次退出时残留的临时文件直接删除
+    struct FFoundFile
+    {
+        uint64 Key;
+        int64 Bytes;
+        FDateTime ModificationTime;
+    };
+    TArray<FFoundFile> FoundFiles;
+    TArray<FString> StaleFiles;
+    PlatformFile.IterateDirectoryStat(*DiskDirectory,
+        [&FoundFiles, &StaleFiles](const TCHAR* FilenameOrDirectory, const FFileStatData& StatData)
+        {
+            if (StatData.bIsDirectory)
+            {
+                return true;
+            }
+            
+            const FString Filename = FPaths::GetCleanFilename(FilenameOrDirectory);
+            const FString BaseName = FPaths::GetBaseFilename(Filename);
+            if (!Filename.EndsWith(DeepSeekResponseCache::FileExtension) || BaseName.Len() != 16)
+            {
+                if (Filename.EndsWith(TEXT(".tmp")))
+                {
+                    StaleFiles.Add(FilenameOrDirectory);
+                }
+                return true;
+            }
+            
+            FoundFiles.Add({ FParse::HexNumber64(*BaseName), StatData.FileSize, StatData.ModificationTime });
+            return true;
+        });
+    
+    for (const FString& StaleFile : StaleFiles)
+    {
+        PlatformFile.DeleteFile(*StaleFile);
+    }
+    
+    FoundFiles.Sort([](const FFoundFile& A, const FFoundFile& B) { return A.ModificationTime < B.ModificationTime; });
+    for (const FFoundFile& File : FoundFiles)
+    {
+        DiskEntries.Add(File.Key, File.Bytes);
+        DiskOrder.Add(File.Key);
+        DiskBytes += File.Bytes;
+    }
+    EvictDisk();
+}
+
+void FDeepSeekResponseCache::Clear()
+{
+    FScopeLock ScopeLock(&Lock);
+    Entries.Empty();
+    EntriesByKey.Empty();
+    MemoryBytes = 0;
+}
+
+uint64 FDeepSeekResponseCache::MakeKey(const FString& URL, TConstArrayView<uint8> CanonicalBody)
+{
+    const uint64 URLHash = CityHash64(reinterpret_cast<const char*>(*URL), URL.Len() * sizeof(TCHAR));
+    return CityHash64WithSeed(reinterpret_cast<const char*>(CanonicalBody.GetData()), CanonicalBody.Num(), URLHash);
+}
+
+void FDeepSeekResponseCache::AddToMemory(uint64 Key, const FString& Response)
+{
+    const int64 Bytes = Response.GetAllocatedSize() + sizeof(FEntry);
+    if (Bytes > MemoryBudget)
+    {
+        return;
+    }
+    
+    if (FEntryNode** Found = EntriesByKey.Find(Key))
+    {
+        MemoryBytes -= (*Found)->GetValue().Bytes;
+        Entries.RemoveNode(*Found);
+        EntriesByKey.Remove(Key);
+    }
+    
+    FEntry Entry;
+    Entry.Key = Key;
+    Entry.Response = Response;
+    Entry.Bytes = Bytes;
+    Entries.AddHead(MoveTemp(Entry));
+    EntriesByKey.Add(Key, Entries.GetHead());
+    MemoryBytes += Bytes;
+    
+    Evict();
+}
+
+void FDeepSeekResponseCache::Evict()
+{
+    // 从最久未使用的一端淘汰，直到低于上限
+    while (MemoryBytes > MemoryBudget && Entries.GetTail() != nullptr)
+    {
+        FEntryNode* Tail = Entries.GetTail();
+        MemoryBytes -= Tail->GetValue().Bytes;
+        EntriesByKey.Remove(Tail->GetValue().Key);
+        Entries.RemoveNode(Tail);
+    }
+}
+
+void FDeepSeekResponseCache::EvictDisk()
+{
+    if (DiskBudget <= 0 || DiskBytes <= DiskBudget)
+    {
+        return;
+    }
+    
+    // 从最早写入的一端删除，直到低于上限；删除放到后台线程，正在读取的请求读不到时会重新发出
+    TArray<FString> Paths;
+    int32 NumEvicted = 0;
+    while (DiskBytes > DiskBudget && NumEvicted < DiskOrder.Num())
+    {
+        const uint64 Key = DiskOrder[NumEvicted++];
+        int64 Bytes = 0;
+        if (DiskEntries.RemoveAndCopyValue(Key, Bytes))
+        {
+            DiskBytes -= Bytes;
+            Paths.Add(GetDiskPath(Key));
+        }
+    }
+    DiskOrder.RemoveAt(0, NumEvicted);
+    
+    Async(EAsyncExecution::ThreadPool, [Paths = MoveTemp(Paths)]()
+    {
+        IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+        for (const FString& Path : Paths)
+        {
+            PlatformFile.DeleteFile(*Path);
+        }
+    });
+}
+
+bool FDeepSeekResponseCache::LoadFromDisk(const FString& Path, FString& OutResponse)
+{
+    IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+    
+    // 内存映射读取，避免额外的读缓冲
+    TUniquePtr<IMappedFileHandle> MappedFile(PlatformFile.OpenMapped(*Path));
+    if (MappedFile.IsValid() && MappedFile->GetFileSize() > 0)
+    {
+        TUniquePtr<IMappedFileRegion> Region(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+        if (Region.IsValid())
+        {
+            FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Region->GetMappedPtr()), static_cast<int32>(Region->GetMappedSize()));
+            OutResponse = FString(Converted.Length(), Converted.Get());
+            return true;
+        }
+    }
+    
+    // 平台不支持内存映射时直接读取，文件不存在时返回false
+    return FFileHelper::LoadFileToString(OutResponse, *Path);
+}
+
+FString FDeepSeekResponseCache::GetDiskPath(uint64 Key) const
+{
+    return FPaths::Combine(DiskDirectory, FString::Printf(TEXT("%016llx%s"), Key, DeepSeekResponseCache::FileExtension));
+}
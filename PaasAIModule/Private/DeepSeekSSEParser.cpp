@@ -0,0 +1,142 @@
+﻿// DeepSeekSSEParser.cpp
+#include "DeepSeekSSEParser.h"
+
+bool FDeepSeekSSEParser::Feed(const uint8* Data, int64 Length, FOnEvent OnEvent)
+{
+    if (Data == nullptr || Length <= 0)
+    {
+        return true;
+    }
+
+    // 还没有解析出事件时保留开头的原始字节，响应体不是事件流时用来报告错误
+    if (!bHasDispatchedEvent && RawPrefix.Num() < MaxRawPrefixBytes)
+    {
+        const int32 CopyLength = static_cast<int32>(FMath::Min<int64>(Length, MaxRawPrefixBytes - RawPrefix.Num()));
+        RawPrefix.Append(Data, CopyLength);
+    }
+
+    const uint8* Cursor = Data;
+    const uint8* const End = Data + Length;
+
+    while (Cursor < End)
+    {
+        const uint8* LineEnd = static_cast<const uint8*>(FMemory::Memchr(Cursor, '\n', End - Cursor));
+        if (LineEnd == nullptr)
+        {
+            // 行不完整，留到下一个数据块
+            PendingLine.Append(Cursor, static_cast<int32>(End - Cursor));
+            break;
+        }
+
+        bool bContinue;
+        if (PendingLine.Num() > 0)
+        {
+            // 拼接上一块遗留的部分，换行符只会出现在完整的UTF-8字符之间
+            PendingLine.Append(Cursor, static_cast<int32>(LineEnd - Cursor));
+            bContinue = ProcessLine(PendingLine.GetData(), PendingLine.Num(), OnEvent);
+            PendingLine.Reset();
+        }
+        else
+        {
+            bContinue = ProcessLine(Cursor, static_cast<int32>(LineEnd - Cursor), OnEvent);
+        }
+
+        if (!bContinue)
+        {
+            return false;
+        }
+        Cursor = LineEnd + 1;
+    }
+    return true;
+}
+
+bool FDeepSeekSSEParser::Finish(FOnEvent OnEvent)
+{
+    if (PendingLine.Num() > 0)
+    {
+        const bool bContinue = ProcessLine(PendingLine.GetData(), PendingLine.Num(), OnEvent);
+        PendingLine.Reset();
+        if (!bContinue)
+        {
+            return false;
+        }
+    }
+    return DispatchEvent(OnEvent);
+}
+
+void FDeepSeekSSEParser::Reset()
+{
+    PendingLine.Reset();
+    EventData.Reset();
+    bHasEventData = false;
+    RawPrefix.Reset();
+    bHasDispatchedEvent = false;
+}
+
+bool FDeepSeekSSEParser::ProcessLine(const uint8* Line, int32 Length, FOnEvent OnEvent)
+{
+    // 兼容CRLF换行
+    if (Length > 0 && Line[Length - 1] == '\r')
+    {
+        --Length;
+    }
+
+    // 空行表示事件结束
+    if (Length == 0)
+    {
+        return DispatchEvent(OnEvent);
+    }
+
+    // 注释行(如 ": keep-alive")
+    if (Line[0] == ':')
+    {
+        return true;
+    }
+
+    // 拆分字段名和值，值前面的一个空格按规范忽略
+    int32 Colon = 0;
+    while (Colon < Length && Line[Colon] != ':')
+    {
+        ++Colon;
+    }
+
+    int32 ValueStart = FMath::Min(Colon + 1, Length);
+    if (ValueStart < Length && Line[ValueStart] == ' ')
+    {
+        ++ValueStart;
+    }
+
+    // 只关心data字段，event/id/retry直接忽略
+    if (Colon == 4 && FMemory::Memcmp(Line, "data", 4) == 0)
+    {
+        if (bHasEventData)
+        {
+            EventData.Add('\n');
+        }
+        EventData.Append(Line + ValueStart, Length - ValueStart);
+        bHasEventData = true;
+    }
+    return true;
+}
+
+bool FDeepSeekSSEParser::DispatchEvent(FOnEvent OnEvent)
+{
+    if (!bHasEventData)
+    {
+        return true;
+    }
+
+    // 确认是事件流后不再需要原始字节
+    if (!bHasDispatchedEvent)
+    {
+        bHasDispatchedEvent = true;
+        RawPrefix.Empty();
+    }
+
+    const FUtf8StringView Event(reinterpret_cast<const UTF8CHAR*>(EventData.GetData()), EventData.Num());
+    const bool bContinue = OnEvent(Event);
+
+    EventData.Reset();
+    bHasEventData = false;
+    return bContinue;
+}
@@ -0,0 +1,178 @@
+﻿// DeepSeekSentenceSegmenter.cpp
+#include "DeepSeekSentenceSegmenter.h"
+
+namespace DeepSeekSegmenter
+{
+    // 句末标点，中文标点和问号、叹号直接作为边界
+    static bool IsSentenceEnd(TCHAR Char)
+    {
+        switch (Char)
+        {
+        case TEXT('。'): case TEXT('！'): case TEXT('？'): case TEXT('…'):
+        case TEXT('!'): case TEXT('?'): case TEXT('\n'):
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    static bool IsClauseEnd(TCHAR Char)
+    {
+        switch (Char)
+        {
+        case TEXT('，'): case TEXT('、'): case TEXT('；'): case TEXT('：'):
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // 英文的句号、逗号等只有后面跟着空白时才是边界，避免切开3.14、e.g.之类的文本
+    static bool IsAsciiSentenceEnd(TCHAR Char)
+    {
+        return Char == TEXT('.');
+    }
+
+    static bool IsAsciiClauseEnd(TCHAR Char)
+    {
+        return Char == TEXT(',') || Char == TEXT(';') || Char == TEXT(':');
+    }
+
+    // 跟在句末标点之后、属于同一句的字符
+    static bool IsClosing(TCHAR Char)
+    {
+        switch (Char)
+        {
+        case TEXT('”'): case TEXT('’'): case TEXT('」'): case TEXT('』'): case TEXT('）'): case TEXT('】'): case TEXT('》'):
+        case TEXT('"'): case TEXT('\''): case TEXT(')'): case TEXT(']'):
+            return true;
+        default:
+            return false;
+        }
+    }
+}
+
+void FDeepSeekSentenceSegmenter::Configure(int32 InMinChars, bool bInSplitOnClauses, float InFlushTimeout)
+{
+    MinChars = FMath::Max(0, InMinChars);
+    bSplitOnClauses = bInSplitOnClauses;
+    FlushTimeout = FMath::Max(0.0f, InFlushTimeout);
+}
+
+void FDeepSeekSentenceSegmenter::Reset()
+{
+    Pending.Reset();
+    ScanPos = 0;
+    BoundaryEnd = INDEX_NONE;
+    bBoundaryNeedsSpace = false;
+    NextIndex = 0;
+    PendingStartTime = 0.0;
+    LastFeedTime = 0.0;
+    bHasInput = false;
+}
+
+void FDeepSeekSentenceSegmenter::Feed(FStringView Text, double Now, FOnSegment OnSegment)
+{
+    using namespace DeepSeekSegmenter;
+
+    if (Text.IsEmpty())
+    {
+        return;
+    }
+    if (Pending.IsEmpty())
+    {
+        PendingStartTime = Now;
+    }
+    LastFeedTime = Now;
+    bHasInput = true;
+    Pending.Append(Text);
+
+    // 只扫描新加入的字符
+    while (ScanPos < Pending.Len())
+    {
+        const TCHAR Char = Pending[ScanPos];
+
+        if (BoundaryEnd != INDEX_NONE)
+        {
+            if (IsClosing(Char) || IsSentenceEnd(Char))
+            {
+                BoundaryEnd = ++ScanPos;
+                continue;
+            }
+
+            const int32 End = BoundaryEnd;
+            const bool bConfirmed = !bBoundaryNeedsSpace || FChar::IsWhitespace(Char);
+            BoundaryEnd = INDEX_NONE;
+            bBoundaryNeedsSpace = false;
+
+            // 不足最少字符数时继续累积，当前字符重新判断
+            if (bConfirmed && TryEmit(End, false, OnSegment))
+            {
+                continue;
+            }
+        }
+
+        if (IsSentenceEnd(Char) || (bSplitOnClauses && IsClauseEnd(Char)))
+        {
+            BoundaryEnd = ScanPos + 1;
+        }
+        else if (IsAsciiSentenceEnd(Char) || (bSplitOnClauses && IsAsciiClauseEnd(Char)))
+        {
+            BoundaryEnd = ScanPos + 1;
+            bBoundaryNeedsSpace = true;
+        }
+        ++ScanPos;
+    }
+}
+
+bool FDeepSeekSentenceSegmenter::TryEmit(int32 End, bool bForce, FOnSegment OnSegment)
+{
+    int32 VisibleChars = 0;
+    for (int32 Index = 0; Index < End; ++Index)
+    {
+        if (!FChar::IsWhitespace(Pending[Index]))
+        {
+            ++VisibleChars;
+        }
+    }
+    if (!bForce && VisibleChars < MinChars)
+    {
+        return false;
+    }
+
+    // 只有空白的片段直接丢弃，不占用编号
+    if (VisibleChars > 0)
+    {
+        OnSegment(NextIndex++, FString(FStringView(Pending).Left(End).TrimStartAndEnd()));
+    }
+
+    Pending.RemoveAt(0, End);
+    ScanPos = FMath::Max(0, ScanPos - End);
+    PendingStartTime = LastFeedTime;
+    return true;
+}
+
+void FDeepSeekSentenceSegmenter::FlushIfExpired(double Now, FOnSegment OnSegment)
+{
+    if (FlushTimeout <= 0.0 || Pending.IsEmpty() || Now - PendingStartTime < FlushTimeout)
+    {
+        return;
+    }
+
+    // 有待确认的边界时只切到边界，否则切出全部文本
+    const int32 End = BoundaryEnd != INDEX_NONE ? BoundaryEnd : Pending.Len();
+    BoundaryEnd = INDEX_NONE;
+    bBoundaryNeedsSpace = false;
+    TryEmit(End, true, OnSegment);
+    PendingStartTime = Now;
+}
+
+void FDeepSeekSentenceSegmenter::Finish(FOnSegment OnSegment)
+{
+    BoundaryEnd = INDEX_NONE;
+    bBoundaryNeedsSpace = false;
+    if (!Pending.IsEmpty())
+    {
+        TryEmit(Pending.Len(), true, OnSegment);
+    }
+}
@@ -0,0 +1,218 @@
+﻿// DeepSeekStreamDelta.cpp
+#include "DeepSeekStreamDelta.h"
+#include "DeepSeekJsonScanner.h"
+
+void FDeepSeekStreamDelta::Reset()
+{
+    Content.Reset();
+    ToolCalls.Reset();
+    FinishReason.Reset();
+    ErrorMessage.Reset();
+    bHasUsage = false;
+    PromptTokens = 0;
+    CompletionTokens = 0;
+    TotalTokens = 0;
+    PromptCacheHitTokens = 0;
+    PromptCacheMissTokens = 0;
+}
+
+bool FDeepSeekStreamDelta::Parse(FUtf8StringView Json)
+{
+    Reset();
+
+    FDeepSeekJsonScanner Scanner(Json);
+    if (!Scanner.BeginObject())
+    {
+        return false;
+    }
+
+    FUtf8StringView Key;
+    while (Scanner.NextKey(Key))
+    {
+        if (Key.Equals(UTF8TEXTVIEW("choices")) && Scanner.PeekValue() == '[')
+        {
+            Scanner.BeginArray();
+            bool bFirstChoice = true;
+            while (Scanner.NextElement())
+            {
+                // 只使用第一个候选
+                if (bFirstChoice && Scanner.PeekValue() == '{')
+                {
+                    ParseChoice(Scanner);
+                    bFirstChoice = false;
+                }
+                else
+                {
+                    Scanner.SkipValue();
+                }
+            }
+        }
+        else if (Key.Equals(UTF8TEXTVIEW("usage")) && Scanner.PeekValue() == '{')
+        {
+            ParseUsage(Scanner);
+        }
+        else if (Key.Equals(UTF8TEXTVIEW("error")) && Scanner.PeekValue() == '{')
+        {
+            ParseError(Scanner);
+        }
+        else
+        {
+            Scanner.SkipValue();
+        }
+    }
+    return !Scanner.HasError();
+}
+
+void FDeepSeekStreamDelta::ParseChoice(FDeepSeekJsonScanner& Scanner)
+{
+    Scanner.BeginObject();
+
+    FUtf8StringView Key;
+    while (Scanner.NextKey(Key))
+    {
+        if (Key.Equals(UTF8TEXTVIEW("delta")) && Scanner.PeekValue() == '{')
+        {
+            Scanner.BeginObject();
+
+            FUtf8StringView DeltaKey;
+            while (Scanner.NextKey(DeltaKey))
+            {
+                if (DeltaKey.Equals(UTF8TEXTVIEW("content")))
+                {
+                    Scanner.ReadString(Content);
+                }
+                else if (DeltaKey.Equals(UTF8TEXTVIEW("tool_calls")) && Scanner.PeekValue() == '[')
+                {
+                    ParseToolCalls(Scanner);
+                }
+                else
+                {
+                    Scanner.SkipValue();
+                }
+            }
+        }
+        else if (Key.Equals(UTF8TEXTVIEW("finish_reason")))
+        {
+            Scanner.ReadString(FinishReason);
+        }
+        else
+        {
+            Scanner.SkipValue();
+        }
+    }
+}
+
+void FDeepSeekStreamDelta::ParseToolCalls(FDeepSeekJsonScanner& Scanner)
+{
+    Scanner.BeginArray();
+    while (Scanner.NextElement())
+    {
+        if (Scanner.PeekValue() != '{')
+        {
+            Scanner.SkipValue();
+            continue;
+        }
+
+        FToolCallFragment& Fragment = ToolCalls.AddDefaulted_GetRef();
+        Fragment.Index = ToolCalls.Num() - 1;
+        Scanner.BeginObject();
+
+        FUtf8StringView Key;
+        while (Scanner.NextKey(Key))
+        {
+            int64 Index = 0;
+            if (Key.Equals(UTF8TEXTVIEW("index")))
+            {
+                if (Scanner.ReadInteger(Index)) Fragment.Index = static_cast<int32>(Index);
+            }
+            else if (Key.Equals(UTF8TEXTVIEW("id")))
+            {
+                Scanner.ReadString(Fragment.Id);
+            }
+            else if (Key.Equals(UTF8TEXTVIEW("function")) && Scanner.PeekValue() == '{')
+            {
+                Scanner.BeginObject();
+
+                FUtf8StringView FunctionKey;
+                while (Scanner.NextKey(FunctionKey))
+                {
+                    if (FunctionKey.Equals(UTF8TEXTVIEW("name")))
+                    {
+                        Scanner.ReadString(Fragment.Name);
+                    }
+                    else if (FunctionKey.Equals(UTF8TEXTVIEW("arguments")))
+                    {
+                        Scanner.ReadString(Fragment.Arguments);
+                    }
+                    else
+                    {
+                        Scanner.SkipValue();
+                    }
+                }
+            }
+            else
+            {
+                Scanner.SkipValue();
+            }
+        }
+    }
+}
+
+void FDeepSeekStreamDelta::ParseUsage(FDeepSeekJsonScanner& Scanner)
+{
+    Scanner.BeginObject();
+    bHasUsage = true;
+
+    FUtf8StringView Key;
+    while (Scanner.NextKey(Key))
+    {
+        int64 Value = 0;
+        if (Key.Equals(UTF8TEXTVIEW("prompt_tokens")))
+        {
+            if (Scanner.ReadInteger(Value)) PromptTokens = static_cast<int32>(Value);
+        }
+        else if (Key.Equals(UTF8TEXTVIEW("completion_tokens")))
+        {
+            if (Scanner.ReadInteger(Value)) CompletionTokens = static_cast<int32>(Value);
+        }
+        else if (Key.Equals(UTF8TEXTVIEW("total_tokens")))
+        {
+            if (Scanner.ReadInteger(Value)) TotalTokens = static_cast<int32>(Value);
+        }
+        else if (Key.Equals(UTF8TEXTVIEW("prompt_cache_hit_tokens")))
+        {
+            if (Scanner.ReadInteger(Value)) PromptCacheHitTokens = static_cast<int32>(Value);
+        }
+        else if (Key.Equals(UTF8TEXTVIEW("prompt_cache_miss_tokens")))
+        {
+            if (Scanner.ReadInteger(Value)) PromptCacheMissTokens = static_cast<int32>(Value);
+        }
+        else
+        {
+            Scanner.SkipValue();
+        }
+    }
+}
+
+void FDeepSeekStreamDelta::ParseError(FDeepSeekJsonScanner& Scanner)
+{
+    Scanner.BeginObject();
+
+    FUtf8StringView Key;
+    while (Scanner.NextKey(Key))
+    {
+        if (Key.Equals(UTF8TEXTVIEW("message")))
+        {
+            Scanner.ReadString(ErrorMessage);
+        }
+        else
+        {
+            Scanner.SkipValue();
+        }
+    }
+
+    if (ErrorMessage.IsEmpty())
+    {
+        ErrorMessage = TEXT("Unknown API error");
+    }
+}
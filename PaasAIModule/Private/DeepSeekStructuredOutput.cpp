@@ -0,0 +1,165 @@
+﻿// DeepSeekStructuredOutput.cpp
+#include "DeepSeekStructuredOutput.h"
+
+void FDeepSeekStructuredOutputParser::Reset()
+{
+    Phase = EPhase::BeforeObject;
+    Key.Reset();
+    Value.Reset();
+    Nesting = 0;
+    bInNestedString = false;
+    bEscape = false;
+    bHasInput = false;
+}
+
+void FDeepSeekStructuredOutputParser::EmitField(FOnField OnField)
+{
+    OnField(Key, Value);
+    Key.Reset();
+    Value.Reset();
+    Phase = EPhase::ExpectKey;
+}
+
+void FDeepSeekStructuredOutputParser::Feed(FStringView Text, FOnField OnField)
+{
+    bHasInput |= !Text.IsEmpty();
+
+    for (const TCHAR Char : Text)
+    {
+        switch (Phase)
+        {
+        case EPhase::BeforeObject:
+            if (Char == TEXT('{'))
+            {
+                Phase = EPhase::ExpectKey;
+            }
+            break;
+
+        case EPhase::ExpectKey:
+            if (Char == TEXT('"'))
+            {
+                Phase = EPhase::InKey;
+            }
+            else if (Char == TEXT('}'))
+            {
+                Phase = EPhase::Done;
+            }
+            break;
+
+        case EPhase::InKey:
+            // 字段名按原样保存，只处理转义的引号
+            if (bEscape)
+            {
+                Key.AppendChar(Char);
+                bEscape = false;
+            }
+            else if (Char == TEXT('\\'))
+            {
+                bEscape = true;
+            }
+            else if (Char == TEXT('"'))
+            {
+                Phase = EPhase::ExpectColon;
+            }
+            else
+            {
+                Key.AppendChar(Char);
+            }
+            break;
+
+        case EPhase::ExpectColon:
+            if (Char == TEXT(':'))
+            {
+                Phase = EPhase::ExpectValue;
+            }
+            break;
+
+        case EPhase::ExpectValue:
+            if (FChar::IsWhitespace(Char))
+            {
+                break;
+            }
+            Value.AppendChar(Char);
+            if (Char == TEXT('"'))
+            {
+                Phase = EPhase::InString;
+            }
+            else if (Char == TEXT('{') || Char == TEXT('['))
+            {
+                Phase = EPhase::InNested;
+                Nesting = 1;
+            }
+            else
+            {
+                Phase = EPhase::InPrimitive;
+            }
+            break;
+
+        case EPhase::InString:
+            Value.AppendChar(Char);
+            if (bEscape)
+            {
+                bEscape = false;
+            }
+            else if (Char == TEXT('\\'))
+            {
+                bEscape = true;
+            }
+            else if (Char == TEXT('"'))
+            {
+                EmitField(OnField);
+            }
+            break;
+
+        case EPhase::InNested:
+            Value.AppendChar(Char);
+            if (bInNestedString)
+            {
+                if (bEscape)
+                {
+                    bEscape = false;
+                }
+                else if (Char == TEXT('\\'))
+                {
+                    bEscape = true;
+                }
+                else if (Char == TEXT('"'))
+                {
+                    bInNestedString = false;
+                }
+            }
+            else if (Char == TEXT('"'))
+            {
+                bInNestedString = true;
+            }
+            else if (Char == TEXT('{') || Char == TEXT('['))
+            {
+                ++Nesting;
+            }
+            else if ((Char == TEXT('}') || Char == TEXT(']')) && --Nesting == 0)
+            {
+                EmitField(OnField);
+            }
+            break;
+
+        case EPhase::InPrimitive:
+            // 数字、true/false/null在分隔符处结束
+            if (Char == TEXT(',') || Char == TEXT('}') || FChar::IsWhitespace(Char))
+            {
+                EmitField(OnField);
+                if (Char == TEXT('}'))
+                {
+                    Phase = EPhase::Done;
+                }
+            }
+            else
+            {
+                Value.AppendChar(Char);
+            }
+            break;
+
+        case EPhase::Done:
+            return;
+        }
+    }
+}
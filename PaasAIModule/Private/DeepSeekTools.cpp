@@ -0,0 +1,85 @@
+﻿// DeepSeekTools.cpp
+#include "DeepSeekTools.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+bool FDeepSeekToolCall::ParseArguments(TSharedPtr<FJsonObject>& OutArguments) const
+{
+    if (Arguments.TrimStartAndEnd().IsEmpty())
+    {
+        OutArguments = MakeShared<FJsonObject>();
+        return true;
+    }
+
+    TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Arguments);
+    return FJsonSerializer::Deserialize(Reader, OutArguments) && OutArguments.IsValid();
+}
+
+FDeepSeekToolRegistry::FEntry& FDeepSeekToolRegistry::AddEntry(const FDeepSeekToolDefinition& Definition)
+{
+    const int32 Existing = Entries.IndexOfByPredicate([&Definition](const FEntry& Entry) { return Entry.Name == Definition.Name; });
+    if (Existing != INDEX_NONE)
+    {
+        Definitions[Existing] = Definition;
+        Entries[Existing] = FEntry();
+        Entries[Existing].Name = Definition.Name;
+        return Entries[Existing];
+    }
+
+    Definitions.Add(Definition);
+    FEntry& Entry = Entries.AddDefaulted_GetRef();
+    Entry.Name = Definition.Name;
+    return Entry;
+}
+
+void FDeepSeekToolRegistry::Register(const FDeepSeekToolDefinition& Definition, FNativeHandler&& Handler)
+{
+    AddEntry(Definition).NativeHandler = MoveTemp(Handler);
+}
+
+void FDeepSeekToolRegistry::Register(const FDeepSeekToolDefinition& Definition, const FDeepSeekToolHandler& Handler)
+{
+    AddEntry(Definition).DynamicHandler = Handler;
+}
+
+bool FDeepSeekToolRegistry::Unregister(const FString& Name)
+{
+    const int32 Index = Entries.IndexOfByPredicate([&Name](const FEntry& Entry) { return Entry.Name == Name; });
+    if (Index == INDEX_NONE)
+    {
+        return false;
+    }
+
+    Entries.RemoveAt(Index);
+    Definitions.RemoveAt(Index);
+    return true;
+}
+
+void FDeepSeekToolRegistry::Empty()
+{
+    Entries.Empty();
+    Definitions.Empty();
+}
+
+bool FDeepSeekToolRegistry::Invoke(const FDeepSeekToolCall& ToolCall, FString& OutResult) const
+{
+    const FEntry* Entry = Entries.FindByPredicate([&ToolCall](const FEntry& Candidate) { return Candidate.Name == ToolCall.Name; });
+    if (Entry != nullptr)
+    {
+        if (Entry->NativeHandler)
+        {
+            OutResult = Entry->NativeHandler(ToolCall);
+            return true;
+        }
+        if (Entry->DynamicHandler.IsBound())
+        {
+            OutResult = Entry->DynamicHandler.Execute(ToolCall);
+            return true;
+        }
+    }
+
+    // 把错误作为调用结果发回，模型通常会改用其他方式回答
+    OutResult = FString::Printf(TEXT("{\"error\":\"Unknown tool: %s\"}"), *ToolCall.Name.ReplaceCharWithEscapedChar());
+    return false;
+}
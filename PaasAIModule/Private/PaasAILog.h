@@ -0,0 +1,37 @@
+﻿// PaasAILog.h
+#pragma once
+
+#include "Logging/LogMacros.h"
+
+// 发行版只保留警告及以上的日志，其余级别在编译期去除
+#if UE_BUILD_SHIPPING
+DECLARE_LOG_CATEGORY_EXTERN(LogPaasAI, Log, Warning);
+#else
+DECLARE_LOG_CATEGORY_EXTERN(LogPaasAI, Log, All);
+#endif
+
+// 请求调试输出(包括OnDebugMessage)默认在发行版中整体去除，可在Build.cs中定义为1保留
+#ifndef PAASAI_WITH_DEBUG_LOG
+#define PAASAI_WITH_DEBUG_LOG (!UE_BUILD_SHIPPING)
+#endif
+
+#if PAASAI_WITH_DEBUG_LOG
+
+/** 在UDeepSeekFunction成员函数中使用，只有开启调试模式时才格式化消息 */
+#define DEEPSEEK_LOG_DEBUG(Format, ...) \
+    do { if (UNLIKELY(bDebug)) { LogDebug(FString::Printf(Format, ##__VA_ARGS__)); } } while (0)
+
+#define DEEPSEEK_LOG_DEBUG_ERROR(Format, ...) \
+    do { if (UNLIKELY(bDebug)) { LogDebug(FString::Printf(Format, ##__VA_ARGS__), true); } } while (0)
+
+/** 逐token的输出，按PaasAI.TokenLogInterval采样，只写日志不触发OnDebugMessage */
+#define DEEPSEEK_LOG_TOKEN(Format, ...) \
+    do { if (UNLIKELY(bDebug) && ShouldLogToken()) { UE_LOG(LogPaasAI, Log, TEXT("[DeepSeek] ") Format, ##__VA_ARGS__); } } while (0)
+
+#else
+
+#define DEEPSEEK_LOG_DEBUG(Format, ...) do { } while (0)
+#define DEEPSEEK_LOG_DEBUG_ERROR(Format, ...) do { } while (0)
+#define DEEPSEEK_LOG_TOKEN(Format, ...) do { } while (0)
+
+#endif
@@ -1,20 +1,202 @@
-// Copyright Epic Games, Inc. All Rights Reserved.
-
-#include "PaasAIModule.h"
-
-#define LOCTEXT_NAMESPACE "FPaasAIModuleModule"
-
-void FPaasAIModuleModule::StartupModule()
-{
-	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
-}
-
-void FPaasAIModuleModule::ShutdownModule()
-{
-	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
-	// we call this function before unloading the module.
-}
-
-#undef LOCTEXT_NAMESPACE
-	
+﻿// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "PaasAIModule.h"
+#include "Misc/ConfigCacheIni.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectGlobals.h"
+#include "PaasAIStats.h"
+#include "PaasAILog.h"
+
+#define LOCTEXT_NAMESPACE "FPaasAIModuleModule"
+
+DEFINE_LOG_CATEGORY(LogPaasAI);
+
+DEFINE_STAT(STAT_PaasAI_RequestPoolHits);
+DEFINE_STAT(STAT_PaasAI_RequestPoolMisses);
+DEFINE_STAT(STAT_PaasAI_LiveRequests);
+DEFINE_STAT(STAT_PaasAI_PooledRequests);
+DEFINE_STAT(STAT_PaasAI_StreamBufferMemory);
+DEFINE_STAT(STAT_PaasAI_PeakStreamBufferBytes);
+DEFINE_STAT(STAT_PaasAI_RequestsSucceeded);
+DEFINE_STAT(STAT_PaasAI_RequestsFailed);
+DEFINE_STAT(STAT_PaasAI_BytesSent);
+DEFINE_STAT(STAT_PaasAI_BytesReceived);
+DEFINE_STAT(STAT_PaasAI_LastQueueWaitMs);
+DEFINE_STAT(STAT_PaasAI_LastTimeToFirstByteMs);
+DEFINE_STAT(STAT_PaasAI_LastTimeToFirstTokenMs);
+DEFINE_STAT(STAT_PaasAI_LastTokensPerSecond);
+DEFINE_STAT(STAT_PaasAI_PromptCacheHitTokens);
+DEFINE_STAT(STAT_PaasAI_PromptCacheMissTokens);
+DEFINE_STAT(STAT_PaasAI_Retries);
+DEFINE_STAT(STAT_PaasAI_HedgesSent);
+DEFINE_STAT(STAT_PaasAI_HedgesWon);
+DEFINE_STAT(STAT_PaasAI_ConnectionsReused);
+DEFINE_STAT(STAT_PaasAI_ConnectionsOpened);
+DEFINE_STAT(STAT_PaasAI_ConnectionPrewarms);
+DEFINE_STAT(STAT_PaasAI_KeepAlivePings);
+DEFINE_STAT(STAT_PaasAI_ParseResponse);
+
+static const TCHAR* PaasAIConfigSection = TEXT("PaasAIModule");
+
+void FPaasAIModuleModule::StartupModule()
+{
+	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+	bShutDown = false;
+	Scheduler = MakeUnique<FDeepSeekRequestScheduler>();
+
+	// 调度参数可在DefaultGame.ini的[PaasAIModule]中配置
+	int32 MaxInFlightPerEndpoint = 8;
+	int32 BackgroundShare = 4;
+	int32 RequestsPerMinute = 0;
+	int32 TokensPerMinute = 0;
+	if (GConfig)
+	{
+		GConfig->GetInt(PaasAIConfigSection, TEXT("MaxInFlightPerEndpoint"), MaxInFlightPerEndpoint, GGameIni);
+		GConfig->GetInt(PaasAIConfigSection, TEXT("BackgroundShare"), BackgroundShare, GGameIni);
+		GConfig->GetInt(PaasAIConfigSection, TEXT("RequestsPerMinute"), RequestsPerMinute, GGameIni);
+		GConfig->GetInt(PaasAIConfigSection, TEXT("TokensPerMinute"), TokensPerMinute, GGameIni);
+	}
+	Scheduler->SetMaxInFlightPerEndpoint(MaxInFlightPerEndpoint);
+	Scheduler->SetBackgroundShare(BackgroundShare);
+
+	// 未配置时不限速，直到从响应头中学到服务器的限额
+	Scheduler->GetRateLimiter().SetDefaultLimits(RequestsPerMinute, TokensPerMinute);
+
+	// 响应缓存默认只使用内存，磁盘层需要显式开启
+	ResponseCache = MakeUnique<FDeepSeekResponseCache>();
+	int32 ResponseCacheMemoryKB = 8 * 1024;
+	int32 ResponseCacheDiskKB = 64 * 1024;
+	bool bResponseCacheOnDisk = false;
+	if (GConfig)
+	{
+		GConfig->GetInt(PaasAIConfigSection, TEXT("ResponseCacheMemoryKB"), ResponseCacheMemoryKB, GGameIni);
+		GConfig->GetInt(PaasAIConfigSection, TEXT("ResponseCacheDiskKB"), ResponseCacheDiskKB, GGameIni);
+		GConfig->GetBool(PaasAIConfigSection, TEXT("bResponseCacheOnDisk"), bResponseCacheOnDisk, GGameIni);
+	}
+	ResponseCache->SetMemoryBudget(static_cast<int64>(ResponseCacheMemoryKB) * 1024);
+	ResponseCache->SetDiskBudget(static_cast<int64>(ResponseCacheDiskKB) * 1024);
+	if (bResponseCacheOnDisk)
+	{
+		ResponseCache->SetDiskDirectory(FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("PaasAI"), TEXT("ResponseCache")));
+	}
+
+	// 请求对象池，MaxPooledRequests=0时不复用对象
+	RequestPool = MakeUnique<FDeepSeekRequestPool>();
+	int32 MaxPooledRequests = 64;
+	if (GConfig)
+	{
+		GConfig->GetInt(PaasAIConfigSection, TEXT("MaxPooledRequests"), MaxPooledRequests, GGameIni);
+	}
+	RequestPool->SetMaxPooled(MaxPooledRequests);
+
+	// 连接管理要在添加端点之前创建，端点的源站会登记到这里；
+	// 保活和加载关卡后预热会定期发出请求，默认关闭，需要时在配置中开启
+	ConnectionManager = MakeUnique<FDeepSeekConnectionManager>();
+	int32 PrewarmConnections = 1;
+	float KeepAliveSeconds = 0.0f;
+	float ConnectionIdleTimeoutSeconds = 60.0f;
+	float KeepAliveMaxIdleSeconds = 300.0f;
+	bool bPrewarmOnMapLoad = false;
+	if (GConfig)
+	{
+		GConfig->GetInt(PaasAIConfigSection, TEXT("PrewarmConnections"), PrewarmConnections, GGameIni);
+		GConfig->GetFloat(PaasAIConfigSection, TEXT("KeepAliveSeconds"), KeepAliveSeconds, GGameIni);
+		GConfig->GetFloat(PaasAIConfigSection, TEXT("ConnectionIdleTimeoutSeconds"), ConnectionIdleTimeoutSeconds, GGameIni);
+		GConfig->GetFloat(PaasAIConfigSection, TEXT("KeepAliveMaxIdleSeconds"), KeepAliveMaxIdleSeconds, GGameIni);
+		GConfig->GetBool(PaasAIConfigSection, TEXT("bPrewarmOnMapLoad"), bPrewarmOnMapLoad, GGameIni);
+	}
+	ConnectionManager->Configure(PrewarmConnections, KeepAliveSeconds, ConnectionIdleTimeoutSeconds, KeepAliveMaxIdleSeconds);
+
+	// 端点池，每行一个端点，例如
+	// +Endpoints=(Name="primary",URL="https://api.deepseek.com/v1/chat/completions",APIKey="sk-...",Weight=1.0)
+	// +Endpoints=(Name="overflow",URL="http://10.0.0.5:8000/v1/chat/completions",bOverflowOnly=True)
+	EndpointPool = MakeUnique<FDeepSeekEndpointPool>();
+	FString RoutingPolicy;
+	int32 CircuitFailureThreshold = 5;
+	float CircuitCooldownSeconds = 30.0f;
+	TArray<FString> EndpointLines;
+	if (GConfig)
+	{
+		GConfig->GetString(PaasAIConfigSection, TEXT("EndpointRouting"), RoutingPolicy, GGameIni);
+		GConfig->GetInt(PaasAIConfigSection, TEXT("CircuitFailureThreshold"), CircuitFailureThreshold, GGameIni);
+		GConfig->GetFloat(PaasAIConfigSection, TEXT("CircuitCooldownSeconds"), CircuitCooldownSeconds, GGameIni);
+		GConfig->GetArray(PaasAIConfigSection, TEXT("Endpoints"), EndpointLines, GGameIni);
+	}
+	if (RoutingPolicy == TEXT("LatencyWeighted"))
+	{
+		EndpointPool->SetPolicy(EDeepSeekRoutingPolicy::LatencyWeighted);
+	}
+	EndpointPool->SetCircuitBreaker(CircuitFailureThreshold, CircuitCooldownSeconds);
+	int32 NumEndpoints = 0;
+	for (const FString& Line : EndpointLines)
+	{
+		FDeepSeekEndpointConfig Config;
+		if (FDeepSeekEndpointConfig::StaticStruct()->ImportText(*Line, &Config, nullptr, PPF_None, GLog, TEXT("Endpoints")) == nullptr)
+		{
+			UE_LOG(LogPaasAI, Warning, TEXT("Ignoring malformed endpoint config: %s"), *Line);
+			continue;
+		}
+		AddEndpoint(Config);
+		++NumEndpoints;
+	}
+
+	// 只预热配置中的端点；模块加载时HTTP模块可能还没有就绪，推迟到第一帧再预热；
+	// 加载关卡后再预热一次，加载界面期间被服务器关闭的连接在第一句对话之前重新建立
+	if (PrewarmConnections > 0 && NumEndpoints > 0)
+	{
+		PrewarmTicker = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([this](float DeltaTime)
+		{
+			PrewarmTicker.Reset();
+			ConnectionManager->Prewarm();
+			return false;
+		}));
+		if (bPrewarmOnMapLoad)
+		{
+			PostLoadMapHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddRaw(this, &FPaasAIModuleModule::HandlePostLoadMap);
+		}
+	}
+}
+
+void FPaasAIModuleModule::HandlePostLoadMap(UWorld* World)
+{
+	ConnectionManager->Prewarm();
+}
+
+void FPaasAIModuleModule::AddEndpoint(const FDeepSeekEndpointConfig& Config)
+{
+	EndpointPool->AddEndpoint(Config);
+	if (Config.MaxInFlight > 0)
+	{
+		Scheduler->SetEndpointLimit(FDeepSeekRequestScheduler::MakeEndpointKey(Config.URL, Config.APIKey), Config.MaxInFlight);
+	}
+	ConnectionManager->AddOrigin(Config.URL);
+}
+
+void FPaasAIModuleModule::ShutdownModule()
+{
+	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
+	// we call this function before unloading the module.
+	// 先标记为已关闭，释放各服务时回调中的Get()不会再拿到正在销毁的成员
+	bShutDown = true;
+	FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(PostLoadMapHandle);
+	if (PrewarmTicker.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(PrewarmTicker);
+		PrewarmTicker.Reset();
+	}
+	ConnectionManager.Reset();
+	EndpointPool.Reset();
+	RequestPool.Reset();
+	ResponseCache.Reset();
+	Scheduler.Reset();
+}
+
+FPaasAIModuleModule* FPaasAIModuleModule::Get()
+{
+	FPaasAIModuleModule* Module = FModuleManager::GetModulePtr<FPaasAIModuleModule>(TEXT("PaasAIModule"));
+	return (Module != nullptr && !Module->bShutDown) ? Module : nullptr;
+}
+
+#undef LOCTEXT_NAMESPACE
+	
 IMPLEMENT_MODULE(FPaasAIModuleModule, PaasAIModule)
\ No newline at end of file
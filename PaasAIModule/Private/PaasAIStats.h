@@ -0,0 +1,36 @@
+﻿// PaasAIStats.h
+#pragma once
+
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("PaasAI"), STATGROUP_PaasAI, STATCAT_Advanced);
+
+// 请求对象池
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Request Pool Hits"), STAT_PaasAI_RequestPoolHits, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Request Pool Misses"), STAT_PaasAI_RequestPoolMisses, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live Requests"), STAT_PaasAI_LiveRequests, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Pooled Requests"), STAT_PaasAI_PooledRequests, STATGROUP_PaasAI, );
+
+// 流式文本缓冲区，峰值是所有进行中请求的总量，用PaasAI.ResetStreamBufferPeak重置
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Active Stream Buffers"), STAT_PaasAI_StreamBufferMemory, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Peak Stream Buffer Bytes"), STAT_PaasAI_PeakStreamBufferBytes, STATGROUP_PaasAI, );
+
+// 请求指标，Last开头的是最近一个结束的请求的值
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Requests Succeeded"), STAT_PaasAI_RequestsSucceeded, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Requests Failed"), STAT_PaasAI_RequestsFailed, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Bytes Sent"), STAT_PaasAI_BytesSent, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Bytes Received"), STAT_PaasAI_BytesReceived, STATGROUP_PaasAI, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Last Queue Wait (ms)"), STAT_PaasAI_LastQueueWaitMs, STATGROUP_PaasAI, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Last Time To First Byte (ms)"), STAT_PaasAI_LastTimeToFirstByteMs, STATGROUP_PaasAI, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Last Time To First Token (ms)"), STAT_PaasAI_LastTimeToFirstTokenMs, STATGROUP_PaasAI, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Last Tokens Per Second"), STAT_PaasAI_LastTokensPerSecond, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Prompt Cache Hit Tokens"), STAT_PaasAI_PromptCacheHitTokens, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Prompt Cache Miss Tokens"), STAT_PaasAI_PromptCacheMissTokens, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Retries"), STAT_PaasAI_Retries, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Hedged Requests Sent"), STAT_PaasAI_HedgesSent, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Hedged Requests Won"), STAT_PaasAI_HedgesWon, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Connections Reused"), STAT_PaasAI_ConnectionsReused, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Connections Opened"), STAT_PaasAI_ConnectionsOpened, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Connection Prewarms"), STAT_PaasAI_ConnectionPrewarms, STATGROUP_PaasAI, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Keep-Alive Pings"), STAT_PaasAI_KeepAlivePings, STATGROUP_PaasAI, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Parse Response"), STAT_PaasAI_ParseResponse, STATGROUP_PaasAI, );
@@ -1,187 +1,518 @@
-﻿// SimpleChat.cpp
-#include "SimpleChat.h"
-
-USimpleChat* USimpleChat::CreateChatInstance()
-{
-    return NewObject<USimpleChat>();
-}
-
-const TArray<FDeepSeekMessage>& USimpleChat::GetMessages() const
-{
-    return ChatHistory;
-}
-
-void USimpleChat::BeginDestroy()
-{
-    bIsBeingDestroyed = true;
-    CleanupCurrentRequest();
-    Super::BeginDestroy();
-}
-
-void USimpleChat::CleanupCurrentRequest()
-{
-    // 清除当前的请求及其回调
-    if (ApiRequest != nullptr)
-    {
-        ApiRequest->OnStream.RemoveAll(this);
-        ApiRequest->OnCompleted.RemoveAll(this);
-        ApiRequest->OnFailed.RemoveAll(this);
-        ApiRequest = nullptr;
-    }
-}
-
-void USimpleChat::SendMessage(
-    const FString& APIKey,
-    const FString& Message,
-    const FString& SystemPrompt,
-    const FString& ModelName,
-    float Temperature)
-{
-    // 检查是否在销毁过程中
-    if (bIsBeingDestroyed)
-    {
-        return;
-    }
-
-    // 验证输入参数
-    if (Message.IsEmpty())
-    {
-        OnFailed.Broadcast(TEXT("Cannot send empty message"));
-        return;
-    }
-    
-    if (APIKey.IsEmpty())
-    {
-        OnFailed.Broadcast(TEXT("API Key is required"));
-        return;
-    }
-    
-    // 重置累积响应
-    AccumulatedResponse.Empty();
-    
-    // 确保清理之前的请求
-    CleanupCurrentRequest();
-    
-    // 如果是新对话且有系统提示，添加系统消息
-    if (ChatHistory.Num() == 0 && !SystemPrompt.IsEmpty())
-    {
-        ChatHistory.Add(FDeepSeekMessage(TEXT("system"), SystemPrompt));
-    }
-    
-    // 添加用户消息到历史
-    ChatHistory.Add(FDeepSeekMessage(TEXT("user"), Message));
-    
-    // 创建请求参数
-    FDeepSeekRequestParams Params;
-    Params.APIKey = APIKey;
-    Params.Model = ModelName;
-    Params.Messages = ChatHistory;
-    Params.bStream = true;
-    Params.Temperature = FMath::Clamp(Temperature, 0.0f, 1.0f);
-    
-    // 发送请求
-    ApiRequest = UDeepSeekFunction::SendRequest(Params);
-    
-    // 绑定回调
-    if (ApiRequest)
-    {
-        ApiRequest->OnStream.AddDynamic(this, &USimpleChat::HandleStreamResponse);
-        ApiRequest->OnCompleted.AddDynamic(this, &USimpleChat::HandleCompletedResponse);
-        ApiRequest->OnFailed.AddDynamic(this, &USimpleChat::HandleFailedResponse);
-    }
-    else
-    {
-        OnFailed.Broadcast(TEXT("Failed to create API request"));
-    }
-}
-
-FString USimpleChat::GetChatHistory() const
-{
-    FString History;
-    History.Reserve(1024); // 预分配一个合理的初始容量
-    
-    for (const FDeepSeekMessage& Message : ChatHistory)
-    {
-        FString Prefix;
-        if (Message.Role == TEXT("user"))
-        {
-            Prefix = TEXT("User: ");
-        }
-        else if (Message.Role == TEXT("assistant"))
-        {
-            Prefix = TEXT("Assistant: ");
-        }
-        else if (Message.Role == TEXT("system"))
-        {
-            Prefix = TEXT("System: ");
-        }
-        
-        History.Append(Prefix);
-        History.Append(Message.Content);
-        History.Append(TEXT("\n\n"));
-    }
-    
-    return History;
-}
-
-void USimpleChat::ClearChat()
-{
-    ChatHistory.Empty();
-    CleanupCurrentRequest();
-}
-
-void USimpleChat::HandleStreamResponse(FString Response)
-{
-    if (bIsBeingDestroyed || Response.IsEmpty()) return;
-    
-    // 累积流式响应
-    AccumulatedResponse.Append(Response);
-    
-    // 转发流式响应
-    OnStream.Broadcast(Response);
-}
-
-void USimpleChat::HandleCompletedResponse(FString Response)
-{
-    if (bIsBeingDestroyed) return;
-    
-    // 获取完整的流式响应
-    FString FullResponse;
-    if (ApiRequest)
-    {
-        FullResponse = ApiRequest->GetFullStreamedText();
-    }
-    
-    if (FullResponse.IsEmpty())
-    {
-        FullResponse = AccumulatedResponse;
-    }
-    
-    if (!FullResponse.IsEmpty())
-    {
-        // 添加助手响应到历史
-        ChatHistory.Add(FDeepSeekMessage(TEXT("assistant"), FullResponse));
-        
-        // 触发完成事件
-        OnCompleted.Broadcast(FullResponse);
-    }
-    else
-    {
-        // 响应为空
-        OnFailed.Broadcast(TEXT("Received empty response"));
-    }
-    
-    // 清理请求
-    CleanupCurrentRequest();
-}
-
-void USimpleChat::HandleFailedResponse(FString ErrorMessage)
-{
-    if (bIsBeingDestroyed) return;
-    
-    // 触发失败事件
-    OnFailed.Broadcast(ErrorMessage);
-    
-    // 清理请求
-    CleanupCurrentRequest();
-}
+﻿// SimpleChat.cpp
+#include "SimpleChat.h"
+#include "PaasAILog.h"
+#include "DeepSeekEndpointPool.h"
+
+USimpleChat* USimpleChat::CreateChatInstance()
+{
+    return NewObject<USimpleChat>();
+}
+
+const TArray<FDeepSeekMessage>& USimpleChat::GetMessages() const
+{
+    return ChatHistory;
+}
+
+void USimpleChat::BeginDestroy()
+{
+    bIsBeingDestroyed = true;
+    CleanupCurrentRequest();
+    CleanupSummaryRequest();
+    Super::BeginDestroy();
+}
+
+void USimpleChat::CleanupCurrentRequest()
+{
+    // 清除当前的请求及其回调，仍在进行的请求直接中止，不再消耗token
+    if (ApiRequest != nullptr)
+    {
+        ApiRequest->OnStream.RemoveAll(this);
+        ApiRequest->OnCompleted.RemoveAll(this);
+        ApiRequest->OnFailed.RemoveAll(this);
+        ApiRequest->OnCancelled.RemoveAll(this);
+        ApiRequest->OnStructuredField.RemoveAll(this);
+        ApiRequest->OnSegment.RemoveAll(this);
+        ApiRequest->Cancel();
+        ApiRequest = nullptr;
+    }
+}
+
+void USimpleChat::CleanupSummaryRequest()
+{
+    if (SummaryRequest != nullptr)
+    {
+        SummaryRequest->OnCompleted.RemoveAll(this);
+        SummaryRequest->OnFailed.RemoveAll(this);
+        SummaryRequest = nullptr;
+    }
+}
+
+void USimpleChat::AppendToHistory(FDeepSeekMessage&& Message)
+{
+    // 估算token数并编码，每条消息只处理一次
+    ContextWindow.Append(Message);
+    ChatHistory.Add(MoveTemp(Message));
+}
+
+void USimpleChat::SendMessage(
+    const FString& APIKey,
+    const FString& Message,
+    const FString& SystemPrompt,
+    const FString& ModelName,
+    float Temperature)
+{
+    // 检查是否在销毁过程中
+    if (bIsBeingDestroyed)
+    {
+        return;
+    }
+
+    // 验证输入参数
+    if (Message.IsEmpty())
+    {
+        OnFailed.Broadcast(TEXT("Cannot send empty message"));
+        return;
+    }
+    
+    // 端点池中有端点时由端点提供API密钥
+    if (APIKey.IsEmpty() && !UDeepSeekEndpointLibrary::HasEndpoints())
+    {
+        OnFailed.Broadcast(TEXT("API Key is required"));
+        return;
+    }
+    
+    // 函数处理中发起的新消息在本轮结果全部写入历史后发送
+    if (bRunningTools)
+    {
+        PendingMessage = FPendingMessage{ APIKey, Message, SystemPrompt, ModelName, Temperature };
+        return;
+    }
+    
+    // 确保清理之前的请求
+    CleanupCurrentRequest();
+    
+    // 如果是新对话且有系统提示，添加系统消息
+    if (ChatHistory.Num() == 0 && !SystemPrompt.IsEmpty())
+    {
+        AppendToHistory(FDeepSeekMessage(TEXT("system"), SystemPrompt));
+    }
+    
+    // 添加用户消息到历史
+    AppendToHistory(FDeepSeekMessage(TEXT("user"), Message));
+    
+    // 超出预算时淘汰最早的轮次，发送的上下文大小不再随对话长度增长
+    ContextWindow.SetTokenBudget(ContextTokenBudget);
+    ContextWindow.SetPrefixStable(bPrefixStableContext);
+    if (ContextWindow.Trim(ChatHistory))
+    {
+        if (bPrefixStableContext)
+        {
+            UE_LOG(LogPaasAI, Log, TEXT("[SimpleChat] Evicted turns before message %d, prompt cache prefix rebuilt"), ContextWindow.GetWindowStart());
+        }
+        else
+        {
+            UE_LOG(LogPaasAI, Warning, TEXT("[SimpleChat] Context eviction rewrote the sent prefix, provider prompt cache invalidated (enable bPrefixStableContext to evict less often)"));
+        }
+    }
+    
+    // 模型名是请求体的第一个字段，更换模型后前缀缓存全部失效
+    if (!LastModelName.IsEmpty() && LastModelName != ModelName)
+    {
+        UE_LOG(LogPaasAI, Warning, TEXT("[SimpleChat] Model changed from %s to %s, provider prompt cache invalidated"), *LastModelName, *ModelName);
+    }
+    
+    LastAPIKey = APIKey;
+    LastModelName = ModelName;
+    LastTemperature = FMath::Clamp(Temperature, 0.0f, 1.0f);
+    ToolRounds = 0;
+    if (bSummarizeEvictedTurns)
+    {
+        RequestSummary();
+    }
+    
+    SendContext();
+}
+
+void USimpleChat::SendContext()
+{
+    // 创建请求参数，消息使用上下文窗口的编码，不再复制ChatHistory
+    FDeepSeekRequestParams Params;
+    Params.APIKey = LastAPIKey;
+    Params.Model = LastModelName;
+    Params.EncodedMessages = ContextWindow.GetEncodedMessages();
+    Params.Tools = ToolRegistry.GetDefinitions();
+    Params.ResponseFormat = ResponseFormat;
+    Params.bSegmentStream = bSegmentStream;
+    Params.SegmentMinChars = SegmentMinChars;
+    Params.bSegmentOnClauses = bSegmentOnClauses;
+    Params.SegmentFlushTimeout = SegmentFlushTimeout;
+    Params.bStream = true;
+    Params.Temperature = LastTemperature;
+    Params.Priority = RequestPriority;
+    Params.TimeoutSeconds = ResponseTimeoutSeconds;
+    Params.FirstTokenTimeoutSeconds = FirstTokenTimeoutSeconds;
+    Params.StopStrings = StopStrings;
+    Params.MaxResponseChars = MaxResponseChars;
+    Params.MaxRetries = MaxRetries;
+    Params.HedgeAfterSeconds = HedgeAfterSeconds;
+    Params.HedgeURL = HedgeURL;
+    Params.HedgeAPIKey = HedgeAPIKey;
+    
+    // 发送请求
+    ApiRequest = UDeepSeekFunction::SendPooledRequest(Params);
+    
+    // 绑定回调
+    if (ApiRequest)
+    {
+        ApiRequest->OnStream.AddDynamic(this, &USimpleChat::HandleStreamResponse);
+        ApiRequest->OnCompleted.AddDynamic(this, &USimpleChat::HandleCompletedResponse);
+        ApiRequest->OnFailed.AddDynamic(this, &USimpleChat::HandleFailedResponse);
+        ApiRequest->OnCancelled.AddDynamic(this, &USimpleChat::HandleCancelledResponse);
+        ApiRequest->OnStructuredField.AddDynamic(this, &USimpleChat::HandleStructuredField);
+        ApiRequest->OnSegment.AddDynamic(this, &USimpleChat::HandleSegment);
+    }
+    else
+    {
+        OnFailed.Broadcast(TEXT("Failed to create API request"));
+    }
+}
+
+FString USimpleChat::GetChatHistory() const
+{
+    FString History;
+    History.Reserve(1024); // 预分配一个合理的初始容量
+    
+    for (const FDeepSeekMessage& Message : ChatHistory)
+    {
+        FString Prefix;
+        if (Message.Role == TEXT("user"))
+        {
+            Prefix = TEXT("User: ");
+        }
+        else if (Message.Role == TEXT("assistant"))
+        {
+            Prefix = TEXT("Assistant: ");
+        }
+        else if (Message.Role == TEXT("system"))
+        {
+            Prefix = TEXT("System: ");
+        }
+        
+        else if (Message.Role == TEXT("tool"))
+        {
+            Prefix = TEXT("Tool: ");
+        }
+        
+        History.Append(Prefix);
+        History.Append(Message.Content);
+        for (const FDeepSeekToolCall& ToolCall : Message.ToolCalls)
+        {
+            History.Appendf(TEXT("[%s(%s)]"), *ToolCall.Name, *ToolCall.Arguments);
+        }
+        History.Append(TEXT("\n\n"));
+    }
+    
+    return History;
+}
+
+void USimpleChat::RegisterTool(const FDeepSeekToolDefinition& Definition, const FDeepSeekToolHandler& Handler)
+{
+    ToolRegistry.Register(Definition, Handler);
+}
+
+void USimpleChat::RegisterNativeTool(const FDeepSeekToolDefinition& Definition, FDeepSeekToolRegistry::FNativeHandler&& Handler)
+{
+    ToolRegistry.Register(Definition, MoveTemp(Handler));
+}
+
+bool USimpleChat::UnregisterTool(const FString& Name)
+{
+    return ToolRegistry.Unregister(Name);
+}
+
+void USimpleChat::ClearChat()
+{
+    ++HistoryGeneration;
+    ChatHistory.Empty();
+    ContextWindow.Reset();
+    CleanupCurrentRequest();
+    CleanupSummaryRequest();
+}
+
+void USimpleChat::Cancel()
+{
+    // 执行函数期间没有进行中的请求，由RunToolCalls结束本轮
+    if (bRunningTools)
+    {
+        bToolRoundCancelled = true;
+        return;
+    }
+    
+    if (ApiRequest)
+    {
+        // 通过HandleCancelledResponse保存部分回答并广播OnCancelled
+        ApiRequest->Cancel();
+    }
+}
+
+void USimpleChat::HandleStreamResponse(FString Response)
+{
+    if (bIsBeingDestroyed || Response.IsEmpty()) return;
+    
+    // 完整文本只保存在请求对象中，这里不再重复累积
+    // 转发流式响应
+    OnStream.Broadcast(Response);
+}
+
+void USimpleChat::HandleStructuredField(FString FieldName, FString Value)
+{
+    if (bIsBeingDestroyed) return;
+    
+    OnStructuredField.Broadcast(FieldName, Value);
+}
+
+void USimpleChat::HandleSegment(int32 Index, FString Segment)
+{
+    if (bIsBeingDestroyed) return;
+    
+    OnSegment.Broadcast(Index, Segment);
+}
+
+void USimpleChat::HandleCompletedResponse(FString Response)
+{
+    if (bIsBeingDestroyed) return;
+    
+    // Response即请求对象累积的完整文本，委托传参时已经复制过一次，直接移动到历史中
+    FString FullResponse = MoveTemp(Response);
+    if (FullResponse.IsEmpty() && ApiRequest)
+    {
+        FullResponse = ApiRequest->GetFullStreamedText();
+    }
+    
+    if (ApiRequest)
+    {
+        LastRequestMetrics = ApiRequest->GetMetrics();
+        
+        // 模型要求调用函数时执行后直接发出下一轮，这一轮不触发OnCompleted
+        if (ApiRequest->GetToolCalls().Num() > 0)
+        {
+            const TArray<FDeepSeekToolCall> ToolCalls = ApiRequest->GetToolCalls();
+            CleanupCurrentRequest();
+            RunToolCalls(MoveTemp(FullResponse), ToolCalls);
+            return;
+        }
+    }
+    
+    if (!FullResponse.IsEmpty())
+    {
+        // 添加助手响应到历史
+        AppendToHistory(FDeepSeekMessage(TEXT("assistant"), MoveTemp(FullResponse)));
+        
+        // 触发完成事件
+        OnCompleted.Broadcast(ChatHistory.Last().Content);
+    }
+    else
+    {
+        // 响应为空
+        OnFailed.Broadcast(TEXT("Received empty response"));
+    }
+    
+    // 清理请求
+    CleanupCurrentRequest();
+}
+
+void USimpleChat::RunToolCalls(FString&& Content, const TArray<FDeepSeekToolCall>& ToolCalls)
+{
+    // 调用和结果都进入历史，下一轮请求和之后的对话都会带上
+    FDeepSeekMessage AssistantMessage(TEXT("assistant"), MoveTemp(Content));
+    AssistantMessage.ToolCalls = ToolCalls;
+    AppendToHistory(MoveTemp(AssistantMessage));
+    
+    // 每个调用都必须有一条结果，执行期间的SendMessage推迟到全部结果写入之后
+    bRunningTools = true;
+    bToolRoundCancelled = false;
+    PendingMessage.Reset();
+    const uint32 Generation = HistoryGeneration;
+    for (const FDeepSeekToolCall& ToolCall : ToolCalls)
+    {
+        // 取消后剩余的调用不再执行，但仍要写入结果，历史中的每个tool_call_id都必须有回应
+        FString Result;
+        const bool bCancelled = bToolRoundCancelled;
+        if (bCancelled)
+        {
+            Result = TEXT("{\"error\":\"Cancelled\"}");
+        }
+        else if (!ToolRegistry.Invoke(ToolCall, Result))
+        {
+            UE_LOG(LogPaasAI, Warning, TEXT("[SimpleChat] Model called unregistered tool %s"), *ToolCall.Name);
+        }
+        
+        // 处理函数中清空了对话，本轮的结果不再属于任何历史
+        if (HistoryGeneration != Generation)
+        {
+            break;
+        }
+        
+        FDeepSeekMessage ToolMessage(TEXT("tool"), Result);
+        ToolMessage.ToolCallId = ToolCall.Id;
+        AppendToHistory(MoveTemp(ToolMessage));
+        if (!bCancelled)
+        {
+            OnToolCalled.Broadcast(ToolCall, Result);
+        }
+        
+        if (HistoryGeneration != Generation)
+        {
+            break;
+        }
+    }
+    bRunningTools = false;
+    
+    if (bIsBeingDestroyed)
+    {
+        return;
+    }
+    
+    // 处理函数中开始了新的消息时不再发出下一轮
+    if (PendingMessage.IsSet())
+    {
+        const FPendingMessage Pending = MoveTemp(PendingMessage.GetValue());
+        PendingMessage.Reset();
+        SendMessage(Pending.APIKey, Pending.Message, Pending.SystemPrompt, Pending.ModelName, Pending.Temperature);
+        return;
+    }
+    
+    if (HistoryGeneration != Generation)
+    {
+        return;
+    }
+    if (bToolRoundCancelled)
+    {
+        OnCancelled.Broadcast(TEXT("Request cancelled"));
+        return;
+    }
+    
+    if (++ToolRounds > MaxToolRounds)
+    {
+        OnFailed.Broadcast(FString::Printf(TEXT("Tool call limit reached (%d rounds)"), MaxToolRounds));
+        return;
+    }
+    
+    ContextWindow.Trim(ChatHistory);
+    SendContext();
+}
+
+void USimpleChat::HandleFailedResponse(FString ErrorMessage)
+{
+    if (bIsBeingDestroyed) return;
+    
+    if (ApiRequest)
+    {
+        LastRequestMetrics = ApiRequest->GetMetrics();
+    }
+    
+    // 触发失败事件
+    OnFailed.Broadcast(ErrorMessage);
+    
+    // 清理请求
+    CleanupCurrentRequest();
+}
+
+void USimpleChat::HandleCancelledResponse(FString Reason)
+{
+    if (bIsBeingDestroyed) return;
+    
+    if (ApiRequest)
+    {
+        LastRequestMetrics = ApiRequest->GetMetrics();
+        
+        // 已经显示给玩家的部分回答保留在历史中，保持用户和助手消息交替
+        FString PartialResponse = ApiRequest->GetFullStreamedText();
+        if (!PartialResponse.IsEmpty())
+        {
+            AppendToHistory(FDeepSeekMessage(TEXT("assistant"), MoveTemp(PartialResponse)));
+        }
+    }
+    
+    OnCancelled.Broadcast(Reason);
+    
+    // 清理请求
+    CleanupCurrentRequest();
+}
+
+void USimpleChat::RequestSummary()
+{
+    // 同一时间只有一个摘要请求，完成后再处理期间新淘汰的轮次
+    const int32 EvictedEnd = ContextWindow.GetWindowStart();
+    if (SummaryRequest != nullptr || EvictedEnd <= ContextWindow.GetLatestSummarizedEnd() || (LastAPIKey.IsEmpty() && !UDeepSeekEndpointLibrary::HasEndpoints()))
+    {
+        return;
+    }
+    
+    // 把上一次的摘要和新淘汰的轮次一起交给模型重新总结
+    FString Conversation;
+    if (!ContextWindow.GetLatestSummary().IsEmpty())
+    {
+        Conversation.Append(TEXT("Previous summary: "));
+        Conversation.Append(ContextWindow.GetLatestSummary());
+        Conversation.Append(TEXT("\n\n"));
+    }
+    for (int32 Index = ContextWindow.GetLatestSummarizedEnd(); Index < EvictedEnd; ++Index)
+    {
+        const FDeepSeekMessage& Message = ChatHistory[Index];
+        Conversation.Append(Message.Role);
+        Conversation.Append(TEXT(": "));
+        Conversation.Append(Message.Content);
+        Conversation.Append(TEXT("\n\n"));
+    }
+    
+    FDeepSeekRequestParams Params;
+    Params.APIKey = LastAPIKey;
+    Params.Model = LastModelName;
+    Params.bStream = false;
+    Params.Temperature = 0.3f;
+    Params.MaxTokens = 512;
+    Params.Priority = EDeepSeekRequestPriority::Background;
+    Params.Messages.Reserve(2);
+    Params.Messages.Add(FDeepSeekMessage(TEXT("system"),
+        TEXT("Summarize the conversation below in a few sentences. Keep names, facts, decisions and open questions. Reply with the summary only, in the language of the conversation.")));
+    Params.Messages.Add(FDeepSeekMessage(TEXT("user"), MoveTemp(Conversation)));
+    
+    PendingSummaryEnd = EvictedEnd;
+    SummaryRequest = UDeepSeekFunction::SendRequest(Params);
+    if (SummaryRequest)
+    {
+        SummaryRequest->OnCompleted.AddDynamic(this, &USimpleChat::HandleSummaryCompleted);
+        SummaryRequest->OnFailed.AddDynamic(this, &USimpleChat::HandleSummaryFailed);
+    }
+}
+
+void USimpleChat::HandleSummaryCompleted(FString Summary)
+{
+    if (bIsBeingDestroyed) return;
+    
+    CleanupSummaryRequest();
+    
+    // 摘要在下一轮发送时生效，代替被淘汰的轮次
+    if (!Summary.IsEmpty() && PendingSummaryEnd <= ChatHistory.Num())
+    {
+        const int32 InvalidationsBefore = ContextWindow.GetPrefixInvalidations();
+        ContextWindow.SetSummary(MoveTemp(Summary), PendingSummaryEnd, ChatHistory);
+        if (ContextWindow.GetPrefixInvalidations() != InvalidationsBefore)
+        {
+            UE_LOG(LogPaasAI, Warning, TEXT("[SimpleChat] Inserting the summary rewrote the sent prefix, provider prompt cache invalidated"));
+        }
+    }
+    
+    // 期间又有轮次被淘汰时继续总结
+    if (bSummarizeEvictedTurns)
+    {
+        RequestSummary();
+    }
+}
+
+void USimpleChat::HandleSummaryFailed(FString ErrorMessage)
+{
+    // 摘要失败不影响对话，被淘汰的轮次留到下一次淘汰时一起总结
+    CleanupSummaryRequest();
+}
@@ -0,0 +1,201 @@
+﻿// DeepSeekEndpointPoolSpec.cpp
+#include "DeepSeekEndpointPool.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+BEGIN_DEFINE_SPEC(FDeepSeekEndpointPoolSpec, "PaasAI.EndpointPool", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+    TUniquePtr<FDeepSeekEndpointPool> Pool;
+
+    static FDeepSeekEndpointConfig MakeEndpoint(const FString& Name, int32 MaxInFlight = 0, bool bOverflowOnly = false)
+    {
+        FDeepSeekEndpointConfig Config;
+        Config.Name = Name;
+        Config.URL = FString::Printf(TEXT("http://%s.invalid/v1/chat/completions"), *Name);
+        Config.MaxInFlight = MaxInFlight;
+        Config.bOverflowOnly = bOverflowOnly;
+        return Config;
+    }
+
+    /** 选择一次端点，返回端点名称，没有选中时返回空字符串 */
+    FString AcquireName(FDeepSeekEndpointPool::FLease& Lease, int32 ExcludeId = INDEX_NONE)
+    {
+        double WaitSeconds = 0.0;
+        if (Pool->Acquire(Lease, ExcludeId, WaitSeconds) != FDeepSeekEndpointPool::EAcquireResult::Acquired)
+        {
+            return FString();
+        }
+        return Lease.URL.Mid(7, Lease.URL.Find(TEXT(".invalid")) - 7);
+    }
+END_DEFINE_SPEC(FDeepSeekEndpointPoolSpec)
+
+void FDeepSeekEndpointPoolSpec::Define()
+{
+    using EAcquireResult = FDeepSeekEndpointPool::EAcquireResult;
+    using EOutcome = FDeepSeekEndpointPool::EOutcome;
+
+    BeforeEach([this]()
+    {
+        Pool = MakeUnique<FDeepSeekEndpointPool>();
+    });
+
+    AfterEach([this]()
+    {
+        Pool.Reset();
+    });
+
+    Describe("Acquire", [this]()
+    {
+        It("returns Empty when no endpoint is configured", [this]()
+        {
+            FDeepSeekEndpointPool::FLease Lease;
+            double WaitSeconds = 0.0;
+            TestEqual(TEXT("Result"), Pool->Acquire(Lease, INDEX_NONE, WaitSeconds), EAcquireResult::Empty);
+        });
+
+        It("balances by outstanding requests", [this]()
+        {
+            Pool->AddEndpoint(MakeEndpoint(TEXT("a")));
+            Pool->AddEndpoint(MakeEndpoint(TEXT("b")));
+
+            FDeepSeekEndpointPool::FLease First;
+            FDeepSeekEndpointPool::FLease Second;
+            const FString FirstName = AcquireName(First);
+            const FString SecondName = AcquireName(Second);
+            TestFalse(TEXT("First acquired"), FirstName.IsEmpty());
+            TestFalse(TEXT("Second acquired"), SecondName.IsEmpty());
+            TestNotEqual(TEXT("Second request goes to the idle endpoint"), FirstName, SecondName);
+        });
+
+        It("avoids the excluded endpoint for retries and hedges", [this]()
+        {
+            Pool->AddEndpoint(MakeEndpoint(TEXT("a")));
+            Pool->AddEndpoint(MakeEndpoint(TEXT("b")));
+
+            FDeepSeekEndpointPool::FLease First;
+            const FString FirstName = AcquireName(First);
+            Pool->Release(First.EndpointId, EOutcome::Failed);
+
+            for (int32 Attempt = 0; Attempt < 4; ++Attempt)
+            {
+                FDeepSeekEndpointPool::FLease Retry;
+                TestNotEqual(TEXT("Retry endpoint"), AcquireName(Retry, First.EndpointId), FirstName);
+                Pool->Release(Retry.EndpointId, EOutcome::Succeeded);
+            }
+        });
+
+        It("falls back to the excluded endpoint when it is the only one", [this]()
+        {
+            Pool->AddEndpoint(MakeEndpoint(TEXT("a")));
+
+            FDeepSeekEndpointPool::FLease First;
+            AcquireName(First);
+            FDeepSeekEndpointPool::FLease Retry;
+            TestEqual(TEXT("Retry endpoint"), AcquireName(Retry, First.EndpointId), FString(TEXT("a")));
+        });
+
+        It("uses overflow endpoints only when regular endpoints are full", [this]()
+        {
+            Pool->AddEndpoint(MakeEndpoint(TEXT("main"), 1));
+            Pool->AddEndpoint(MakeEndpoint(TEXT("overflow"), 0, true));
+
+            FDeepSeekEndpointPool::FLease First;
+            FDeepSeekEndpointPool::FLease Second;
+            TestEqual(TEXT("First endpoint"), AcquireName(First), FString(TEXT("main")));
+            TestEqual(TEXT("Second endpoint"), AcquireName(Second), FString(TEXT("overflow")));
+
+            Pool->Release(First.EndpointId, EOutcome::Succeeded);
+            FDeepSeekEndpointPool::FLease Third;
+            TestEqual(TEXT("Third endpoint"), AcquireName(Third), FString(TEXT("main")));
+        });
+    });
+
+    Describe("Circuit breaker", [this]()
+    {
+        It("fails over to a healthy endpoint after tripping", [this]()
+        {
+            Pool->SetCircuitBreaker(2, 30.0f);
+            Pool->AddEndpoint(MakeEndpoint(TEXT("bad")));
+            Pool->AddEndpoint(MakeEndpoint(TEXT("good")));
+
+            // 只让bad失败，直到熔断
+            int32 BadFailures = 0;
+            for (int32 Attempt = 0; Attempt < 8 && BadFailures < 2; ++Attempt)
+            {
+                FDeepSeekEndpointPool::FLease Lease;
+                const bool bBad = AcquireName(Lease) == TEXT("bad");
+                Pool->Release(Lease.EndpointId, bBad ? EOutcome::Failed : EOutcome::Succeeded);
+                BadFailures += bBad ? 1 : 0;
+            }
+            TestEqual(TEXT("Failures before tripping"), BadFailures, 2);
+
+            for (int32 Attempt = 0; Attempt < 4; ++Attempt)
+            {
+                FDeepSeekEndpointPool::FLease Lease;
+                TestEqual(TEXT("Endpoint while open"), AcquireName(Lease), FString(TEXT("good")));
+                Pool->Release(Lease.EndpointId, EOutcome::Succeeded);
+            }
+
+            const TArray<FDeepSeekEndpointStats> Stats = Pool->GetStats();
+            const FDeepSeekEndpointStats* Bad = Stats.FindByPredicate([](const FDeepSeekEndpointStats& Entry) { return Entry.Name == TEXT("bad"); });
+            if (TestNotNull(TEXT("Bad endpoint stats"), Bad))
+            {
+                TestEqual(TEXT("Bad endpoint state"), Bad->CircuitState, EDeepSeekCircuitState::Open);
+            }
+        });
+
+        It("returns Unavailable with a wait when every endpoint is open", [this]()
+        {
+            Pool->SetCircuitBreaker(1, 30.0f);
+            Pool->AddEndpoint(MakeEndpoint(TEXT("a")));
+
+            FDeepSeekEndpointPool::FLease Lease;
+            AcquireName(Lease);
+            Pool->Release(Lease.EndpointId, EOutcome::Failed);
+
+            double WaitSeconds = 0.0;
+            TestEqual(TEXT("Result"), Pool->Acquire(Lease, INDEX_NONE, WaitSeconds), EAcquireResult::Unavailable);
+            TestTrue(TEXT("Wait is positive"), WaitSeconds > 0.0);
+            TestTrue(TEXT("Wait is capped by the probe interval"), WaitSeconds <= 1.0);
+        });
+
+        It("admits a single probe after the cooldown", [this]()
+        {
+            Pool->SetCircuitBreaker(1, 0.05f);
+            Pool->AddEndpoint(MakeEndpoint(TEXT("a")));
+
+            FDeepSeekEndpointPool::FLease Lease;
+            AcquireName(Lease);
+            Pool->Release(Lease.EndpointId, EOutcome::Failed);
+            FPlatformProcess::Sleep(0.1f);
+
+            FDeepSeekEndpointPool::FLease Probe;
+            TestEqual(TEXT("Probe endpoint"), AcquireName(Probe), FString(TEXT("a")));
+
+            FDeepSeekEndpointPool::FLease Concurrent;
+            double WaitSeconds = 0.0;
+            TestEqual(TEXT("Second request while probing"), Pool->Acquire(Concurrent, INDEX_NONE, WaitSeconds), EAcquireResult::Unavailable);
+
+            Pool->Release(Probe.EndpointId, EOutcome::Succeeded);
+            FDeepSeekEndpointPool::FLease Recovered;
+            TestEqual(TEXT("Endpoint after a successful probe"), AcquireName(Recovered), FString(TEXT("a")));
+            FDeepSeekEndpointPool::FLease Parallel;
+            TestEqual(TEXT("Endpoint accepts parallel requests again"), AcquireName(Parallel), FString(TEXT("a")));
+        });
+
+        It("does not count abandoned attempts as failures", [this]()
+        {
+            Pool->SetCircuitBreaker(1, 30.0f);
+            Pool->AddEndpoint(MakeEndpoint(TEXT("a")));
+
+            for (int32 Attempt = 0; Attempt < 3; ++Attempt)
+            {
+                FDeepSeekEndpointPool::FLease Lease;
+                TestEqual(TEXT("Endpoint"), AcquireName(Lease), FString(TEXT("a")));
+                Pool->Release(Lease.EndpointId, EOutcome::Abandoned);
+            }
+        });
+    });
+}
+
+#endif
@@ -0,0 +1,323 @@
+﻿// DeepSeekFunctionSpec.cpp
+#include "AIFunction.h"
+#include "DeepSeekMockServer.h"
+#include "PaasAIModule.h"
+#include "SimpleChat.h"
+#include "Containers/Ticker.h"
+#include "Misc/AutomationTest.h"
+#include "UObject/StrongObjectPtr.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && !UE_BUILD_SHIPPING
+
+BEGIN_DEFINE_SPEC(FDeepSeekFunctionSpec, "PaasAI.Function", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+    TUniquePtr<FDeepSeekMockServer> Server;
+
+    FDeepSeekRequestParams MakeParams(bool bStream) const
+    {
+        FDeepSeekRequestParams Params;
+        Params.URL = Server->GetURL();
+        Params.APIKey = TEXT("automation");
+        Params.bUseEndpointPool = false;
+        Params.bStream = bStream;
+        Params.RetryBaseDelay = 0.05f;
+        Params.TimeoutSeconds = 20.0f;
+        Params.Messages.Add(FDeepSeekMessage(TEXT("user"), TEXT("Automation")));
+        return Params;
+    }
+
+    FString ExpectedText(int32 NumTokens) const
+    {
+        TArray<uint8> Stream;
+        return FDeepSeekMockServer::BuildStream(NumTokens, Stream);
+    }
+
+    /** 发出请求，结束时在游戏线程上调用OnDone，请求对象在那之前由OnFinishedNative持有的弱引用访问 */
+    static void Send(const FDeepSeekRequestParams& Params, TFunction<void(UDeepSeekFunction*, bool, const FString&, int32)>&& OnDone)
+    {
+        UDeepSeekFunction* Function = UDeepSeekFunction::SendPooledRequest(Params);
+        TWeakObjectPtr<UDeepSeekFunction> WeakFunction(Function);
+        Function->OnFinishedNative.BindLambda([WeakFunction, OnDone = MoveTemp(OnDone)](bool bSuccess, const FString& Result, int32 ResponseCode)
+        {
+            OnDone(WeakFunction.Get(), bSuccess, Result, ResponseCode);
+        });
+    }
+
+    /** 在游戏线程上轮询，条件满足或超时时调用OnDone */
+    static void WaitUntil(TFunction<bool()>&& Condition, float TimeoutSeconds, TFunction<void(bool)>&& OnDone)
+    {
+        const double Deadline = FPlatformTime::Seconds() + TimeoutSeconds;
+        FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda(
+            [Condition = MoveTemp(Condition), OnDone = MoveTemp(OnDone), Deadline](float DeltaTime)
+            {
+                const bool bMet = Condition();
+                if (bMet || FPlatformTime::Seconds() > Deadline)
+                {
+                    OnDone(bMet);
+                    return false;
+                }
+                return true;
+            }));
+    }
+END_DEFINE_SPEC(FDeepSeekFunctionSpec)
+
+void FDeepSeekFunctionSpec::Define()
+{
+    BeforeEach([this]()
+    {
+        Server = MakeUnique<FDeepSeekMockServer>();
+        TestTrue(TEXT("Mock server started"), Server->Start());
+    });
+
+    AfterEach([this]()
+    {
+        Server.Reset();
+    });
+
+    Describe("UDeepSeekFunction", [this]()
+    {
+        for (const int32 ChunkBytes : { 0, 1, 5, -1 })
+        {
+            LatentIt(FString::Printf(TEXT("streams the full text in %s byte chunks"), ChunkBytes > 0 ? *FString::FromInt(ChunkBytes) : ChunkBytes == 0 ? TEXT("event sized") : TEXT("random")),
+                FTimespan::FromSeconds(30.0), [this, ChunkBytes](const FDoneDelegate& Done)
+            {
+                FDeepSeekMockServerConfig Config;
+                Config.NumTokens = 40;
+                Config.ChunkBytes = ChunkBytes;
+                Config.TokenDelaySeconds = 0.002f;
+                Server->SetConfig(Config);
+
+                Send(MakeParams(true), [this, Done, Expected = ExpectedText(Config.NumTokens)](UDeepSeekFunction* Function, bool bSuccess, const FString& Result, int32 ResponseCode)
+                {
+                    TestTrue(TEXT("Succeeded"), bSuccess);
+                    TestEqual(TEXT("Response code"), ResponseCode, 200);
+                    TestEqual(TEXT("Text"), Result, Expected);
+                    if (TestNotNull(TEXT("Function"), Function))
+                    {
+                        const FDeepSeekRequestMetrics Metrics = Function->GetMetrics();
+                        TestEqual(TEXT("Completion tokens"), Metrics.CompletionTokens, 40);
+                        TestTrue(TEXT("Game thread time recorded"), Metrics.GameThreadSeconds > 0.0f);
+                    }
+                    Done.Execute();
+                });
+            });
+        }
+
+        LatentIt("returns the message of a non-stream response", FTimespan::FromSeconds(30.0), [this](const FDoneDelegate& Done)
+        {
+            FDeepSeekMockServerConfig Config;
+            Config.NumTokens = 3;
+            Server->SetConfig(Config);
+
+            Send(MakeParams(false), [this, Done](UDeepSeekFunction* Function, bool bSuccess, const FString& Result, int32 ResponseCode)
+            {
+                TestTrue(TEXT("Succeeded"), bSuccess);
+                TestEqual(TEXT("Text"), Result, FString(TEXT("Hello world，")));
+                Done.Execute();
+            });
+        });
+
+        LatentIt("retries 429 responses", FTimespan::FromSeconds(30.0), [this](const FDoneDelegate& Done)
+        {
+            FDeepSeekMockServerConfig Config;
+            Config.NumTokens = 8;
+            Config.FailFirstRequests = 2;
+            Config.ErrorCode = 429;
+            Config.RetryAfterSeconds = 0;
+            Server->SetConfig(Config);
+
+            FDeepSeekRequestParams Params = MakeParams(true);
+            Params.MaxRetries = 3;
+            Send(Params, [this, Done, Expected = ExpectedText(Config.NumTokens)](UDeepSeekFunction* Function, bool bSuccess, const FString& Result, int32 ResponseCode)
+            {
+                TestTrue(TEXT("Succeeded"), bSuccess);
+                TestEqual(TEXT("Text"), Result, Expected);
+                TestEqual(TEXT("Requests"), Server->GetRequestCount(), 3);
+                if (TestNotNull(TEXT("Function"), Function))
+                {
+                    TestEqual(TEXT("Retries"), Function->GetMetrics().Retries, 2);
+                }
+                Done.Execute();
+            });
+        });
+
+        LatentIt("does not retry 400 responses", FTimespan::FromSeconds(30.0), [this](const FDoneDelegate& Done)
+        {
+            FDeepSeekMockServerConfig Config;
+            Config.FailFirstRequests = 1;
+            Config.ErrorCode = 400;
+            Server->SetConfig(Config);
+
+            FDeepSeekRequestParams Params = MakeParams(true);
+            Params.MaxRetries = 3;
+            Send(Params, [this, Done](UDeepSeekFunction* Function, bool bSuccess, const FString& Result, int32 ResponseCode)
+            {
+                TestFalse(TEXT("Succeeded"), bSuccess);
+                TestEqual(TEXT("Response code"), ResponseCode, 400);
+                TestEqual(TEXT("Requests"), Server->GetRequestCount(), 1);
+                Done.Execute();
+            });
+        });
+
+        LatentIt("fails when the connection drops mid-stream", FTimespan::FromSeconds(30.0), [this](const FDoneDelegate& Done)
+        {
+            FDeepSeekMockServerConfig Config;
+            Config.NumTokens = 64;
+            Config.DisconnectRate = 1.0f;
+            Server->SetConfig(Config);
+
+            Send(MakeParams(true), [this, Done](UDeepSeekFunction* Function, bool bSuccess, const FString& Result, int32 ResponseCode)
+            {
+                TestFalse(TEXT("Succeeded"), bSuccess);
+                Done.Execute();
+            });
+        });
+
+        LatentIt("cancels a slow stream", FTimespan::FromSeconds(30.0), [this](const FDoneDelegate& Done)
+        {
+            FDeepSeekMockServerConfig Config;
+            Config.NumTokens = 200;
+            Config.TokenDelaySeconds = 0.05f;
+            Server->SetConfig(Config);
+
+            const double StartTime = FPlatformTime::Seconds();
+            UDeepSeekFunction* Function = UDeepSeekFunction::SendRequest(MakeParams(true));
+            TStrongObjectPtr<UDeepSeekFunction> StrongFunction(Function);
+            Function->OnFinishedNative.BindLambda([this, Done, StartTime](bool bSuccess, const FString& Result, int32 ResponseCode)
+            {
+                TestFalse(TEXT("Succeeded"), bSuccess);
+                TestEqual(TEXT("Response code"), ResponseCode, 0);
+                TestTrue(TEXT("Cancelled before the stream ended"), FPlatformTime::Seconds() - StartTime < 5.0);
+                Done.Execute();
+            });
+
+            WaitUntil([StrongFunction]() { return !StrongFunction->GetFullStreamedText().IsEmpty(); }, 10.0f,
+                [this, StrongFunction](bool bStreaming)
+                {
+                    TestTrue(TEXT("Received text before cancelling"), bStreaming);
+                    StrongFunction->Cancel();
+                });
+        });
+
+        LatentIt("fails over to a healthy endpoint in the module pool", FTimespan::FromSeconds(30.0), [this](const FDoneDelegate& Done)
+        {
+            FPaasAIModuleModule* Module = FPaasAIModuleModule::Get();
+            if (Module == nullptr || !Module->GetEndpointPool().IsEmpty())
+            {
+                AddWarning(TEXT("The module endpoint pool is in use, skipping"));
+                Done.Execute();
+                return;
+            }
+
+            // 第一个端点总是返回503，重试应当换到第二个端点
+            TSharedRef<FDeepSeekMockServer> Healthy = MakeShared<FDeepSeekMockServer>();
+            Healthy->Start();
+
+            FDeepSeekMockServerConfig Failing;
+            Failing.FailFirstRequests = TNumericLimits<int32>::Max();
+            Failing.ErrorCode = 503;
+            Server->SetConfig(Failing);
+
+            FDeepSeekEndpointConfig Endpoint;
+            Endpoint.Name = TEXT("automation-failing");
+            Endpoint.URL = Server->GetURL();
+            Endpoint.APIKey = TEXT("automation");
+            Module->GetEndpointPool().AddEndpoint(Endpoint);
+            Endpoint.Name = TEXT("automation-healthy");
+            Endpoint.URL = Healthy->GetURL();
+            Module->GetEndpointPool().AddEndpoint(Endpoint);
+
+            TSharedRef<int32> Remaining = MakeShared<int32>(4);
+            for (int32 Index = 0; Index < 4; ++Index)
+            {
+                FDeepSeekRequestParams Params = MakeParams(true);
+                Params.bUseEndpointPool = true;
+                Params.MaxRetries = 2;
+                Send(Params, [this, Done, Healthy, Remaining](UDeepSeekFunction* Function, bool bSuccess, const FString& Result, int32 ResponseCode)
+                {
+                    TestTrue(TEXT("Succeeded through the healthy endpoint"), bSuccess);
+                    if (--(*Remaining) == 0)
+                    {
+                        if (FPaasAIModuleModule* Module = FPaasAIModuleModule::Get())
+                        {
+                            Module->GetEndpointPool().RemoveEndpoint(TEXT("automation-failing"));
+                            Module->GetEndpointPool().RemoveEndpoint(TEXT("automation-healthy"));
+                        }
+                        TestEqual(TEXT("Healthy endpoint requests"), Healthy->GetRequestCount(), 4);
+                        Done.Execute();
+                    }
+                });
+            }
+        });
+    });
+
+    Describe("USimpleChat", [this]()
+    {
+        LatentIt("keeps a two turn conversation", FTimespan::FromSeconds(30.0), [this](const FDoneDelegate& Done)
+        {
+            FPaasAIModuleModule* Module = FPaasAIModuleModule::Get();
+            if (Module == nullptr || !Module->GetEndpointPool().IsEmpty())
+            {
+                AddWarning(TEXT("The module endpoint pool is in use, skipping"));
+                Done.Execute();
+                return;
+            }
+
+            // 对话对象使用默认URL，通过模块的端点池指向模拟服务器
+            FDeepSeekMockServerConfig Config;
+            Config.NumTokens = 12;
+            Config.ChunkBytes = 3;
+            Server->SetConfig(Config);
+
+            FDeepSeekEndpointConfig Endpoint;
+            Endpoint.Name = TEXT("automation-chat");
+            Endpoint.URL = Server->GetURL();
+            Endpoint.APIKey = TEXT("automation");
+            Module->GetEndpointPool().AddEndpoint(Endpoint);
+
+            TStrongObjectPtr<USimpleChat> Chat(USimpleChat::CreateChatInstance());
+            Chat->SendMessage(FString(), TEXT("First"), TEXT("System"));
+
+            // 历史中是否包含系统提示不影响判断，只看回答是否追加到了末尾
+            auto LastIsAssistant = [Chat](int32 NumMessages)
+            {
+                const TArray<FDeepSeekMessage>& Messages = Chat->GetMessages();
+                return Messages.Num() >= NumMessages && Messages.Last().Role == TEXT("assistant");
+            };
+
+            const FString Expected = ExpectedText(Config.NumTokens);
+            WaitUntil([LastIsAssistant]() { return LastIsAssistant(2); }, 20.0f,
+                [this, Done, Chat, LastIsAssistant, Expected](bool bFirstAnswered)
+                {
+                    TestTrue(TEXT("First turn answered"), bFirstAnswered);
+                    if (!bFirstAnswered)
+                    {
+                        if (FPaasAIModuleModule* Module = FPaasAIModuleModule::Get())
+                        {
+                            Module->GetEndpointPool().RemoveEndpoint(TEXT("automation-chat"));
+                        }
+                        Done.Execute();
+                        return;
+                    }
+                    TestEqual(TEXT("First answer"), Chat->GetMessages().Last().Content, Expected);
+
+                    const int32 FirstTurnMessages = Chat->GetMessages().Num();
+                    Chat->SendMessage(FString(), TEXT("Second"));
+                    WaitUntil([LastIsAssistant, FirstTurnMessages]() { return LastIsAssistant(FirstTurnMessages + 2); }, 20.0f,
+                        [this, Done, Chat, FirstTurnMessages](bool bSecondAnswered)
+                        {
+                            TestTrue(TEXT("Second turn answered"), bSecondAnswered);
+                            TestEqual(TEXT("Messages"), Chat->GetMessages().Num(), FirstTurnMessages + 2);
+                            TestEqual(TEXT("Requests"), Server->GetRequestCount(), 2);
+                            TestTrue(TEXT("Metrics recorded"), Chat->GetLastRequestMetrics().CompletionTokens > 0);
+                            if (FPaasAIModuleModule* Module = FPaasAIModuleModule::Get())
+                            {
+                                Module->GetEndpointPool().RemoveEndpoint(TEXT("automation-chat"));
+                            }
+                            Done.Execute();
+                        });
+                });
+        });
+    });
+}
+
+#endif
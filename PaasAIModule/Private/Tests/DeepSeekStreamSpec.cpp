@@ -0,0 +1,105 @@
+﻿// DeepSeekStreamSpec.cpp
+#include "DeepSeekMockServer.h"
+#include "DeepSeekSSEParser.h"
+#include "DeepSeekStreamDelta.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && !UE_BUILD_SHIPPING
+
+BEGIN_DEFINE_SPEC(FDeepSeekStreamSpec, "PaasAI.Stream", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+    /**
+     * 把录制的流按ChunkBytes切块(小于等于0时随机1~64字节)送入解析器
+     * @return 拼接出的文本
+     */
+    static FString ParseInChunks(const TArray<uint8>& Stream, int32 ChunkBytes, int32& OutEvents, bool& bOutDone)
+    {
+        FDeepSeekSSEParser Parser;
+        FDeepSeekStreamDelta Delta;
+        FRandomStream Random(ChunkBytes);
+        FString Text;
+        OutEvents = 0;
+        bOutDone = false;
+
+        auto OnEvent = [&Delta, &Text, &OutEvents, &bOutDone](FUtf8StringView EventData)
+        {
+            if (EventData == UTF8TEXTVIEW("[DONE]"))
+            {
+                bOutDone = true;
+                return true;
+            }
+            Delta.Reset();
+            if (Delta.Parse(EventData))
+            {
+                Text.Append(Delta.Content);
+                ++OutEvents;
+            }
+            return true;
+        };
+
+        int64 Offset = 0;
+        while (Offset < Stream.Num())
+        {
+            const int64 Length = FMath::Min<int64>(Stream.Num() - Offset, ChunkBytes > 0 ? ChunkBytes : Random.RandRange(1, 64));
+            Parser.Feed(Stream.GetData() + Offset, Length, OnEvent);
+            Offset += Length;
+        }
+        Parser.Finish(OnEvent);
+        return Text;
+    }
+END_DEFINE_SPEC(FDeepSeekStreamSpec)
+
+void FDeepSeekStreamSpec::Define()
+{
+    Describe("SSE parser", [this]()
+    {
+        // 1字节会切开每个UTF-8字符和每个行尾，7和13让边界落在不同位置
+        for (const int32 ChunkBytes : { 1, 2, 3, 7, 13, 64, 4096, 0 })
+        {
+            It(FString::Printf(TEXT("reassembles the text from %s byte chunks"), ChunkBytes > 0 ? *FString::FromInt(ChunkBytes) : TEXT("random")), [this, ChunkBytes]()
+            {
+                TArray<uint8> Stream;
+                const FString Expected = FDeepSeekMockServer::BuildStream(97, Stream);
+
+                int32 Events = 0;
+                bool bDone = false;
+                const FString Text = ParseInChunks(Stream, ChunkBytes, Events, bDone);
+                TestEqual(TEXT("Text"), Text, Expected);
+                TestEqual(TEXT("Content events"), Events, 98);
+                TestTrue(TEXT("Received [DONE]"), bDone);
+            });
+        }
+
+        It("handles CRLF line endings and comments", [this]()
+        {
+            const FTCHARToUTF8 Utf8(TEXT(": keep-alive\r\n\r\ndata: {\"choices\":[{\"delta\":{\"content\":\"你\"}}]}\r\n\r\ndata: {\"choices\":[{\"delta\":{\"content\":\"好\"}}]}\r\n\r\ndata: [DONE]\r\n\r\n"));
+            TArray<uint8> Stream(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+
+            int32 Events = 0;
+            bool bDone = false;
+            TestEqual(TEXT("Text"), ParseInChunks(Stream, 1, Events, bDone), FString(TEXT("你好")));
+            TestTrue(TEXT("Received [DONE]"), bDone);
+        });
+
+        It("dispatches a final event without a trailing blank line on Finish", [this]()
+        {
+            const FTCHARToUTF8 Utf8(TEXT("data: {\"choices\":[{\"delta\":{\"content\":\"end\"}}]}"));
+            TArray<uint8> Stream(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+
+            int32 Events = 0;
+            bool bDone = false;
+            TestEqual(TEXT("Text"), ParseInChunks(Stream, 5, Events, bDone), FString(TEXT("end")));
+        });
+
+        It("keeps the raw prefix of a non-event response", [this]()
+        {
+            const FTCHARToUTF8 Utf8(TEXT("{\"error\":{\"message\":\"bad key\"}}"));
+            FDeepSeekSSEParser Parser;
+            Parser.Feed(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length(), [](FUtf8StringView) { return true; });
+            TestFalse(TEXT("Dispatched an event"), Parser.HasDispatchedEvent());
+            TestEqual(TEXT("Raw prefix length"), Parser.GetRawPrefix().Len(), Utf8.Length());
+        });
+    });
+}
+
+#endif
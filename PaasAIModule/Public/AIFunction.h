@@ -1,148 +1,623 @@
-﻿// AIFunction.h
-#pragma once
-
-#include "CoreMinimal.h"
-#include "Interfaces/IHttpRequest.h"
-#include "Kismet/BlueprintAsyncActionBase.h"
-#include "AIFunction.generated.h"
-
-/**
- * 单条消息结构体
- */
-USTRUCT(BlueprintType)
-struct FDeepSeekMessage
-{
-    GENERATED_BODY()
-    
-    /** 消息角色 (system, user, assistant) */
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
-    FString Role = TEXT("user");
-    
-    /** 消息内容 */
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (MultiLine = true))
-    FString Content;
-    
-    FDeepSeekMessage() {}
-    FDeepSeekMessage(const FString& InRole, const FString& InContent)
-        : Role(InRole), Content(InContent) {}
-};
-
-/**
- * 请求参数结构体
- */
-USTRUCT(BlueprintType)
-struct FDeepSeekRequestParams
-{
-    GENERATED_BODY()
-    
-    /** API URL */
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
-    FString URL = TEXT("https://api.deepseek.com/v1/chat/completions");
-    
-    /** API密钥 */
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
-    FString APIKey;
-    
-    /** 模型名称 */
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
-    FString Model = TEXT("deepseek-chat");
-    
-    /** 消息数组 */
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
-    TArray<FDeepSeekMessage> Messages;
-    
-    /** 是否使用流式响应 */
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
-    bool bStream = true;
-    
-    /** 温度参数 (0.0-1.0) */
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0.0", ClampMax = "1.0"))
-    float Temperature = 0.7f;
-    
-    /** 最大令牌数 */
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
-    int32 MaxTokens = 2048;
-    
-    /** 调试模式 */
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
-    bool bDebugMode = false;
-};
-
-/** 响应委托 */
-DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FDeepSeekResponse, FString, Response);
-/** 调试信息委托 */
-DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FDeepSeekDebug, FString, Message);
-
-/**
- * DeepSeek API异步调用节点
- */
-UCLASS()
-class PAASAIMODULE_API UDeepSeekFunction : public UBlueprintAsyncActionBase
-{
-    GENERATED_BODY()
-
-public:
-    /** 请求完成时触发 */
-    UPROPERTY(BlueprintAssignable)
-    FDeepSeekResponse OnCompleted;
-    
-    /** 请求失败时触发 */
-    UPROPERTY(BlueprintAssignable)
-    FDeepSeekResponse OnFailed;
-    
-    /** 流式响应时触发 */
-    UPROPERTY(BlueprintAssignable)
-    FDeepSeekResponse OnStream;
-    
-    /** 调试信息 */
-    UPROPERTY(BlueprintAssignable)
-    FDeepSeekDebug OnDebugMessage;
-
-    /**
-     * 发送DeepSeek请求(高级版)
-     */
-    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek", meta = (BlueprintInternalUseOnly = "true"))
-    static UDeepSeekFunction* SendRequest(const FDeepSeekRequestParams& Params);
-    
-    /**
-     * 快速发送请求(简化版)
-     */
-    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek", meta = (BlueprintInternalUseOnly = "true"))
-    static UDeepSeekFunction* QuickSendRequest(const FString& APIKey, const FString& Prompt, bool UseStreaming = true, bool Debug = false);
-
-    /**
-     * 发送多轮对话消息
-     */
-    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek", meta = (BlueprintInternalUseOnly = "true"))
-    static UDeepSeekFunction* SendConversationMessage(
-        const TArray<FDeepSeekMessage>& Messages, 
-        const FString& NewUserMessage,
-        const FString& APIKey, 
-        const FString& Model = TEXT("deepseek-chat"),
-        bool UseStreaming = true, 
-        bool Debug = true);
-
-    // 获取流式传输的完整文本
-    UFUNCTION(BlueprintPure, Category = "AI|DeepSeek")
-    const FString& GetFullStreamedText() const { return AccumulatedStreamText; }
-    
-    // 析构函数，确保对象从根集中移除
-    virtual void BeginDestroy() override;
-
-protected:
-    void ExecuteRequest(const FDeepSeekRequestParams& Params);
-    void LogDebug(const FString& Message, bool bIsError = false);
-    bool HandleStreamData(const FString& DataString);
-    FString ExtractContentFromResponse(const FString& ResponseString);
-    
-    // 从根集中移除自身的安全方法
-    void SafeRemoveFromRoot();
-    
-    bool bDebug = false;
-    FString AccumulatedStreamText;
-    bool bIsRequestComplete = false;
-    bool bIsBeingDestroyed = false;
-    
-    // 指向HTTP请求的强引用，防止被垃圾回收
-    TSharedPtr<IHttpRequest, ESPMode::ThreadSafe> HttpRequestRef;
-};
+﻿// AIFunction.h
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "Containers/Queue.h"
+#include "Containers/Ticker.h"
+#include <atomic>
+#include "DeepSeekSSEParser.h"
+#include "DeepSeekStreamDelta.h"
+#include "DeepSeekRequestMetrics.h"
+#include "DeepSeekEndpointPool.h"
+#include "DeepSeekTools.h"
+#include "DeepSeekStructuredOutput.h"
+#include "DeepSeekSentenceSegmenter.h"
+#include "AIFunction.generated.h"
+
+/**
+ * 请求优先级通道
+ */
+UENUM(BlueprintType)
+enum class EDeepSeekRequestPriority : uint8
+{
+    /** 玩家正在等待的对话，优先发出 */
+    PlayerFacing,
+    
+    /** 后台生成的内容，可以延后 */
+    Background
+};
+
+/**
+ * 流式文本的投递方式
+ */
+UENUM(BlueprintType)
+enum class EDeepSeekStreamDelivery : uint8
+{
+    /** 每收到一个token立即在HTTP线程上触发OnStream */
+    Immediate,
+    
+    /** 在游戏线程上每帧合并一次，把上一帧以来收到的所有token通过一次OnStream发出 */
+    GameThreadBatched
+};
+
+/**
+ * 回答的格式
+ */
+UENUM(BlueprintType)
+enum class EDeepSeekResponseFormat : uint8
+{
+    /** 普通文本 */
+    Text,
+    
+    /**
+     * JSON对象(response_format为json_object)，提示词中需要包含"json"字样并给出字段示例
+     * 每个顶层字段的值完整时立即触发OnStructuredField
+     */
+    JsonObject
+};
+
+/**
+ * 单条消息结构体
+ */
+USTRUCT(BlueprintType)
+struct FDeepSeekMessage
+{
+    GENERATED_BODY()
+    
+    /** 消息角色 (system, user, assistant, tool) */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString Role = TEXT("user");
+    
+    /** 消息内容 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (MultiLine = true))
+    FString Content;
+    
+    /** assistant消息中模型发出的函数调用 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    TArray<FDeepSeekToolCall> ToolCalls;
+    
+    /** tool消息对应的调用Id */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString ToolCallId;
+    
+    FDeepSeekMessage() {}
+    FDeepSeekMessage(const FString& InRole, const FString& InContent)
+        : Role(InRole), Content(InContent) {}
+    FDeepSeekMessage(const FString& InRole, FString&& InContent)
+        : Role(InRole), Content(MoveTemp(InContent)) {}
+};
+
+/**
+ * 请求参数结构体
+ */
+USTRUCT(BlueprintType)
+struct FDeepSeekRequestParams
+{
+    GENERATED_BODY()
+    
+    /** API URL */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString URL = TEXT("https://api.deepseek.com/v1/chat/completions");
+    
+    /** API密钥 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString APIKey;
+    
+    /** 模型名称 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString Model = TEXT("deepseek-chat");
+    
+    /** 消息数组 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    TArray<FDeepSeekMessage> Messages;
+    
+    /** 是否使用流式响应 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    bool bStream = true;
+    
+    /** 流式文本的投递方式 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (EditCondition = "bStream"))
+    EDeepSeekStreamDelivery StreamDelivery = EDeepSeekStreamDelivery::GameThreadBatched;
+    
+    /** 合并投递时，攒够多少字符立即发出 (0表示每帧都发出) */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0", EditCondition = "bStream"))
+    int32 StreamBatchMinChars = 0;
+    
+    /** 合并投递时，文本最多等待的秒数，与StreamBatchMinChars任一满足即发出 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0.0", EditCondition = "bStream"))
+    float StreamBatchMaxLatency = 0.0f;
+    
+    /** 是否把回答按句子切分，通过OnSegment逐句发出，供TTS和字幕使用 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    bool bSegmentStream = false;
+    
+    /** 片段的最少字符数(不计空白)，过短的句子与下一句合并 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0", EditCondition = "bSegmentStream"))
+    int32 SegmentMinChars = 6;
+    
+    /** 是否在逗号、顿号、分号、冒号处切分，长句可以更早开始朗读 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (EditCondition = "bSegmentStream"))
+    bool bSegmentOnClauses = true;
+    
+    /** 一直没有遇到标点时，文本最多等待的秒数，0表示只在标点和结束时切出 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0.0", EditCondition = "bSegmentStream"))
+    float SegmentFlushTimeout = 0.0f;
+    
+    /** 温度参数 (0.0-1.0) */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+    float Temperature = 0.7f;
+    
+    /** 最大令牌数 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    int32 MaxTokens = 2048;
+    
+    /** 调试模式 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    bool bDebugMode = false;
+    
+    /**
+     * 使用响应缓存，相同的请求(URL、模型、消息、温度、最大令牌数)直接返回上次的结果
+     * 适合温度为0的确定性提示词
+     */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    bool bUseCache = false;
+    
+    /**
+     * 相同的请求正在执行时不再重复发送，而是共享它的流式输出和结果
+     * 适合同一帧内多个角色提出相同问题的情况
+     */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    bool bCoalesceInFlight = false;
+    
+    /**
+     * 模块的端点池中有端点时，每次尝试从池中选择端点，忽略URL和APIKey；池为空时仍使用URL和APIKey
+     * 重试和对冲请求会尽量换用其他端点。各端点需要提供同名的模型
+     */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    bool bUseEndpointPool = true;
+    
+    /** 调度优先级，端点并发已满时决定排队顺序 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    EDeepSeekRequestPriority Priority = EDeepSeekRequestPriority::PlayerFacing;
+    
+    /** 总超时秒数(从调用开始，包括排队)，超时后中止请求并触发OnCancelled，0表示不限制 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0.0"))
+    float TimeoutSeconds = 0.0f;
+    
+    /** 等待第一段文本的超时秒数(从调用开始)，超时后中止请求并触发OnCancelled，0表示不限制 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0.0"))
+    float FirstTokenTimeoutSeconds = 0.0f;
+    
+    /**
+     * 停止字符串，会作为stop参数发送给服务器
+     * 流式请求在本地收到停止字符串时也会立即中止传输，以之前的文本完成，结果不包含停止字符串
+     */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    TArray<FString> StopStrings;
+    
+    /** 流式回答的最大字符数，达到后立即中止传输并以已收到的文本完成，0表示不限制 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0", EditCondition = "bStream"))
+    int32 MaxResponseChars = 0;
+    
+    /**
+     * 流式请求的自定义停止条件，参数为已累积的完整文本，返回true时立即中止传输并以当前文本完成
+     * 在文本累积的线程上调用：Immediate投递时为HTTP线程，GameThreadBatched时为游戏线程
+     */
+    TFunction<bool(const FString& Text)> StopPredicate;
+    
+    /**
+     * 尚未收到任何文本就失败时的最多重试次数
+     * 只重试连接失败、408、429和5xx，重试经过调度器，仍受端点并发和限流约束
+     */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0"))
+    int32 MaxRetries = 0;
+    
+    /** 第一次重试前等待的秒数，之后每次加倍，实际等待在其一半到全部之间随机取值 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0.0"))
+    float RetryBaseDelay = 0.5f;
+    
+    /** 重试等待秒数的上限 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0.0"))
+    float RetryMaxDelay = 8.0f;
+    
+    /**
+     * 对冲请求：超过这个秒数(从调用开始)仍未收到第一段文本时，向备用端点再发出一个相同的请求，
+     * 先收到文本的一方胜出，另一方被取消。一般设为首token延迟的p95，0表示不对冲
+     */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0.0"))
+    float HedgeAfterSeconds = 0.0f;
+    
+    /** 对冲请求的API URL，为空时使用URL */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString HedgeURL;
+    
+    /** 对冲请求的API密钥，为空时使用APIKey */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString HedgeAPIKey;
+    
+    /** 模型可以调用的函数，计入缓存键 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    TArray<FDeepSeekToolDefinition> Tools;
+    
+    /** 调用函数的方式：空(服务端默认)、auto、none、required，或者直接填写要强制调用的函数名 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString ToolChoice;
+    
+    /** 回答的格式，计入缓存键 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    EDeepSeekResponseFormat ResponseFormat = EDeepSeekResponseFormat::Text;
+    
+    /**
+     * JSON回答的字段在完整时通过反射写入这个结构体的同名属性(名称不区分大小写)
+     * 在投递文本的线程上写入，调用方需保证对象在请求结束前有效；用BindStructuredOutput设置
+     */
+    const UScriptStruct* StructuredOutputStruct = nullptr;
+    void* StructuredOutputTarget = nullptr;
+    
+    template <typename StructType>
+    void BindStructuredOutput(StructType& Target)
+    {
+        ResponseFormat = EDeepSeekResponseFormat::JsonObject;
+        StructuredOutputStruct = StructType::StaticStruct();
+        StructuredOutputTarget = &Target;
+    }
+    
+    /**
+     * 预先编码好的messages数组内容(UTF-8，不含方括号，消息之间以逗号分隔)
+     * 设置后代替Messages写入请求体，只在发送请求时读取一次；之后调用方可以修改它，
+     * 需要稍后再发送的对冲请求会保存一份副本
+     */
+    TSharedPtr<const TArray<uint8>> EncodedMessages;
+};
+
+/** 响应委托 */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FDeepSeekResponse, FString, Response);
+/** 调试信息委托 */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FDeepSeekDebug, FString, Message);
+/** JSON回答的一个顶层字段完整时的委托，字符串字段为解码后的文本，其他类型为原始JSON */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FDeepSeekStructuredField, FString, FieldName, FString, Value);
+/** 回答切分出一个句子时的委托，Index从0开始连续递增 */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FDeepSeekSegment, int32, Index, FString, Segment);
+/** 模型发出函数调用时的委托 */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FDeepSeekToolCalls, const TArray<FDeepSeekToolCall>&, ToolCalls);
+/**
+ * 请求结束的原生回调，成功时Result为回答，失败时为错误信息
+ * ResponseCode为最后一次尝试的HTTP状态码，没有收到响应(连接失败、超时、取消)时为0
+ */
+DECLARE_DELEGATE_ThreeParams(FDeepSeekRequestFinished, bool /*bSuccess*/, const FString& /*Result*/, int32 /*ResponseCode*/);
+
+/**
+ * DeepSeek API异步调用节点
+ */
+UCLASS()
+class PAASAIMODULE_API UDeepSeekFunction : public UBlueprintAsyncActionBase
+{
+    GENERATED_BODY()
+
+public:
+    /** 请求完成时触发 */
+    UPROPERTY(BlueprintAssignable)
+    FDeepSeekResponse OnCompleted;
+    
+    /** 请求失败时触发 */
+    UPROPERTY(BlueprintAssignable)
+    FDeepSeekResponse OnFailed;
+    
+    /** 流式响应时触发 */
+    UPROPERTY(BlueprintAssignable)
+    FDeepSeekResponse OnStream;
+    
+    /** 请求被取消或超时时触发，参数为原因 */
+    UPROPERTY(BlueprintAssignable)
+    FDeepSeekResponse OnCancelled;
+    
+    /** 模型发出了函数调用，在OnCompleted之前触发，此时回答文本通常为空 */
+    UPROPERTY(BlueprintAssignable)
+    FDeepSeekToolCalls OnToolCalls;
+    
+    /** ResponseFormat为JsonObject时，每个顶层字段完整时触发，与OnStream在同一线程上 */
+    UPROPERTY(BlueprintAssignable)
+    FDeepSeekStructuredField OnStructuredField;
+    
+    /** bSegmentStream为true时，每切分出一个句子触发，与OnStream在同一线程上，最后一句在OnCompleted之前发出 */
+    UPROPERTY(BlueprintAssignable)
+    FDeepSeekSegment OnSegment;
+    
+    /** 调试信息 */
+    UPROPERTY(BlueprintAssignable)
+    FDeepSeekDebug OnDebugMessage;
+    
+    /** 在OnCompleted/OnFailed之后调用，供C++调用方绑定带参数的回调，回收对象时自动解绑 */
+    FDeepSeekRequestFinished OnFinishedNative;
+
+    /**
+     * 发送DeepSeek请求(高级版)
+     * 返回的对象可能被蓝图保存下来稍后调用Cancel，结束后不放回对象池，以免取消到复用它的其他请求
+     */
+    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek", meta = (BlueprintInternalUseOnly = "true"))
+    static UDeepSeekFunction* SendRequest(const FDeepSeekRequestParams& Params);
+    
+    /**
+     * 发送请求，结束后对象回收到对象池供下一个请求复用
+     * 调用方不能在OnCompleted/OnFailed所在帧之后继续持有或使用返回的指针
+     */
+    static UDeepSeekFunction* SendPooledRequest(const FDeepSeekRequestParams& Params);
+    
+    /**
+     * 快速发送请求(简化版)
+     */
+    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek", meta = (BlueprintInternalUseOnly = "true"))
+    static UDeepSeekFunction* QuickSendRequest(const FString& APIKey, const FString& Prompt, bool UseStreaming = true, bool Debug = false);
+
+    /**
+     * 发送多轮对话消息
+     */
+    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek", meta = (BlueprintInternalUseOnly = "true"))
+    static UDeepSeekFunction* SendConversationMessage(
+        const TArray<FDeepSeekMessage>& Messages, 
+        const FString& NewUserMessage,
+        const FString& APIKey, 
+        const FString& Model = TEXT("deepseek-chat"),
+        bool UseStreaming = true, 
+        bool Debug = true);
+
+    /**
+     * 取消请求，立即中止HTTP传输并释放调度名额，触发OnCancelled；请求已经结束时没有效果
+     * 蓝图节点返回的对象不会被复用，结束后再调用也不会影响其他请求
+     */
+    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
+    void Cancel();
+    
+    // 获取流式传输的完整文本
+    // 请求对象结束后会被回收复用，不要在OnCompleted/OnFailed所在帧之后继续持有
+    UFUNCTION(BlueprintPure, Category = "AI|DeepSeek")
+    const FString& GetFullStreamedText() const { return AccumulatedStreamText; }
+    
+    // 获取模型发出的函数调用，流式请求在完成后才是完整的
+    UFUNCTION(BlueprintPure, Category = "AI|DeepSeek")
+    const TArray<FDeepSeekToolCall>& GetToolCalls() const { return ToolCalls; }
+    
+    // 获取本次请求的性能指标，请求进行中调用时返回当前的值
+    UFUNCTION(BlueprintPure, Category = "AI|DeepSeek")
+    FDeepSeekRequestMetrics GetMetrics() const { return Metrics.GetSnapshot(); }
+    
+    /** 失败的请求是否值得重试：没有收到响应、408、429和5xx，参数和鉴权等4xx错误重试也不会成功 */
+    static bool IsRetryableResponseCode(int32 ResponseCode);
+    
+    // 析构函数，确保对象从根集中移除
+    virtual void BeginDestroy() override;
+
+protected:
+    friend class FDeepSeekRequestPool;
+    
+    void ExecuteRequest(const FDeepSeekRequestParams& Params);
+    
+    // 创建HTTP请求并通过调度器发出，每次重试都重新调用
+    void StartAttempt(TArray<uint8>&& RequestBody);
+    
+    // 本次尝试结束，释放HTTP请求和调度名额，请求对象继续等待结果
+    void ReleaseAttempt();
+    
+    // 放弃正在进行的尝试，已经发出时由HTTP完成回调释放
+    void AbandonAttempt();
+    
+    // 向端点池报告本次尝试的结果，失败的端点在重试时尽量避开
+    void ReleaseEndpoint(FDeepSeekEndpointPool::EOutcome Outcome);
+    FDeepSeekEndpointPool::EOutcome ClassifyAttempt(const FHttpResponsePtr& Response, bool bWasSuccessful) const;
+    
+    // 失败的尝试按退避时间重试，不满足重试条件时返回false
+    bool TryScheduleRetry(const FHttpResponsePtr& Response, bool bWasSuccessful);
+    void LogDebug(const FString& Message, bool bIsError = false);
+    bool ShouldLogToken();
+    bool HandleStreamData(FUtf8StringView EventData);
+    
+    // 流式请求结束时根据流状态完成或失败，不读取响应体
+    void FinishStreamResponse(const FHttpResponsePtr& Response, bool bWasSuccessful);
+    FString ExtractContentFromResponse(const FString& ResponseString);
+    
+    // 结束请求并通知合并到本请求的其他请求
+    void CompleteRequest(const FString& Result);
+    void FailRequest(const FString& ErrorMessage);
+    void CancelRequest(const FString& Reason);
+    
+    // 超时检查
+    bool TickDeadline(float DeltaTime);
+    
+    // 在HTTP线程上检查停止字符串和最大字符数，必要时截断Delta，返回true表示应停止接收
+    bool ApplyStopConditions(FString& Delta);
+    
+    // 文本达到停止条件后结束流并中止传输
+    void StopStream();
+    
+    // 对冲请求：先收到文本的一方胜出，可在任意线程调用
+    bool ClaimHedgeRace();
+    void LaunchHedge();
+    void CancelHedge();
+    
+    // 原请求失败时改为等待仍在进行的对冲请求
+    bool YieldToHedge();
+    
+    // 对冲请求胜出后，它的输出和结果转交给原请求
+    UFUNCTION()
+    void HandleHedgeStream(FString Delta);
+    void HandleHedgeFinished(bool bSuccess, const FString& Result, int32 ResponseCode);
+    
+    // 请求合并
+    void UnregisterInFlight();
+    bool AttachFollower(UDeepSeekFunction* Follower, bool bFollowerStream);
+    void ForwardStreamToFollowers(const FString& Content);
+    void ForwardResultToFollowers(bool bSuccess, const FString& Result);
+    bool TickFollower(float DeltaTime);
+    
+    // 游戏线程合并投递
+    bool TickStreamDelivery(float DeltaTime);
+    void FlushStreamDeltas(bool bForce);
+    bool IsStreamBatched() const { return bBatchStreamDelivery; }
+    
+    // 更新流式文本缓冲区的内存统计
+    void UpdateStreamBufferStats();
+    
+    // 成功的响应写入缓存
+    void StoreInCache(const FHttpResponsePtr& Response, const FString& Content) const;
+    
+    // 下一帧通过OnStream和OnCompleted回放缓存的响应
+    void ReplayCachedResponse(FString&& CachedResponse, bool bStream);
+    
+    // 在后台线程读取磁盘缓存，读取失败时照常发出请求
+    void LoadCachedResponse(FString&& DiskPath, const FDeepSeekRequestParams& Params, TArray<uint8>&& RequestBody);
+    
+    // 缓存未命中后，合并到相同的请求或交给调度器发出
+    void DispatchRequest(const FDeepSeekRequestParams& Params, TArray<uint8>&& RequestBody);
+    
+    // 从根集中移除自身的安全方法
+    void SafeRemoveFromRoot();
+    
+    // 请求结束时释放HTTP请求、调度名额和对象引用
+    void ReleaseRequest();
+    
+    // 回收到对象池前清除委托绑定和请求状态，保留缓冲区容量
+    void ResetForReuse();
+    
+    // 按参数执行请求，bRecyclable为false时结束后交给垃圾回收
+    static UDeepSeekFunction* SendRequestInternal(const FDeepSeekRequestParams& Params, bool bInRecyclable);
+    bool bRecyclable = true;
+    
+    bool bDebug = false;
+    std::atomic<uint32> TokenLogCounter { 0 };
+    FString AccumulatedStreamText;
+    bool bIsRequestComplete = false;
+    bool bIsBeingDestroyed = false;
+    
+    // 流式响应的增量SSE解析器
+    FDeepSeekSSEParser StreamParser;
+    
+    // 复用的增量数据块解析结果
+    FDeepSeekStreamDelta StreamDelta;
+    
+    // 合并投递：HTTP线程写入，游戏线程每帧取出
+    bool bBatchStreamDelivery = false;
+    TQueue<FString, EQueueMode::Spsc> PendingDeltas;
+    FTSTicker::FDelegateHandle StreamDeliveryTicker;
+    FString PendingBatch;
+    double PendingBatchStartTime = 0.0;
+    int32 StreamBatchMinChars = 0;
+    double StreamBatchMaxLatency = 0.0;
+    
+    // HTTP线程收到结束标记或错误后，交给游戏线程结束请求
+    std::atomic<bool> bStreamEndSignalled { false };
+    FString StreamEndError;
+    
+    // 流式请求的状态：收到[DONE]或finish_reason后视为正常结束
+    bool bStreamResponse = false;
+    std::atomic<bool> bStreamFinished { false };
+    
+    // 请求性能指标
+    FDeepSeekMetricsRecorder Metrics;
+    
+    // 已经调用ProcessRequest，中止时需要等待HTTP完成回调来释放
+    bool bHttpStarted = false;
+    
+    // 超时设置
+    FTSTicker::FDelegateHandle DeadlineTicker;
+    double RequestStartTime = 0.0;
+    float TimeoutSeconds = 0.0f;
+    float FirstTokenTimeoutSeconds = 0.0f;
+    
+    // 缓存回放或跟随原请求的延迟回调
+    FTSTicker::FDelegateHandle DeferredTicker;
+    
+    // 停止条件，StopScanTail和StreamCharsReceived只在HTTP线程上使用
+    TArray<FString> StopStrings;
+    int32 MaxStopStringLen = 0;
+    FString StopScanTail;
+    int32 MaxResponseChars = 0;
+    int32 StreamCharsReceived = 0;
+    TFunction<bool(const FString&)> StopPredicate;
+    
+    // 函数调用，流式片段在接收数据的线程上按下标直接追加，不重新解析已收到的参数
+    TArray<FDeepSeekToolCall> ToolCalls;
+    void AppendToolCallFragments();
+    void ExtractToolCalls(const TSharedPtr<FJsonObject>& MessageObject);
+    
+    // 结构化输出：在投递文本的线程上增量解析，字段完整时触发委托并写入绑定的结构体
+    bool bStructuredOutput = false;
+    FDeepSeekStructuredOutputParser StructuredParser;
+    const UScriptStruct* StructuredOutputStruct = nullptr;
+    void* StructuredOutputTarget = nullptr;
+    void FeedStructuredOutput(FStringView Text);
+    void HandleStructuredField(const FString& Name, const FString& RawValue);
+    
+    // 分句：与结构化输出在同一处输入文本，只缓存尚未切出的部分
+    bool bSegmentStream = false;
+    FDeepSeekSentenceSegmenter Segmenter;
+    void FeedSegmenter(FStringView Text);
+    void BroadcastSegment(int32 Index, const FString& Segment);
+    
+    // 重试：每次尝试发送相同的请求体
+    FString RequestURL;
+    FString RequestAPIKey;
+    EDeepSeekRequestPriority RequestPriority = EDeepSeekRequestPriority::PlayerFacing;
+    TArray<uint8> RetryBody;
+    int32 MaxRetries = 0;
+    int32 RetryCount = 0;
+    float RetryBaseDelay = 0.0f;
+    float RetryMaxDelay = 0.0f;
+    
+    // 端点池：本次尝试占用的端点，以及重试和对冲时尽量避开的端点
+    bool bUseEndpointPool = false;
+    int32 EndpointLeaseId = INDEX_NONE;
+    int32 ExcludedEndpointId = INDEX_NONE;
+    
+    // 对冲：原请求和对冲请求共享HedgeRace，记录先收到文本的一方的HedgeSlot
+    float HedgeAfterSeconds = 0.0f;
+    TOptional<FDeepSeekRequestParams> HedgeParams;
+    TWeakObjectPtr<UDeepSeekFunction> HedgeRequest;
+    TSharedPtr<std::atomic<int32>, ESPMode::ThreadSafe> HedgeRace;
+    int32 HedgeSlot = 0;
+    bool bHedgeLaunched = false;
+    bool bHedgeWon = false;
+    
+    // 指向HTTP请求的强引用，防止被垃圾回收
+    TSharedPtr<IHttpRequest, ESPMode::ThreadSafe> HttpRequestRef;
+    
+    // 在模块调度器中的句柄
+    uint64 SchedulerHandle = 0;
+    
+    // 本次尝试的URL，用于估计连接复用；请求发出后到结束前bConnectionOpen为true
+    FString ConnectionURL;
+    bool bConnectionOpen = false;
+    void BeginConnection();
+    void EndConnection(bool bConnectionKept);
+    
+    // 限流用的端点标识和预估token数
+    FString EndpointKey;
+    int32 EstimatedTokens = 0;
+    
+    // 规范化请求体的哈希，用于响应缓存和请求合并
+    uint64 RequestHash = 0;
+    bool bStoreInCache = false;
+    
+    // 每次执行请求时递增，后台任务回到游戏线程时据此判断对象是否已被复用
+    uint32 RequestSerial = 0;
+    
+    // 作为原请求时，合并到本请求的其他请求
+    bool bIsInFlightLeader = false;
+    TArray<TWeakObjectPtr<UDeepSeekFunction>> Followers;
+    
+    // 作为跟随者时的状态，由FollowersLock保护
+    TWeakObjectPtr<UDeepSeekFunction> InFlightLeader;
+    bool bFollowerStream = true;
+    bool bFollowerReady = false;
+    bool bLeaderFinished = false;
+    bool bLeaderSucceeded = false;
+    FString LeaderResult;
+    FCriticalSection FollowersLock;
+    
+    // 流中usage报告的实际token数
+    int32 ReportedTotalTokens = 0;
+    
+    // 最后一次尝试的HTTP状态码，通过OnFinishedNative交给调用方
+    int32 LastResponseCode = 0;
+};
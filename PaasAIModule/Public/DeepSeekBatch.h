@@ -0,0 +1,107 @@
+﻿// DeepSeekBatch.h
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "AIFunction.h"
+#include "DeepSeekBatch.generated.h"
+
+/** 单个条目结束，Index为条目在输入数组中的下标 */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FDeepSeekBatchItemCompleted, int32, Index, bool, bSuccess, const FString&, Result);
+/** 整体进度 */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FDeepSeekBatchProgress, int32, Finished, int32, Total);
+/** 全部条目结束 */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FDeepSeekBatchCompleted, int32, Succeeded, int32, Failed);
+/** 全部条目结束的原生回调 */
+DECLARE_DELEGATE_TwoParams(FDeepSeekBatchFinished, int32 /*Succeeded*/, int32 /*Failed*/);
+
+/**
+ * 批量发送互相独立的请求
+ * 所有条目共用一个异步节点和一组委托，以有限的并发通过模块调度器发出，失败的条目按指数退避重试。
+ * 条目总是以非流式请求发送，结果按输入顺序保存，可在结束后通过GetResults读取
+ */
+UCLASS()
+class PAASAIMODULE_API UDeepSeekBatch : public UBlueprintAsyncActionBase
+{
+    GENERATED_BODY()
+
+public:
+    /** 每个条目结束时触发 */
+    UPROPERTY(BlueprintAssignable)
+    FDeepSeekBatchItemCompleted OnItemCompleted;
+
+    /** 每个条目结束后触发，报告已结束的条目数 */
+    UPROPERTY(BlueprintAssignable)
+    FDeepSeekBatchProgress OnProgress;
+
+    /** 全部条目结束时触发 */
+    UPROPERTY(BlueprintAssignable)
+    FDeepSeekBatchCompleted OnCompleted;
+
+    /** 在OnCompleted之后调用，供C++调用方绑定 */
+    FDeepSeekBatchFinished OnCompletedNative;
+
+    /**
+     * 批量发送请求
+     * @param InMaxConcurrency 同时执行的条目数上限，端点并发仍受模块调度器限制
+     * @param InMaxRetries 每个条目失败后的最多重试次数
+     */
+    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek", meta = (BlueprintInternalUseOnly = "true"))
+    static UDeepSeekBatch* SendBatchRequest(const TArray<FDeepSeekRequestParams>& InItems, int32 InMaxConcurrency = 8, int32 InMaxRetries = 2);
+
+    /**
+     * 用相同的设置批量发送单轮提示词
+     */
+    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek", meta = (BlueprintInternalUseOnly = "true"))
+    static UDeepSeekBatch* QuickSendBatch(
+        const FString& APIKey,
+        const TArray<FString>& Prompts,
+        const FString& SystemPrompt = TEXT(""),
+        const FString& Model = TEXT("deepseek-chat"),
+        int32 InMaxConcurrency = 8);
+
+    /** 停止发出尚未开始的条目，它们以失败结束；已经发出的条目照常完成 */
+    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
+    void Cancel();
+
+    /** 各条目的结果，与输入顺序一致，失败的条目为错误信息 */
+    UFUNCTION(BlueprintPure, Category = "AI|DeepSeek")
+    const TArray<FString>& GetResults() const { return Results; }
+
+    /**
+     * 写出离线批处理文件(JSONL，每行一个请求，兼容OpenAI Batch API格式)
+     * custom_id为"item-<下标>"，供提供批处理接口的服务离线执行
+     */
+    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
+    static bool WriteBatchFile(const TArray<FDeepSeekRequestParams>& InItems, const FString& FilePath);
+
+    /**
+     * 读取离线批处理的结果文件，按custom_id把回答放回对应下标
+     * @param ItemCount 输入条目数，结果中缺失或失败的条目以空字符串返回
+     */
+    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
+    static bool ReadBatchResultFile(const FString& FilePath, int32 ItemCount, TArray<FString>& OutResults, TArray<bool>& OutSucceeded);
+
+    //~ UBlueprintAsyncActionBase
+    virtual void Activate() override;
+
+private:
+    void Pump();
+    void LaunchItem(int32 Index);
+    void HandleItemFinished(bool bSuccess, const FString& Result, int32 ResponseCode, int32 Index);
+    void FinishItem(int32 Index, bool bSuccess, const FString& Result);
+
+    TArray<FDeepSeekRequestParams> Items;
+    TArray<FString> Results;
+    TArray<uint8> Attempts;
+
+    int32 MaxConcurrency = 8;
+    int32 MaxRetries = 2;
+
+    int32 NextItem = 0;
+    int32 NumInFlight = 0;
+    int32 NumFinished = 0;
+    int32 NumSucceeded = 0;
+    bool bActivated = false;
+    bool bCancelled = false;
+};
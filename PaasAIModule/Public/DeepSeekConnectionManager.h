@@ -0,0 +1,137 @@
+﻿// DeepSeekConnectionManager.h
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "DeepSeekConnectionManager.generated.h"
+
+/**
+ * 一个源站(协议 + 主机 + 端口)的连接状况
+ */
+USTRUCT(BlueprintType)
+struct FDeepSeekConnectionStats
+{
+    GENERATED_BODY()
+
+    /** 例如https://api.deepseek.com */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    FString Origin;
+
+    /** 估计仍保持着的空闲连接数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    int32 IdleConnections = 0;
+
+    /** 发出时有空闲连接可用、不需要重新握手的请求数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    int32 ReusedRequests = 0;
+
+    /** 发出时没有空闲连接、需要重新建立连接的请求数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    int32 NewConnectionRequests = 0;
+
+    /** 预热和保活发出的探测请求数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    int32 Prewarms = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    int32 KeepAlivePings = 0;
+
+    /** 最近一次预热的耗时(毫秒)，大致等于DNS + TCP + TLS握手的时间 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    float LastPrewarmMs = 0.0f;
+};
+
+/**
+ * 模块级的连接管理
+ * 引擎的HTTP模块(libcurl)在内部复用到同一源站的连接，但不对外暴露连接池，也不能从插件指定HTTP版本：
+ * 是否通过ALPN协商HTTP/2并在一个连接上复用多个流由引擎的HTTP后端决定。这里在此基础上
+ * 1. 启动或加载关卡时向已知端点发出HEAD请求，提前完成DNS、TCP和TLS握手；
+ * 2. 定期用HEAD请求触碰空闲的连接，避免被服务器的keep-alive超时关闭；
+ * 3. 按请求发出和结束的时间估计每个源站的空闲连接数，记录请求是否复用了连接。
+ */
+class PAASAIMODULE_API FDeepSeekConnectionManager
+{
+public:
+    FDeepSeekConnectionManager();
+    ~FDeepSeekConnectionManager();
+
+    /**
+     * @param ConnectionsPerOrigin 每个源站预热的连接数，HTTP/1.1时同时进行的流式请求各占一个连接
+     * @param KeepAliveSeconds 空闲连接的保活间隔，0表示不保活；应小于服务器的keep-alive超时
+     * @param IdleTimeoutSeconds 没有保活时空闲连接被认为仍然有效的秒数
+     * @param MaxIdleSeconds 超过这个秒数没有真实请求后停止保活，0表示一直保活
+     */
+    void Configure(int32 ConnectionsPerOrigin, float KeepAliveSeconds, float IdleTimeoutSeconds, float MaxIdleSeconds);
+
+    /** 登记一个端点，之后预热和保活都会覆盖它的源站 */
+    void AddOrigin(const FString& URL);
+
+    /** 预热指定URL的源站，URL为空时预热所有已知的源站；已有足够空闲连接的源站不再预热 */
+    void Prewarm(const FString& URL = FString());
+
+    /**
+     * 请求即将发出，源站尚未登记时自动登记
+     * @return 是否有空闲的连接可以复用
+     */
+    bool NoteRequestStarted(const FString& URL);
+
+    /**
+     * 请求结束
+     * @param bConnectionKept 是否完整收到了响应，中途取消或连接失败时连接不会回到连接池
+     */
+    void NoteRequestFinished(const FString& URL, bool bConnectionKept);
+
+    TArray<FDeepSeekConnectionStats> GetStats() const;
+
+    /** 从URL中取出协议、主机和端口，统一为小写 */
+    static FString GetOrigin(const FString& URL);
+
+private:
+    struct FOrigin
+    {
+        FString URL;
+        int32 Idle = 0;
+        int32 Probing = 0;
+        double LastIdleTime = 0.0;
+        double LastRequestTime = 0.0;
+        FDeepSeekConnectionStats Stats;
+    };
+
+    FOrigin& FindOrAddOrigin(const FString& URL, const FString& Origin);
+
+    // 空闲时间超过超时的连接视为已被关闭
+    void ExpireIdle(FOrigin& Entry, double Now) const;
+
+    void SendProbe(const FString& Origin, FOrigin& Entry, bool bKeepAlive);
+    void HandleProbeFinished(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful, FString Origin, bool bKeepAlive, double SentTime);
+    bool Tick(float DeltaTime);
+
+    mutable FCriticalSection Lock;
+    TMap<FString, FOrigin> Origins;
+    TArray<FHttpRequestPtr> Probes;
+    FTSTicker::FDelegateHandle TickerHandle;
+
+    int32 ConnectionsPerOrigin = 1;
+    double KeepAliveSeconds = 0.0;
+    double IdleTimeoutSeconds = 60.0;
+    double MaxIdleSeconds = 0.0;
+};
+
+/**
+ * 在蓝图中预热连接和查看连接复用情况
+ */
+UCLASS()
+class PAASAIMODULE_API UDeepSeekConnectionLibrary : public UBlueprintFunctionLibrary
+{
+    GENERATED_BODY()
+
+public:
+    /** 预热到指定URL的连接，URL为空时预热所有端点；适合在加载界面结束前调用 */
+    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek|Connections")
+    static void PrewarmConnections(const FString& URL);
+
+    UFUNCTION(BlueprintPure, Category = "AI|DeepSeek|Connections")
+    static TArray<FDeepSeekConnectionStats> GetConnectionStats();
+};
@@ -0,0 +1,103 @@
+﻿// DeepSeekContextWindow.h
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FDeepSeekMessage;
+
+/**
+ * 对话上下文窗口
+ * 缓存每条消息的token估算值，超出预算时按完整轮次淘汰最早的消息；
+ * 开头的系统提示始终保留，被淘汰的轮次可以用一条摘要代替。
+ * 维护窗口内消息的UTF-8编码，可直接作为请求的EncodedMessages发送
+ *
+ * 编码只追加不重写，两次淘汰之间每轮请求的前缀字节完全相同，可以命中服务端的前缀缓存；
+ * 前缀稳定模式下一次淘汰到预算的较低水位，并把摘要推迟到下一次淘汰时再加入，减少前缀失效的次数
+ */
+class PAASAIMODULE_API FDeepSeekContextWindow
+{
+public:
+    FDeepSeekContextWindow();
+
+    /** 本地估算文本的token数，不需要分词器 */
+    static int32 EstimateTokens(FStringView Text);
+
+    /** 估算单条消息的token数，包括角色等格式开销 */
+    static int32 EstimateMessageTokens(const FDeepSeekMessage& Message);
+
+    /** 上下文的token预算，0表示不限制 */
+    void SetTokenBudget(int32 InTokenBudget) { TokenBudget = FMath::Max(0, InTokenBudget); }
+    int32 GetTokenBudget() const { return TokenBudget; }
+
+    /** 前缀稳定模式，一次淘汰较多轮次，摘要在下一次淘汰时才生效 */
+    void SetPrefixStable(bool bInPrefixStable) { bPrefixStable = bInPrefixStable; }
+
+    /** 已发送的前缀被重写的次数，每次都会使服务端的前缀缓存失效 */
+    int32 GetPrefixInvalidations() const { return PrefixInvalidations; }
+
+    /** 清空所有消息和摘要 */
+    void Reset();
+
+    /** 历史中追加了一条消息，必须与历史数组保持同步调用 */
+    void Append(const FDeepSeekMessage& Message);
+
+    /**
+     * 超出预算时从窗口开头淘汰完整的轮次，最新的一轮总是保留
+     * @return 是否淘汰了消息
+     */
+    bool Trim(const TArray<FDeepSeekMessage>& History);
+
+    /**
+     * 用摘要代替历史中SummarizedEnd之前被淘汰的消息
+     * 摘要的token数也计入预算，超出时会继续淘汰；前缀稳定模式下推迟到下一次淘汰时生效
+     */
+    void SetSummary(FString&& InSummary, int32 InSummarizedEnd, const TArray<FDeepSeekMessage>& History);
+
+    /** 窗口内消息的编码，格式与FDeepSeekRequestParams::EncodedMessages相同 */
+    TSharedPtr<const TArray<uint8>> GetEncodedMessages() const { return Encoded; }
+
+    /** 当前发送的上下文的估算token数 */
+    int32 GetContextTokens() const { return PinnedTokens + SummaryTokens + WindowTokens; }
+
+    /** 窗口中第一条未被淘汰的非固定消息在历史中的下标 */
+    int32 GetWindowStart() const { return WindowStart; }
+
+    /** 已被摘要覆盖的历史范围的结束下标 */
+    int32 GetSummarizedEnd() const { return SummarizedEnd; }
+    const FString& GetSummary() const { return Summary; }
+
+    /** 包括尚未生效的摘要 */
+    const FString& GetLatestSummary() const { return PendingSummary.IsEmpty() ? Summary : PendingSummary; }
+    int32 GetLatestSummarizedEnd() const { return PendingSummary.IsEmpty() ? SummarizedEnd : PendingSummarizedEnd; }
+
+private:
+    void Rebuild(const TArray<FDeepSeekMessage>& History);
+    void ApplySummary(FString&& InSummary, int32 InSummarizedEnd);
+    void AppendEncoded(const FDeepSeekMessage& Message);
+
+    // 每条历史消息的token估算值，与历史数组一一对应
+    TArray<int32> MessageTokens;
+
+    // 窗口内消息的UTF-8编码
+    TSharedPtr<TArray<uint8>> Encoded;
+
+    // 开头固定保留的系统提示条数(0或1)
+    int32 PinnedCount = 0;
+    int32 PinnedTokens = 0;
+
+    int32 WindowStart = 0;
+    int32 WindowTokens = 0;
+
+    // 被淘汰轮次的摘要
+    FString Summary;
+    int32 SummaryTokens = 0;
+    int32 SummarizedEnd = 0;
+
+    // 前缀稳定模式下等待下一次淘汰的摘要
+    FString PendingSummary;
+    int32 PendingSummarizedEnd = 0;
+
+    int32 TokenBudget = 0;
+    bool bPrefixStable = false;
+    int32 PrefixInvalidations = 0;
+};
@@ -0,0 +1,246 @@
+﻿// DeepSeekEndpointPool.h
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "DeepSeekEndpointPool.generated.h"
+
+/**
+ * 端点的选择策略
+ */
+UENUM(BlueprintType)
+enum class EDeepSeekRoutingPolicy : uint8
+{
+    /** 选择按权重折算后执行中请求最少的端点，相同时选择延迟较低的 */
+    LeastOutstanding,
+
+    /** 按权重除以平滑延迟随机选择，错误率高的端点按比例减少流量 */
+    LatencyWeighted
+};
+
+/**
+ * 熔断器状态
+ */
+UENUM(BlueprintType)
+enum class EDeepSeekCircuitState : uint8
+{
+    /** 正常接收请求 */
+    Closed,
+
+    /** 连续失败后暂停使用，冷却结束前不再分配请求 */
+    Open,
+
+    /** 冷却结束，只放行一个探测请求，成功后恢复 */
+    HalfOpen
+};
+
+/**
+ * 一个OpenAI兼容的端点(URL + API密钥)
+ */
+USTRUCT(BlueprintType)
+struct FDeepSeekEndpointConfig
+{
+    GENERATED_BODY()
+
+    /** 端点名称，用于删除和统计 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString Name;
+
+    /** chat/completions的完整URL */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString URL = TEXT("https://api.deepseek.com/v1/chat/completions");
+
+    /** API密钥 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString APIKey;
+
+    /** 相对权重，权重越大分到的请求越多 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0.01"))
+    float Weight = 1.0f;
+
+    /** 最大并发数，同时作为调度器的端点并发上限，0表示使用调度器的默认值 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (ClampMin = "0"))
+    int32 MaxInFlight = 0;
+
+    /** 只在其他端点全部熔断或并发已满时使用，例如自建的溢出服务器 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    bool bOverflowOnly = false;
+};
+
+/**
+ * 端点的健康状况
+ */
+USTRUCT(BlueprintType)
+struct FDeepSeekEndpointStats
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    FString Name;
+
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    FString URL;
+
+    /** 当前执行中的请求数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    int32 Outstanding = 0;
+
+    /** 首字节延迟的指数加权平均(毫秒)，还没有样本时为0 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    float LatencyMs = 0.0f;
+
+    /** 错误率的指数加权平均 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    float ErrorRate = 0.0f;
+
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    EDeepSeekCircuitState CircuitState = EDeepSeekCircuitState::Closed;
+
+    /** 累计分配的请求数和失败数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    int32 TotalRequests = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek")
+    int32 TotalFailures = 0;
+};
+
+/**
+ * 模块级的端点池
+ * 请求在每次尝试发出前从池中选择端点，结束时报告结果；池为空时请求使用参数中的URL和APIKey。
+ * 连续失败的端点熔断一段时间，冷却后放行一个探测请求，成功后恢复
+ */
+class PAASAIMODULE_API FDeepSeekEndpointPool
+{
+public:
+    /** 一次尝试的结果 */
+    enum class EOutcome : uint8
+    {
+        Succeeded,
+
+        /** 连接失败、鉴权失败、超时、限流或服务器错误，计入错误率和熔断 */
+        Failed,
+
+        /** 本地中止或请求本身有误，不影响端点的健康状况 */
+        Abandoned
+    };
+
+    /** 选择端点的结果 */
+    enum class EAcquireResult : uint8
+    {
+        Acquired,
+
+        /** 池为空，请求使用参数中的URL和APIKey */
+        Empty,
+
+        /** 所有端点都已熔断或正在探测，等待后再选择 */
+        Unavailable
+    };
+
+    /** 选中的端点 */
+    struct FLease
+    {
+        int32 EndpointId = INDEX_NONE;
+        FString URL;
+        FString APIKey;
+    };
+
+    /** 添加端点，同名端点会被替换 */
+    void AddEndpoint(const FDeepSeekEndpointConfig& Config);
+
+    /** 删除端点，执行中的请求照常结束 */
+    bool RemoveEndpoint(const FString& Name);
+
+    void Empty();
+
+    bool IsEmpty() const;
+
+    void SetPolicy(EDeepSeekRoutingPolicy InPolicy);
+
+    /**
+     * 熔断参数
+     * @param FailureThreshold 连续失败多少次后熔断
+     * @param CooldownSeconds 熔断后的冷却秒数，探测再次失败时加倍，最多为8倍
+     */
+    void SetCircuitBreaker(int32 FailureThreshold, float CooldownSeconds);
+
+    /**
+     * 为一次尝试选择端点
+     * 熔断的端点冷却结束后只放行一个探测请求；所有端点都在冷却或探测中时不分配，由调用方等待后再选择
+     * @param ExcludeId 尽量避开的端点，用于重试和对冲请求换用其他端点
+     * @param OutWaitSeconds 返回Unavailable时，距离最早一个端点结束冷却的秒数
+     */
+    EAcquireResult Acquire(FLease& OutLease, int32 ExcludeId, double& OutWaitSeconds);
+
+    /**
+     * 尝试结束，每次Acquire对应一次Release
+     * @param LatencySeconds 首字节延迟，小于等于0表示没有样本
+     */
+    void Release(int32 EndpointId, EOutcome Outcome, double LatencySeconds = 0.0);
+
+    TArray<FDeepSeekEndpointStats> GetStats() const;
+
+private:
+    struct FEndpoint
+    {
+        int32 Id = INDEX_NONE;
+        FDeepSeekEndpointConfig Config;
+
+        int32 Outstanding = 0;
+        double LatencyEwma = 0.0;
+        double ErrorEwma = 0.0;
+        int32 TotalRequests = 0;
+        int32 TotalFailures = 0;
+
+        EDeepSeekCircuitState State = EDeepSeekCircuitState::Closed;
+        int32 ConsecutiveFailures = 0;
+        int32 Trips = 0;
+        double OpenUntil = 0.0;
+        bool bProbeInFlight = false;
+    };
+
+    // 端点现在能否接收请求，冷却结束的熔断端点转为半开
+    bool IsAvailable(FEndpoint& Endpoint, double Now);
+    bool HasCapacity(const FEndpoint& Endpoint) const;
+    int32 SelectLeastOutstanding(const TArray<int32>& Candidates) const;
+    int32 SelectLatencyWeighted(const TArray<int32>& Candidates) const;
+    void Trip(FEndpoint& Endpoint, double Now);
+
+    mutable FCriticalSection Lock;
+    TArray<FEndpoint> Endpoints;
+    int32 NextId = 1;
+
+    EDeepSeekRoutingPolicy Policy = EDeepSeekRoutingPolicy::LeastOutstanding;
+    int32 FailureThreshold = 5;
+    double CooldownSeconds = 30.0;
+};
+
+/**
+ * 在蓝图中管理模块的端点池
+ */
+UCLASS()
+class PAASAIMODULE_API UDeepSeekEndpointLibrary : public UBlueprintFunctionLibrary
+{
+    GENERATED_BODY()
+
+public:
+    /** 添加端点，同名端点会被替换；之后所有启用bUseEndpointPool的请求都从池中选择端点 */
+    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek|Endpoints")
+    static void AddEndpoint(const FDeepSeekEndpointConfig& Config);
+
+    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek|Endpoints")
+    static bool RemoveEndpoint(const FString& Name);
+
+    /** 清空端点池，请求恢复使用参数中的URL和APIKey */
+    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek|Endpoints")
+    static void ClearEndpoints();
+
+    UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek|Endpoints")
+    static void SetRoutingPolicy(EDeepSeekRoutingPolicy Policy);
+
+    UFUNCTION(BlueprintPure, Category = "AI|DeepSeek|Endpoints")
+    static TArray<FDeepSeekEndpointStats> GetEndpointStats();
+
+    /** 端点池中是否有端点 */
+    UFUNCTION(BlueprintPure, Category = "AI|DeepSeek|Endpoints")
+    static bool HasEndpoints();
+};
@@ -0,0 +1,58 @@
+﻿// DeepSeekJsonScanner.h
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * 轻量的UTF-8 JSON拉取式扫描器
+ * 直接在原始字节上按需读取字段，不构建FJsonObject树，也不做任何共享指针分配
+ * 只用于解析服务器返回的已知格式数据，对格式的校验较宽松
+ */
+class PAASAIMODULE_API FDeepSeekJsonScanner
+{
+public:
+    explicit FDeepSeekJsonScanner(FUtf8StringView InJson);
+
+    /** 读取'{'，进入对象 */
+    bool BeginObject();
+
+    /** 读取对象的下一个键(原始字节，不解码转义)，遇到'}'时返回false并退出对象 */
+    bool NextKey(FUtf8StringView& OutKey);
+
+    /** 读取'['，进入数组 */
+    bool BeginArray();
+
+    /** 数组中还有元素时返回true，遇到']'时返回false并退出数组 */
+    bool NextElement();
+
+    /** 读取字符串值并解码追加到Out，值为null时返回false */
+    bool ReadString(FString& Out);
+
+    /** 读取整数值，值为null或不是数字时返回false */
+    bool ReadInteger(int64& OutValue);
+
+    /** 下一个值是否为null，是则跳过 */
+    bool TryReadNull();
+
+    /** 下一个值的首字符，用于判断类型 */
+    UTF8CHAR PeekValue();
+
+    /** 跳过任意一个值(包括嵌套的对象和数组) */
+    bool SkipValue();
+
+    /** 是否遇到了格式错误或提前结束 */
+    bool HasError() const { return bError; }
+
+    /** 把JSON字符串内容(不含引号)解码追加到Out */
+    static void AppendUnescaped(FString& Out, const UTF8CHAR* Begin, const UTF8CHAR* End);
+
+private:
+    void SkipWhitespace();
+    bool Expect(ANSICHAR Char);
+    bool ScanString(const UTF8CHAR*& OutBegin, const UTF8CHAR*& OutEnd);
+    bool Fail();
+
+    const UTF8CHAR* Cursor;
+    const UTF8CHAR* End;
+    bool bError = false;
+};
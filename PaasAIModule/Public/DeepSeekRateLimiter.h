@@ -0,0 +1,68 @@
+﻿// DeepSeekRateLimiter.h
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IHttpResponse;
+
+/**
+ * 按端点统计的令牌桶限流器
+ * 同时限制每分钟请求数和每分钟token数，并根据服务器返回的x-ratelimit-*和Retry-After头修正预算
+ */
+class PAASAIMODULE_API FDeepSeekRateLimiter
+{
+public:
+    /**
+     * 尝试为一次请求占用预算
+     * @return 0表示已占用可以立即发出，否则为建议等待的秒数
+     */
+    double TryAcquire(const FString& EndpointKey, int32 EstimatedTokens, double Now);
+    
+    /** 根据响应头更新端点的限额、剩余量和冷却时间 */
+    void UpdateFromResponse(const FString& EndpointKey, const IHttpResponse& Response, double Now);
+    
+    /** 请求结束后用实际消耗修正token预算 */
+    void ReportTokenUsage(const FString& EndpointKey, int32 EstimatedTokens, int32 ActualTokens);
+    
+    /** 未从响应头学到限额前使用的默认值，0表示不限制 */
+    void SetDefaultLimits(int32 RequestsPerMinute, int32 TokensPerMinute);
+    
+    /** 估算请求会消耗的token数(提示词按字节粗略估算，加上最大输出数) */
+    static int32 EstimateRequestTokens(int32 RequestBodyBytes, int32 MaxTokens);
+    
+    /** 解析"1s"、"6m0s"、"20ms"或纯数字格式的时长，单位秒 */
+    static double ParseDuration(const FString& Value);
+
+private:
+    struct FBucket
+    {
+        /** 每分钟限额，0表示不限制 */
+        double Capacity = 0.0;
+        double Available = 0.0;
+        double LastRefill = 0.0;
+        
+        void SetLimit(double InCapacity, double Now);
+        void Refill(double Now);
+        double GetWaitSeconds(double Amount) const;
+    };
+    
+    struct FEndpointState
+    {
+        FBucket Requests;
+        FBucket Tokens;
+        
+        /** 服务器要求的冷却截止时间 */
+        double BlockedUntil = 0.0;
+        
+        /** 连续收到429且没有Retry-After时的退避时间 */
+        double FallbackBackoff = 0.0;
+    };
+    
+    FEndpointState& FindOrAddState(const FString& EndpointKey, double Now);
+    
+    FCriticalSection Lock;
+    TMap<FString, FEndpointState> Endpoints;
+    
+    int32 DefaultRequestsPerMinute = 0;
+    int32 DefaultTokensPerMinute = 0;
+};
@@ -0,0 +1,232 @@
+﻿// DeepSeekRequestMetrics.h
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+#include "DeepSeekRequestMetrics.generated.h"
+
+/**
+ * 单个请求的性能指标
+ * 首字节和首token时间从请求真正发出(排队结束)时开始计算
+ */
+USTRUCT(BlueprintType)
+struct FDeepSeekRequestMetrics
+{
+    GENERATED_BODY()
+
+    /** 在调度器中排队的秒数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    float QueueWaitSeconds = 0.0f;
+
+    /** 发出请求到收到响应头或第一块数据的秒数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    float TimeToFirstByteSeconds = 0.0f;
+
+    /** 发出请求到收到第一段文本的秒数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    float TimeToFirstTokenSeconds = 0.0f;
+
+    /** 从调用到结束的总秒数，包括排队时间 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    float TotalSeconds = 0.0f;
+
+    /** 第一段文本之后的生成速度 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    float TokensPerSecond = 0.0f;
+
+    /** 生成的token数，服务器报告了usage时使用报告值，否则为收到的文本块数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    int32 CompletionTokens = 0;
+
+    /** 提示词token数，由服务器在usage中报告 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    int32 PromptTokens = 0;
+
+    /** 命中服务端前缀缓存的提示词token数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    int32 PromptCacheHitTokens = 0;
+
+    /** 未命中服务端前缀缓存的提示词token数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    int32 PromptCacheMissTokens = 0;
+
+    /** 请求体字节数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    int64 RequestBytes = 0;
+
+    /** 响应体字节数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    int64 ResponseBytes = 0;
+
+    /** 流式文本缓冲区分配的最大字节数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    int64 PeakStreamBufferBytes = 0;
+
+    /** 解析响应JSON累计花费的秒数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    float ParseSeconds = 0.0f;
+
+    /** 游戏线程上投递文本和处理完成回调累计花费的秒数，包括调用方绑定的委托 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    float GameThreadSeconds = 0.0f;
+
+    /**
+     * 相邻两段文本之间的间隔分布，各桶上限依次为
+     * 10、25、50、100、250、500、1000毫秒，最后一桶为1000毫秒以上
+     */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    TArray<int32> InterTokenLatencyHistogram;
+
+    /** 重试次数 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    int32 Retries = 0;
+
+    /** 发出过对冲请求 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    bool bHedged = false;
+
+    /** 结果来自对冲请求 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    bool bHedgeWon = false;
+
+    /** 最后一次尝试发出时有空闲连接可以复用(按请求时间估计)，不需要重新握手 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    bool bConnectionReused = false;
+
+    /** 结果来自响应缓存 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    bool bFromCache = false;
+
+    /** 请求已经结束，各项指标不再变化 */
+    UPROPERTY(BlueprintReadOnly, Category = "DeepSeek|Metrics")
+    bool bFinished = false;
+};
+
+/**
+ * 请求指标采集器
+ * 首字节、文本块和解析时间在HTTP线程上记录，其余在游戏线程上记录；
+ * 请求结束时汇总并发布到STAT、CSV profiler和Insights计数器
+ */
+class PAASAIMODULE_API FDeepSeekMetricsRecorder
+{
+public:
+    static constexpr int32 NumLatencyBuckets = 8;
+
+    /** 开始一个新请求 */
+    void Begin(int64 InRequestBytes);
+
+    /** 请求离开调度队列并发出 */
+    void MarkSent(double QueueWaitSeconds);
+
+    /** 收到响应头或第一块数据，只记录第一次 */
+    void MarkFirstByte();
+
+    /** 收到一段文本 */
+    void MarkToken();
+
+    void AddResponseBytes(int64 Bytes) { ResponseBytes += Bytes; }
+    void AddParseCycles(uint64 Cycles) { ParseCycles += Cycles; }
+
+    /** 记录游戏线程上的耗时，同时计入所有请求的总量 */
+    void AddGameThreadCycles(uint64 Cycles);
+
+    /** 所有请求在游戏线程上累计花费的周期数，用于性能测试前后相减 */
+    static uint64 GetTotalGameThreadCycles();
+    void SetReportedTokens(int32 Tokens) { ReportedTokens = Tokens; }
+
+    /** 记录usage中的提示词token数和前缀缓存命中情况 */
+    void SetPromptUsage(int32 Prompt, int32 CacheHit, int32 CacheMiss)
+    {
+        PromptTokens = Prompt;
+        PromptCacheHitTokens = CacheHit;
+        PromptCacheMissTokens = CacheMiss;
+    }
+    void SetFromCache() { bFromCache = true; }
+    void SetHedged() { bHedged = true; }
+    void SetHedgeWon() { bHedgeWon = true; }
+    void SetConnectionReused(bool bReused) { bConnectionReused = bReused; }
+
+    /**
+     * 记录流式文本缓冲区当前分配的字节数，可在任意线程调用
+     * 同时更新本请求的峰值和所有进行中请求的总量
+     */
+    void SetStreamBufferBytes(int64 Bytes);
+
+    /** 请求结束，缓冲区不再计入总量，本请求的峰值保留 */
+    void ReleaseStreamBuffer() { SetStreamBufferBytes(0); }
+
+    /** 所有进行中请求的流式文本缓冲区总字节数 */
+    static int64 GetActiveStreamBufferBytes();
+
+    /** 总字节数自上次重置以来的峰值 */
+    static int64 GetPeakActiveStreamBufferBytes();
+
+    /** 把峰值重置为当前总量，用于分段测量 */
+    static void ResetPeakActiveStreamBufferBytes();
+
+    /** 开始重试，首字节和首token时间改为从重试发出时计算 */
+    void AddRetry();
+    int64 GetResponseBytes() const { return ResponseBytes; }
+    bool HasFirstToken() const { return FirstTokenTime.load() > 0.0; }
+
+    /** 本次尝试从发出到首字节的秒数，还没有收到数据时为0 */
+    double GetTimeToFirstByte() const;
+
+    /** 请求结束，汇总并发布指标，只有第一次调用有效，调用方保证不会并发调用 */
+    void Finish(bool bSucceeded);
+
+    /** 当前指标，请求未结束时为进行中的值 */
+    FDeepSeekRequestMetrics GetSnapshot() const;
+
+private:
+    double StartTime = 0.0;
+    double SentTime = 0.0;
+    double EndTime = 0.0;
+    double QueueWait = 0.0;
+
+    std::atomic<double> FirstByteTime { 0.0 };
+    std::atomic<double> FirstTokenTime { 0.0 };
+
+    // 只由HTTP线程写入
+    double LastTokenTime = 0.0;
+
+    std::atomic<int32> TokenChunks { 0 };
+    std::atomic<int32> ReportedTokens { 0 };
+    std::atomic<int32> PromptTokens { 0 };
+    std::atomic<int32> PromptCacheHitTokens { 0 };
+    std::atomic<int32> PromptCacheMissTokens { 0 };
+    std::atomic<int32> LatencyBuckets[NumLatencyBuckets] = {};
+    std::atomic<int64> ResponseBytes { 0 };
+    std::atomic<uint64> ParseCycles { 0 };
+    uint64 GameThreadCycles = 0;
+    std::atomic<int64> StreamBufferBytes { 0 };
+    std::atomic<int64> PeakStreamBufferBytes { 0 };
+    int64 RequestBytes = 0;
+
+    int32 Retries = 0;
+    bool bHedged = false;
+    bool bHedgeWon = false;
+    bool bConnectionReused = false;
+    bool bFromCache = false;
+    std::atomic<bool> bFinished { false };
+};
+
+/** 把作用域内的耗时计入请求在游戏线程上的耗时 */
+class FDeepSeekScopedGameThreadTime
+{
+public:
+    explicit FDeepSeekScopedGameThreadTime(FDeepSeekMetricsRecorder& InRecorder)
+        : Recorder(InRecorder)
+        , StartCycles(FPlatformTime::Cycles64())
+    {
+    }
+
+    ~FDeepSeekScopedGameThreadTime()
+    {
+        Recorder.AddGameThreadCycles(FPlatformTime::Cycles64() - StartCycles);
+    }
+
+private:
+    FDeepSeekMetricsRecorder& Recorder;
+    uint64 StartCycles;
+};
@@ -0,0 +1,50 @@
+﻿// DeepSeekRequestPool.h
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/GCObject.h"
+#include "Containers/Ticker.h"
+
+class UDeepSeekFunction;
+
+/**
+ * UDeepSeekFunction请求对象池
+ * 执行中的请求由池持有引用，代替AddToRoot/RemoveFromRoot；结束的请求在下一帧回收，
+ * 复用对象本身以及其中的文本缓冲区容量
+ */
+class PAASAIMODULE_API FDeepSeekRequestPool : public FGCObject
+{
+public:
+    FDeepSeekRequestPool();
+    virtual ~FDeepSeekRequestPool() override;
+    
+    /** 取出一个空闲对象，池为空时新建 */
+    UDeepSeekFunction* Acquire();
+    
+    /** 请求开始执行，在结束前保持引用 */
+    void MarkActive(UDeepSeekFunction* Request);
+    
+    /** 请求结束，可复用的对象在下一帧重置后放回空闲列表 */
+    void Release(UDeepSeekFunction* Request);
+    
+    /** 空闲列表的最大长度，0表示不复用对象 */
+    void SetMaxPooled(int32 InMaxPooled);
+    
+    int32 GetNumActive() const { return ActiveRequests.Num(); }
+    int32 GetNumPooled() const { return FreeRequests.Num(); }
+    
+    //~ FGCObject
+    virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+    virtual FString GetReferencerName() const override;
+
+private:
+    bool RecyclePending(float DeltaTime);
+    void UpdateStats() const;
+    
+    TArray<TObjectPtr<UDeepSeekFunction>> ActiveRequests;
+    TArray<TObjectPtr<UDeepSeekFunction>> PendingRecycle;
+    TArray<TObjectPtr<UDeepSeekFunction>> FreeRequests;
+    
+    FTSTicker::FDelegateHandle RecycleTicker;
+    int32 MaxPooled = 64;
+};
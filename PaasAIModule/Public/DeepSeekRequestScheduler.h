@@ -0,0 +1,133 @@
+﻿// DeepSeekRequestScheduler.h
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AIFunction.h"
+#include "DeepSeekRateLimiter.h"
+#include "Containers/Ticker.h"
+
+/**
+ * 单个优先级通道的统计数据
+ */
+struct FDeepSeekSchedulerLaneStats
+{
+    /** 当前排队数 */
+    int32 Queued = 0;
+    
+    /** 当前执行中的请求数 */
+    int32 InFlight = 0;
+    
+    /** 累计提交、发出、结束、取消的请求数 */
+    uint64 Submitted = 0;
+    uint64 Dispatched = 0;
+    uint64 Finished = 0;
+    uint64 Cancelled = 0;
+    
+    /** 排队等待时间(秒) */
+    double TotalQueueWaitSeconds = 0.0;
+    double MaxQueueWaitSeconds = 0.0;
+};
+
+/**
+ * 模块级的请求调度器
+ * 按端点(URL + API密钥)限制同时执行的请求数和请求速率，超出的请求按优先级通道排队
+ */
+class PAASAIMODULE_API FDeepSeekRequestScheduler
+{
+public:
+    ~FDeepSeekRequestScheduler();
+    
+    using FHandle = uint64;
+    
+    /** 开始执行请求的回调，参数为排队等待的秒数 */
+    using FStartRequest = TFunction<void(double QueueWaitSeconds)>;
+    
+    static constexpr FHandle InvalidHandle = 0;
+    
+    /**
+     * 提交请求，有空闲名额时立即在当前线程调用StartRequest，否则排队
+     * 请求结束后必须调用Finish释放名额
+     * @param OutHandle 在调用StartRequest之前写入，请求在StartRequest中同步结束时也能用它调用Finish
+     */
+    void Submit(FHandle& OutHandle, const FString& EndpointKey, EDeepSeekRequestPriority Priority, int32 EstimatedTokens, FStartRequest&& StartRequest);
+    
+    /** 请求结束(完成、失败或中止)时调用，释放并发名额；仍在排队的请求会被移出队列 */
+    void Finish(FHandle Handle);
+    
+    /** 默认的每端点最大并发数 */
+    void SetMaxInFlightPerEndpoint(int32 MaxInFlight);
+    
+    /** 为指定端点单独设置最大并发数，小于等于0时恢复默认值 */
+    void SetEndpointLimit(const FString& EndpointKey, int32 MaxInFlight);
+    
+    /**
+     * 公平调度：后台请求等待时，每连续发出N个玩家请求后放行一个后台请求
+     * 为0时严格按优先级调度
+     */
+    void SetBackgroundShare(int32 PlayerRequestsPerBackground);
+    
+    /** 端点限流器，请求结束后应把响应头交给它更新预算 */
+    FDeepSeekRateLimiter& GetRateLimiter() { return RateLimiter; }
+    
+    /** 限流状态变化后重新尝试发出排队中的请求 */
+    void Pump();
+    
+    /** 获取通道统计 */
+    FDeepSeekSchedulerLaneStats GetLaneStats(EDeepSeekRequestPriority Priority) const;
+    
+    /** 生成端点标识，不包含明文密钥 */
+    static FString MakeEndpointKey(const FString& URL, const FString& APIKey);
+
+private:
+    struct FQueuedRequest
+    {
+        FHandle Handle = InvalidHandle;
+        FString EndpointKey;
+        FStartRequest StartRequest;
+        double EnqueueTime = 0.0;
+        int32 EstimatedTokens = 0;
+    };
+    
+    struct FActiveRequest
+    {
+        FString EndpointKey;
+        EDeepSeekRequestPriority Priority = EDeepSeekRequestPriority::PlayerFacing;
+    };
+    
+    struct FReadyRequest
+    {
+        FStartRequest StartRequest;
+        double QueueWaitSeconds = 0.0;
+    };
+    
+    // 在锁内挑选可以发出的请求，锁外再调用其回调
+    void CollectReadyRequests(TArray<FReadyRequest>& OutReady);
+    bool TryDispatchFromLane(EDeepSeekRequestPriority Priority, double Now, TArray<FReadyRequest>& OutReady);
+    bool HasCapacity(const FString& EndpointKey) const;
+    void ScheduleWakeup(double DelaySeconds);
+    bool HandleWakeup(float DeltaTime);
+    int32 GetEndpointLimit(const FString& EndpointKey) const;
+    
+    static constexpr int32 NumLanes = 2;
+    
+    mutable FCriticalSection Lock;
+    
+    TArray<FQueuedRequest> Lanes[NumLanes];
+    FDeepSeekSchedulerLaneStats LaneStats[NumLanes];
+    
+    TMap<FHandle, FActiveRequest> ActiveRequests;
+    TMap<FString, int32> InFlightPerEndpoint;
+    TMap<FString, int32> EndpointLimits;
+    
+    FDeepSeekRateLimiter RateLimiter;
+    
+    // 所有请求都因限流等待时，到期后重新调度
+    FTSTicker::FDelegateHandle WakeupHandle;
+    double WakeupTime = 0.0;
+    double PendingRateLimitWait = 0.0;
+    
+    FHandle NextHandle = 1;
+    int32 MaxInFlightPerEndpoint = 8;
+    int32 BackgroundShare = 4;
+    int32 PlayerDispatchesSinceBackground = 0;
+};
@@ -0,0 +1,43 @@
+﻿// DeepSeekRequestWriter.h
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FDeepSeekMessage;
+struct FDeepSeekRequestParams;
+
+/**
+ * 请求体写入器
+ * 直接把请求参数写成UTF-8编码的JSON字节，不经过FJsonObject和TCHAR字符串中转
+ */
+class PAASAIMODULE_API FDeepSeekRequestWriter
+{
+public:
+    /**
+     * 写入完整的请求体，会先清空OutBody但保留其容量
+     * stream等只影响传输方式的字段总是写在最后
+     * @return 规范化部分(决定回答内容的字段)的字节数，可用于计算缓存键
+     */
+    static int32 WriteRequestBody(const FDeepSeekRequestParams& Params, TArray<uint8>& OutBody);
+
+    /** 追加单条消息对象 {"role":...,"content":...}，包括函数调用和调用结果的字段 */
+    static void AppendMessage(TArray<uint8>& Out, const FDeepSeekMessage& Message);
+
+    /** 追加tools和tool_choice字段，没有工具时不写入 */
+    static void AppendTools(TArray<uint8>& Out, const FDeepSeekRequestParams& Params);
+
+    /** 追加带引号并已转义的JSON字符串 */
+    static void AppendString(TArray<uint8>& Out, FStringView Value);
+
+    /** 追加已经是JSON的文本(如JSON Schema)，只转换为UTF-8，不做转义 */
+    static void AppendRawJson(TArray<uint8>& Out, FStringView Json);
+
+    /** 追加ASCII字面量，不做转义 */
+    static void AppendLiteral(TArray<uint8>& Out, const ANSICHAR* Literal);
+
+    static void AppendInteger(TArray<uint8>& Out, int64 Value);
+
+    /** 追加小数，保留三位小数精度 */
+    static void AppendFloat(TArray<uint8>& Out, float Value);
+    static void AppendBool(TArray<uint8>& Out, bool bValue);
+};
@@ -0,0 +1,84 @@
+﻿// DeepSeekResponseCache.h
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/List.h"
+
+/**
+ * 精确匹配的响应缓存
+ * 以规范化请求体的哈希为键，内存中按字节数做LRU淘汰，可选的磁盘层在会话之间持久保存
+ * 磁盘层的键集合保存在内存中，查找时不访问文件系统；文件读写都在后台线程进行
+ */
+class PAASAIMODULE_API FDeepSeekResponseCache
+{
+public:
+    ~FDeepSeekResponseCache();
+    
+    /** 在内存层查找 */
+    bool Find(uint64 Key, FString& OutResponse);
+    
+    /**
+     * 磁盘层中键对应的文件路径，只查内存中的键集合
+     * @return 磁盘层没有这个键时返回空字符串，文件交给LoadFromDisk在后台线程读取
+     */
+    FString FindOnDisk(uint64 Key) const;
+    
+    /** 读取磁盘层的文件，可在任意线程调用；文件已被淘汰时返回false */
+    static bool LoadFromDisk(const FString& Path, FString& OutResponse);
+    
+    /** 把从磁盘层读到的回答放入内存层 */
+    void Promote(uint64 Key, const FString& Response);
+    
+    /** 写入缓存，启用磁盘层时同时异步写盘 */
+    void Add(uint64 Key, const FString& Response);
+    
+    /** 内存层的字节上限 */
+    void SetMemoryBudget(int64 Bytes);
+    
+    /** 磁盘层的字节上限，超出时先删除最早写入的文件，0表示不限 */
+    void SetDiskBudget(int64 Bytes);
+    
+    /** 磁盘层目录，为空时不使用磁盘层；设置时扫描目录建立键集合 */
+    void SetDiskDirectory(const FString& Directory);
+    
+    /** 清空内存层 */
+    void Clear();
+    
+    /**
+     * 计算请求的缓存键
+     * @param CanonicalBody 不含stream等传输相关字段的请求体部分
+     */
+    static uint64 MakeKey(const FString& URL, TConstArrayView<uint8> CanonicalBody);
+
+private:
+    struct FEntry
+    {
+        uint64 Key = 0;
+        FString Response;
+        int64 Bytes = 0;
+    };
+    
+    using FEntryList = TDoubleLinkedList<FEntry>;
+    using FEntryNode = FEntryList::TDoubleLinkedListNode;
+    
+    void AddToMemory(uint64 Key, const FString& Response);
+    void Evict();
+    void EvictDisk();
+    FString GetDiskPath(uint64 Key) const;
+    
+    mutable FCriticalSection Lock;
+    
+    // 头部为最近使用
+    FEntryList Entries;
+    TMap<uint64, FEntryNode*> EntriesByKey;
+    
+    int64 MemoryBytes = 0;
+    int64 MemoryBudget = 8 * 1024 * 1024;
+    FString DiskDirectory;
+    
+    // 磁盘层的文件大小，按写入顺序排列的键用于从最早的一端淘汰
+    TMap<uint64, int64> DiskEntries;
+    TArray<uint64> DiskOrder;
+    int64 DiskBytes = 0;
+    int64 DiskBudget = 0;
+};
@@ -0,0 +1,56 @@
+﻿// DeepSeekSSEParser.h
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * 增量SSE(Server-Sent Events)解析器
+ * 直接在UTF-8字节上查找行和事件边界，跨数据块保留未完成的行，只输出完整事件的data负载
+ */
+class PAASAIMODULE_API FDeepSeekSSEParser
+{
+public:
+    /** 事件回调，参数为该事件data字段的UTF-8内容(不以'\0'结尾)，返回false时停止解析 */
+    using FOnEvent = TFunctionRef<bool(FUtf8StringView EventData)>;
+
+    /**
+     * 输入一块原始字节，每解析出一个完整事件调用一次回调
+     * @return 回调要求停止时返回false
+     */
+    bool Feed(const uint8* Data, int64 Length, FOnEvent OnEvent);
+
+    /** 数据流结束时调用，处理没有以空行结尾的最后一个事件 */
+    bool Finish(FOnEvent OnEvent);
+
+    /** 清空内部状态，保留已分配的容量 */
+    void Reset();
+
+    /** 是否已经解析出至少一个事件 */
+    bool HasDispatchedEvent() const { return bHasDispatchedEvent; }
+
+    /**
+     * 解析出第一个事件之前收到的原始字节，最多保留MaxRawPrefixBytes
+     * 服务器返回的不是事件流(如错误JSON)时用于生成错误信息
+     */
+    FUtf8StringView GetRawPrefix() const
+    {
+        return FUtf8StringView(reinterpret_cast<const UTF8CHAR*>(RawPrefix.GetData()), RawPrefix.Num());
+    }
+
+    static constexpr int32 MaxRawPrefixBytes = 4096;
+
+private:
+    bool ProcessLine(const uint8* Line, int32 Length, FOnEvent OnEvent);
+    bool DispatchEvent(FOnEvent OnEvent);
+
+    // 上一个数据块中尚未遇到换行符的行
+    TArray<uint8> PendingLine;
+
+    // 当前事件已累积的data内容
+    TArray<uint8> EventData;
+    bool bHasEventData = false;
+
+    // 第一个事件之前的原始字节
+    TArray<uint8> RawPrefix;
+    bool bHasDispatchedEvent = false;
+};
@@ -0,0 +1,57 @@
+﻿// DeepSeekSentenceSegmenter.h
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * 流式文本的增量分句器
+ * 逐段输入token，在句子或分句边界(包括中文标点。！？，、；：)处切出片段，供TTS和字幕直接使用。
+ * 每个字符只扫描一次，只缓存尚未切出的部分；片段按顺序编号，编号不会因后续输入而改变
+ */
+class PAASAIMODULE_API FDeepSeekSentenceSegmenter
+{
+public:
+    /** 片段回调，Index从0开始连续递增 */
+    using FOnSegment = TFunctionRef<void(int32 Index, const FString& Segment)>;
+
+    /**
+     * @param MinChars 片段的最少字符数(不计空白)，不足时与下一句合并
+     * @param bSplitOnClauses 是否在逗号、顿号、分号、冒号处切分
+     * @param FlushTimeout 未遇到边界的文本最多等待的秒数，0表示只在边界和结束时切出
+     */
+    void Configure(int32 MinChars, bool bSplitOnClauses, float FlushTimeout);
+
+    /** 输入一段文本，每切出一个片段调用一次回调 */
+    void Feed(FStringView Text, double Now, FOnSegment OnSegment);
+
+    /** 等待超时时切出尚未遇到边界的文本 */
+    void FlushIfExpired(double Now, FOnSegment OnSegment);
+
+    /** 文本结束，切出剩余的全部文本 */
+    void Finish(FOnSegment OnSegment);
+
+    /** 清空状态，保留已分配的容量 */
+    void Reset();
+
+    bool HasInput() const { return bHasInput; }
+
+private:
+    // 在Pending的End位置之前切出一个片段，不足最少字符数时返回false
+    bool TryEmit(int32 End, bool bForce, FOnSegment OnSegment);
+
+    FString Pending;
+    int32 ScanPos = 0;
+
+    // 句末标点之后还可能跟着引号或括号，遇到下一个字符时再决定切分位置
+    int32 BoundaryEnd = INDEX_NONE;
+    bool bBoundaryNeedsSpace = false;
+
+    int32 NextIndex = 0;
+    double PendingStartTime = 0.0;
+    double LastFeedTime = 0.0;
+
+    int32 MinChars = 0;
+    bool bSplitOnClauses = true;
+    double FlushTimeout = 0.0;
+    bool bHasInput = false;
+};
@@ -0,0 +1,59 @@
+﻿// DeepSeekStreamDelta.h
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FDeepSeekJsonScanner;
+
+/**
+ * 单个流式chat-completion数据块中需要的字段
+ * 实例可以反复使用，Reset后保留字符串容量，避免每个token都重新分配
+ */
+struct PAASAIMODULE_API FDeepSeekStreamDelta
+{
+    /** choices[0].delta.content */
+    FString Content;
+
+    /**
+     * choices[0].delta.tool_calls中的一个片段
+     * 同一个调用的Id和Name只在第一个片段中出现，Arguments分散在多个片段中，按Index拼接
+     */
+    struct FToolCallFragment
+    {
+        int32 Index = 0;
+        FString Id;
+        FString Name;
+        FString Arguments;
+    };
+    TArray<FToolCallFragment> ToolCalls;
+
+    /** choices[0].finish_reason，未结束时为空 */
+    FString FinishReason;
+
+    /** 流中返回的错误信息 */
+    FString ErrorMessage;
+
+    /** 是否包含usage字段(通常只在最后一个数据块中出现) */
+    bool bHasUsage = false;
+    int32 PromptTokens = 0;
+    int32 CompletionTokens = 0;
+    int32 TotalTokens = 0;
+
+    /** 命中和未命中服务端前缀缓存的提示词token数 */
+    int32 PromptCacheHitTokens = 0;
+    int32 PromptCacheMissTokens = 0;
+
+    void Reset();
+
+    /**
+     * 直接从UTF-8字节中提取字段，不构建JSON DOM
+     * @return JSON格式正确时返回true
+     */
+    bool Parse(FUtf8StringView Json);
+
+private:
+    void ParseChoice(FDeepSeekJsonScanner& Scanner);
+    void ParseToolCalls(FDeepSeekJsonScanner& Scanner);
+    void ParseUsage(FDeepSeekJsonScanner& Scanner);
+    void ParseError(FDeepSeekJsonScanner& Scanner);
+};
@@ -0,0 +1,54 @@
+﻿// DeepSeekStructuredOutput.h
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * 结构化输出(JSON对象)的增量解析器
+ * 逐段输入模型生成的文本，每当顶层对象的一个字段的值完整时立即回调，不等待整个回答结束。
+ * 每个字符只扫描一次，只缓存当前字段的键和值；顶层对象之前的文字(如```json)会被跳过
+ */
+class PAASAIMODULE_API FDeepSeekStructuredOutputParser
+{
+public:
+    /** 字段回调，RawValue为该字段值的原始JSON文本(字符串带引号且未解码) */
+    using FOnField = TFunctionRef<void(const FString& Name, const FString& RawValue)>;
+
+    /** 输入一段文本，每完成一个顶层字段调用一次回调 */
+    void Feed(FStringView Text, FOnField OnField);
+
+    /** 清空状态，保留已分配的容量 */
+    void Reset();
+
+    /** 是否已经输入过文本 */
+    bool HasInput() const { return bHasInput; }
+
+    /** 顶层对象是否已经结束 */
+    bool IsComplete() const { return Phase == EPhase::Done; }
+
+private:
+    enum class EPhase : uint8
+    {
+        BeforeObject,
+        ExpectKey,
+        InKey,
+        ExpectColon,
+        ExpectValue,
+        InString,
+        InNested,
+        InPrimitive,
+        Done
+    };
+
+    void EmitField(FOnField OnField);
+
+    EPhase Phase = EPhase::BeforeObject;
+    FString Key;
+    FString Value;
+
+    // 嵌套值的层数，以及是否处在字符串或转义序列中
+    int32 Nesting = 0;
+    bool bInNestedString = false;
+    bool bEscape = false;
+    bool bHasInput = false;
+};
@@ -0,0 +1,107 @@
+﻿// DeepSeekTools.h
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSeekTools.generated.h"
+
+class FJsonObject;
+
+/**
+ * 提供给模型的函数(工具)定义
+ */
+USTRUCT(BlueprintType)
+struct FDeepSeekToolDefinition
+{
+    GENERATED_BODY()
+
+    /** 函数名，只能包含字母、数字、下划线和短横线 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString Name;
+
+    /** 函数的用途，模型据此决定何时调用 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (MultiLine = true))
+    FString Description;
+
+    /**
+     * 参数的JSON Schema，原样写入请求体，例如
+     * {"type":"object","properties":{"target":{"type":"string"}},"required":["target"]}
+     * 为空时表示没有参数
+     */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek", meta = (MultiLine = true))
+    FString ParametersSchema;
+
+    FDeepSeekToolDefinition() {}
+    FDeepSeekToolDefinition(const FString& InName, const FString& InDescription, const FString& InParametersSchema = FString())
+        : Name(InName), Description(InDescription), ParametersSchema(InParametersSchema) {}
+};
+
+/**
+ * 模型发出的一次函数调用
+ */
+USTRUCT(BlueprintType)
+struct PAASAIMODULE_API FDeepSeekToolCall
+{
+    GENERATED_BODY()
+
+    /** 调用Id，返回结果的tool消息需要带上它 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString Id;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString Name;
+
+    /** 参数的JSON文本，由模型生成，不保证格式正确 */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DeepSeek")
+    FString Arguments;
+
+    /** 把参数解析为JSON对象，参数为空时得到空对象 */
+    bool ParseArguments(TSharedPtr<FJsonObject>& OutArguments) const;
+};
+
+/** 蓝图工具处理函数，返回值作为调用结果发回给模型(通常是JSON或简短文本) */
+DECLARE_DYNAMIC_DELEGATE_RetVal_OneParam(FString, FDeepSeekToolHandler, const FDeepSeekToolCall&, ToolCall);
+
+/**
+ * 工具注册表
+ * 保存工具定义和处理函数，按函数名分发模型发出的调用，只在游戏线程上使用
+ */
+class PAASAIMODULE_API FDeepSeekToolRegistry
+{
+public:
+    using FNativeHandler = TFunction<FString(const FDeepSeekToolCall& ToolCall)>;
+
+    /** 注册C++处理函数，同名工具会被替换 */
+    void Register(const FDeepSeekToolDefinition& Definition, FNativeHandler&& Handler);
+
+    /** 注册蓝图处理函数，同名工具会被替换 */
+    void Register(const FDeepSeekToolDefinition& Definition, const FDeepSeekToolHandler& Handler);
+
+    bool Unregister(const FString& Name);
+
+    void Empty();
+
+    bool IsEmpty() const { return Entries.Num() == 0; }
+
+    /** 所有工具的定义，直接赋给FDeepSeekRequestParams::Tools */
+    const TArray<FDeepSeekToolDefinition>& GetDefinitions() const { return Definitions; }
+
+    /**
+     * 调用与函数名对应的处理函数
+     * @return 没有对应的工具或处理函数已失效时返回false，OutResult为发回给模型的错误信息
+     */
+    bool Invoke(const FDeepSeekToolCall& ToolCall, FString& OutResult) const;
+
+private:
+    struct FEntry
+    {
+        FString Name;
+        FNativeHandler NativeHandler;
+        FDeepSeekToolHandler DynamicHandler;
+    };
+
+    FEntry& AddEntry(const FDeepSeekToolDefinition& Definition);
+
+    // 与Definitions一一对应
+    TArray<FEntry> Entries;
+    TArray<FDeepSeekToolDefinition> Definitions;
+};
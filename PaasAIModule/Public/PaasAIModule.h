@@ -1,14 +1,55 @@
-// Copyright Epic Games, Inc. All Rights Reserved.
-
-#pragma once
-
-#include "Modules/ModuleManager.h"
-
-class FPaasAIModuleModule : public IModuleInterface
-{
-public:
-
-	/** IModuleInterface implementation */
-	virtual void StartupModule() override;
-	virtual void ShutdownModule() override;
-};
+﻿// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "Modules/ModuleManager.h"
+#include "Containers/Ticker.h"
+#include "DeepSeekRequestScheduler.h"
+#include "DeepSeekResponseCache.h"
+#include "DeepSeekRequestPool.h"
+#include "DeepSeekEndpointPool.h"
+#include "DeepSeekConnectionManager.h"
+
+class UWorld;
+
+class PAASAIMODULE_API FPaasAIModuleModule : public IModuleInterface
+{
+public:
+
+	/** IModuleInterface implementation */
+	virtual void StartupModule() override;
+	virtual void ShutdownModule() override;
+
+	/** 获取已加载的模块，模块未加载或ShutdownModule已经开始时返回nullptr */
+	static FPaasAIModuleModule* Get();
+
+	/** 所有DeepSeek请求共享的调度器 */
+	FDeepSeekRequestScheduler& GetScheduler() const { return *Scheduler; }
+
+	/** 请求参数启用bUseCache时使用的响应缓存 */
+	FDeepSeekResponseCache& GetResponseCache() const { return *ResponseCache; }
+
+	/** 复用UDeepSeekFunction对象的请求池 */
+	FDeepSeekRequestPool& GetRequestPool() const { return *RequestPool; }
+
+	/** 请求选择端点使用的端点池 */
+	FDeepSeekEndpointPool& GetEndpointPool() const { return *EndpointPool; }
+
+	/** 预热和保活到各端点的连接 */
+	FDeepSeekConnectionManager& GetConnectionManager() const { return *ConnectionManager; }
+
+	/** 向端点池添加端点，并把它的并发上限交给调度器、把它的源站交给连接管理 */
+	void AddEndpoint(const FDeepSeekEndpointConfig& Config);
+
+private:
+	void HandlePostLoadMap(UWorld* World);
+
+	TUniquePtr<FDeepSeekRequestScheduler> Scheduler;
+	TUniquePtr<FDeepSeekResponseCache> ResponseCache;
+	TUniquePtr<FDeepSeekRequestPool> RequestPool;
+	TUniquePtr<FDeepSeekEndpointPool> EndpointPool;
+	TUniquePtr<FDeepSeekConnectionManager> ConnectionManager;
+	FDelegateHandle PostLoadMapHandle;
+	FTSTicker::FDelegateHandle PrewarmTicker;
+	bool bShutDown = false;
+};
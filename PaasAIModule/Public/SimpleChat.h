@@ -1,92 +1,287 @@
-﻿// SimpleChat.h
-#pragma once
-
-#include "CoreMinimal.h"
-#include "Kismet/BlueprintAsyncActionBase.h"
-#include "AIFunction.h"
-#include "SimpleChat.generated.h"
-
-/**
- * 简化的DeepSeek聊天接口，自动管理会话
- */
-UCLASS(Blueprintable, BlueprintType)
-class PAASAIMODULE_API USimpleChat : public UObject
-{
-	GENERATED_BODY()
-
-public:
-	/** 流式响应 */
-	UPROPERTY(BlueprintAssignable)
-	FDeepSeekResponse OnStream;
-    
-	/** 请求完成 */
-	UPROPERTY(BlueprintAssignable)
-	FDeepSeekResponse OnCompleted;
-    
-	/** 请求失败 */
-	UPROPERTY(BlueprintAssignable)
-	FDeepSeekResponse OnFailed;
-    
-	/**
-	 * 创建新的聊天实例
-	 */
-	UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
-	static USimpleChat* CreateChatInstance();
-    
-	/** 
-	 * 发送消息并获取响应，自动维护对话上下文
-	 */
-	UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
-	void SendMessage(
-		const FString& APIKey,
-		const FString& Message,
-		const FString& SystemPrompt = TEXT(""),
-		const FString& ModelName = TEXT("deepseek-chat"),
-		float Temperature = 0.7f);
-    
-	/** 
-	 * 获取当前对话历史
-	 */
-	UFUNCTION(BlueprintPure, Category = "AI|DeepSeek")
-	FString GetChatHistory() const;
-    
-	/**
-	 * 清除对话历史，开始新对话
-	 */
-	UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
-	void ClearChat();
-
-	/**
-	 * 获取所有消息
-	 */
-	UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
-	const TArray<FDeepSeekMessage>& GetMessages() const;
-	
-	/**
-	 * 对象销毁时的清理
-	 */
-	virtual void BeginDestroy() override;
-
-private:    
-	UFUNCTION()
-	void HandleStreamResponse(FString Response);
-    
-	UFUNCTION()
-	void HandleCompletedResponse(FString Response);
-    
-	UFUNCTION()
-	void HandleFailedResponse(FString ErrorMessage);
-	
-	// 清理当前请求
-	void CleanupCurrentRequest();
-
-	// 会话历史
-	UPROPERTY()
-	TArray<FDeepSeekMessage> ChatHistory;
-    
-	UPROPERTY()
-	UDeepSeekFunction* ApiRequest = nullptr;
-    
-	FString AccumulatedResponse;
-	bool bIsBeingDestroyed = false;
-};
+﻿// SimpleChat.h
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "AIFunction.h"
+#include "DeepSeekContextWindow.h"
+#include "SimpleChat.generated.h"
+
+/** 执行了一次函数调用，参数为调用和发回给模型的结果 */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FDeepSeekToolCalled, const FDeepSeekToolCall&, ToolCall, const FString&, Result);
+
+/**
+ * 简化的DeepSeek聊天接口，自动管理会话
+ */
+UCLASS(Blueprintable, BlueprintType)
+class PAASAIMODULE_API USimpleChat : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/** 流式响应 */
+	UPROPERTY(BlueprintAssignable)
+	FDeepSeekResponse OnStream;
+    
+	/** 请求完成 */
+	UPROPERTY(BlueprintAssignable)
+	FDeepSeekResponse OnCompleted;
+    
+	/** 请求失败 */
+	UPROPERTY(BlueprintAssignable)
+	FDeepSeekResponse OnFailed;
+	
+	/** 请求被取消或超时，参数为原因；已经收到的部分回答会保留在历史中 */
+	UPROPERTY(BlueprintAssignable)
+	FDeepSeekResponse OnCancelled;
+	
+	/** 执行了模型发出的函数调用，结果会在下一轮自动发回给模型 */
+	UPROPERTY(BlueprintAssignable)
+	FDeepSeekToolCalled OnToolCalled;
+	
+	/** ResponseFormat为JsonObject时，回答的每个顶层字段完整时触发 */
+	UPROPERTY(BlueprintAssignable)
+	FDeepSeekStructuredField OnStructuredField;
+	
+	/** 回答的格式，JsonObject时系统提示中需要说明JSON的字段 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek")
+	EDeepSeekResponseFormat ResponseFormat = EDeepSeekResponseFormat::Text;
+	
+	/** bSegmentStream为true时，回答每切分出一个句子触发，可以直接交给TTS或字幕 */
+	UPROPERTY(BlueprintAssignable)
+	FDeepSeekSegment OnSegment;
+	
+	/** 是否把回答按句子切分并通过OnSegment发出 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek")
+	bool bSegmentStream = false;
+	
+	/** 片段的最少字符数(不计空白)，过短的句子与下一句合并 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek", meta = (ClampMin = "0", EditCondition = "bSegmentStream"))
+	int32 SegmentMinChars = 6;
+	
+	/** 是否在逗号、顿号、分号、冒号处切分，长句可以更早开始朗读 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek", meta = (EditCondition = "bSegmentStream"))
+	bool bSegmentOnClauses = true;
+	
+	/** 一直没有遇到标点时，文本最多等待的秒数，0表示只在标点和结束时切出 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek", meta = (ClampMin = "0.0", EditCondition = "bSegmentStream"))
+	float SegmentFlushTimeout = 0.0f;
+	
+	/** 一条消息最多连续执行多少轮函数调用，超过后以失败结束，防止模型反复调用 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek", meta = (ClampMin = "1"))
+	int32 MaxToolRounds = 4;
+	
+	/** 请求调度优先级 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek")
+	EDeepSeekRequestPriority RequestPriority = EDeepSeekRequestPriority::PlayerFacing;
+	
+	/**
+	 * 每轮发送的上下文的token预算(估算值)，超出时从最早的轮次开始淘汰，系统提示始终保留
+	 * 0表示发送全部历史
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek", meta = (ClampMin = "0"))
+	int32 ContextTokenBudget = 16000;
+	
+	/**
+	 * 保持已发送的上下文前缀逐字节不变，以命中服务端的前缀缓存
+	 * 超出预算时一次淘汰较多轮次，摘要推迟到下一次淘汰时再加入
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek")
+	bool bPrefixStableContext = true;
+	
+	/** 在后台把被淘汰的轮次总结为一条摘要，随后续请求一起发送 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek")
+	bool bSummarizeEvictedTurns = false;
+	
+	/** 每轮回答的总超时秒数，0表示不限制 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek", meta = (ClampMin = "0"))
+	float ResponseTimeoutSeconds = 0.0f;
+	
+	/** 等待回答第一段文本的超时秒数，0表示不限制 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek", meta = (ClampMin = "0"))
+	float FirstTokenTimeoutSeconds = 0.0f;
+	
+	/** 回答中出现任意一个字符串时停止生成，回答截断到该字符串之前 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek")
+	TArray<FString> StopStrings;
+	
+	/** 每轮回答的最大字符数，达到后停止生成，0表示不限制 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek", meta = (ClampMin = "0"))
+	int32 MaxResponseChars = 0;
+	
+	/** 尚未收到回答就连接失败或服务器出错时的最多重试次数 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek", meta = (ClampMin = "0"))
+	int32 MaxRetries = 0;
+	
+	/** 超过这个秒数仍未收到回答时向备用端点发出对冲请求，0表示不对冲，参见FDeepSeekRequestParams::HedgeAfterSeconds */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek", meta = (ClampMin = "0"))
+	float HedgeAfterSeconds = 0.0f;
+	
+	/** 对冲请求的API URL，为空时使用默认URL */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek")
+	FString HedgeURL;
+	
+	/** 对冲请求的API密钥，为空时使用SendMessage的密钥 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|DeepSeek")
+	FString HedgeAPIKey;
+    
+	/**
+	 * 创建新的聊天实例
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
+	static USimpleChat* CreateChatInstance();
+    
+	/** 
+	 * 发送消息并获取响应，自动维护对话上下文
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
+	void SendMessage(
+		const FString& APIKey,
+		const FString& Message,
+		const FString& SystemPrompt = TEXT(""),
+		const FString& ModelName = TEXT("deepseek-chat"),
+		float Temperature = 0.7f);
+    
+	/** 
+	 * 获取当前对话历史
+	 */
+	UFUNCTION(BlueprintPure, Category = "AI|DeepSeek")
+	FString GetChatHistory() const;
+    
+	/**
+	 * 清除对话历史，开始新对话
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
+	void ClearChat();
+	
+	/**
+	 * 取消正在进行的回答，立即中止传输并触发OnCancelled
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
+	void Cancel();
+
+	/**
+	 * 注册模型可以调用的函数，同名函数会被替换
+	 * 模型调用时在游戏线程上执行Handler，返回值作为结果自动发回给模型继续回答
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
+	void RegisterTool(const FDeepSeekToolDefinition& Definition, const FDeepSeekToolHandler& Handler);
+	
+	/** 注册C++处理函数 */
+	void RegisterNativeTool(const FDeepSeekToolDefinition& Definition, FDeepSeekToolRegistry::FNativeHandler&& Handler);
+	
+	UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
+	bool UnregisterTool(const FString& Name);
+
+	/**
+	 * 获取所有消息
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AI|DeepSeek")
+	const TArray<FDeepSeekMessage>& GetMessages() const;
+	
+	/**
+	 * 获取下一轮将要发送的上下文的估算token数
+	 */
+	UFUNCTION(BlueprintPure, Category = "AI|DeepSeek")
+	int32 GetContextTokens() const { return ContextWindow.GetContextTokens(); }
+	
+	/**
+	 * 获取上一次完成的请求的性能指标，包括服务端前缀缓存的命中情况
+	 */
+	UFUNCTION(BlueprintPure, Category = "AI|DeepSeek")
+	const FDeepSeekRequestMetrics& GetLastRequestMetrics() const { return LastRequestMetrics; }
+	
+	/**
+	 * 对象销毁时的清理
+	 */
+	virtual void BeginDestroy() override;
+
+private:    
+	UFUNCTION()
+	void HandleStreamResponse(FString Response);
+    
+	UFUNCTION()
+	void HandleCompletedResponse(FString Response);
+    
+	UFUNCTION()
+	void HandleFailedResponse(FString ErrorMessage);
+	
+	UFUNCTION()
+	void HandleCancelledResponse(FString Reason);
+	
+	UFUNCTION()
+	void HandleStructuredField(FString FieldName, FString Value);
+	
+	UFUNCTION()
+	void HandleSegment(int32 Index, FString Segment);
+	
+	UFUNCTION()
+	void HandleSummaryCompleted(FString Summary);
+	
+	UFUNCTION()
+	void HandleSummaryFailed(FString ErrorMessage);
+	
+	// 用当前上下文发出一轮请求
+	void SendContext();
+	
+	// 执行模型发出的函数调用并把结果发回给模型
+	void RunToolCalls(FString&& Content, const TArray<FDeepSeekToolCall>& ToolCalls);
+	
+	// 有尚未总结的已淘汰轮次时发出后台摘要请求
+	void RequestSummary();
+	void CleanupSummaryRequest();
+	
+	// 清理当前请求
+	void CleanupCurrentRequest();
+	
+	// 添加消息到历史，并追加到上下文窗口
+	void AppendToHistory(FDeepSeekMessage&& Message);
+
+	// 会话历史
+	UPROPERTY()
+	TArray<FDeepSeekMessage> ChatHistory;
+	
+	// 实际发送的上下文，缓存每条消息的token估算值和编码
+	FDeepSeekContextWindow ContextWindow;
+	
+	// 后台摘要请求，以及它覆盖的历史范围的结束下标
+	UPROPERTY()
+	UDeepSeekFunction* SummaryRequest = nullptr;
+	int32 PendingSummaryEnd = 0;
+	
+	// 请求对象结束后会被回收，完成时保存一份指标
+	FDeepSeekRequestMetrics LastRequestMetrics;
+	
+	// 摘要请求使用最近一次发送时的连接参数
+	FString LastAPIKey;
+	FString LastModelName;
+	float LastTemperature = 0.7f;
+	
+	// 注册的函数，以及当前消息已经执行的函数调用轮数
+	FDeepSeekToolRegistry ToolRegistry;
+	int32 ToolRounds = 0;
+	
+	// 执行函数期间调用SendMessage时先记下消息，等所有调用都有了结果再发送，
+	// 否则历史中会出现没有结果的tool_call_id，之后的请求都会被服务器拒绝
+	struct FPendingMessage
+	{
+		FString APIKey;
+		FString Message;
+		FString SystemPrompt;
+		FString ModelName;
+		float Temperature = 0.7f;
+	};
+	bool bRunningTools = false;
+	TOptional<FPendingMessage> PendingMessage;
+	
+	// 执行函数期间调用了Cancel，剩余的调用不再执行，也不再发出下一轮
+	bool bToolRoundCancelled = false;
+	
+	// ClearChat时递增，执行函数期间历史被清空后不再写入本轮的结果
+	uint32 HistoryGeneration = 0;
+    
+	UPROPERTY()
+	UDeepSeekFunction* ApiRequest = nullptr;
+    
+	bool bIsBeingDestroyed = false;
+};